@@ -54,6 +54,7 @@
 #include "config-yaml.h"
 #include "ndp-collector.h"
 #include "util.h"
+#include "output-queue.h"
 
 #ifdef WITH_BLUEDOT
 #include "output-plugins/bluedot.h"
@@ -65,6 +66,13 @@ struct _Bluedot_Skip *Bluedot_Skip = NULL;
 #endif
 
 #include "output-plugins/external.h"
+#include "output-plugins/file.h"
+#include "output-plugins/pipe.h"
+
+#ifdef HAVE_LIBHIREDIS
+#include <hiredis/hiredis.h>
+#include "output-plugins/redis.h"
+#endif
 
 extern struct _MeerConfig *MeerConfig;
 extern struct _MeerOutput *MeerOutput;
@@ -77,6 +85,44 @@ struct _NDP_Ignore *NDP_Ignore = NULL;
 struct _NDP_SMB_Commands *NDP_SMB_Commands = NULL;
 struct _NDP_FTP_Commands *NDP_FTP_Commands = NULL;
 
+/****************************************************************************
+ * Load_YAML_Size - A size given as kb,  mb or gb in bytes.  0 if it isn't
+ * one.
+ ****************************************************************************/
+
+static uint64_t Load_YAML_Size( const char *value )
+{
+
+    char tmp[64] = { 0 };
+    size_t len = strlen(value);
+
+    if ( len < 3 || len >= sizeof(tmp) || value[len - 1] != 'b' )
+        {
+            return(0);
+        }
+
+    strlcpy(tmp, value, sizeof(tmp));
+    tmp[ len - 2 ] = '\0';		/* Remove kb, mb, gb */
+
+    if ( value[len - 2] == 'k' )
+        {
+            return( strtoull(tmp, NULL, 10) * 1024 );
+        }
+
+    else if ( value[len - 2] == 'm' )
+        {
+            return( strtoull(tmp, NULL, 10) * 1024 * 1024 );
+        }
+
+    else if ( value[len - 2] == 'g' )
+        {
+            return( strtoull(tmp, NULL, 10) * 1024 * 1024 * 1024 );
+        }
+
+    return(0);
+
+}
+
 void Load_YAML_Config( char *yaml_file )
 {
 
@@ -101,11 +147,32 @@ void Load_YAML_Config( char *yaml_file )
 
     bool routing = false;
 
+    struct _Output_Queue_Config *worker = NULL;	/* Of the output block being read */
+
+    struct _File_Output *file = NULL;		/* The block being read */
+    struct _Pipe_Output *pipe_out = NULL;
+    uint8_t count = 0;
+    uint8_t i = 0;
+
+#ifdef HAVE_LIBHIREDIS
+
+    struct _Redis_Output *redis = NULL;
+
+#endif
+
+#ifdef WITH_ELASTICSEARCH
+
+    struct _Elasticsearch_Output *es = NULL;
+    uint8_t es_count = 0;
+
+#endif
+
     /* Init MeerConfig values */
 
     MeerConfig->fingerprint = false;
     MeerConfig->fingerprint_reader = true;
     MeerConfig->fingerprint_writer = true;
+    MeerConfig->fingerprint_cache = FINGERPRINT_CACHE_DEFAULT;
 
     strlcpy(MeerConfig->meer_log, MEER_LOG, sizeof( MeerConfig->meer_log ));
     strlcpy(MeerConfig->description, MEER_DESC, sizeof( MeerConfig->description ));
@@ -134,19 +201,17 @@ void Load_YAML_Config( char *yaml_file )
 
     MeerOutput->redis_enabled = false;
     MeerOutput->redis_port = 6379;
-    MeerOutput->redis_batch = 1;
+    MeerOutput->redis_reader_port = 6379;
 
     strlcpy(MeerOutput->redis_server, "127.0.0.1", sizeof(MeerOutput->redis_server));
-    strlcpy(MeerOutput->redis_command, "set", sizeof(MeerOutput->redis_command));
 
     MeerInput->redis_port = 6379;
 
 #endif
 
-#ifdef WITH_ELASTICSEARCH
+#ifdef HAVE_LIBMAXMINDDB
 
-    MeerOutput->elasticsearch_batch = 10;
-    MeerOutput->elasticsearch_threads = 5;
+    MeerConfig->geoip_cache = GEOIP_CACHE_DEFAULT;
 
 #endif
 
@@ -159,7 +224,15 @@ void Load_YAML_Config( char *yaml_file )
 
     strlcpy(dns_lookup_types_tmp, DNS_LOOKUP_TYPES, DNS_MAX_TYPES * DNS_MAX_TYPES_LEN );
 
-    MeerOutput->pipe_size =  DEFAULT_PIPE_SIZE;
+    Output_Queue_Defaults( &MeerOutput->external_worker );
+
+#ifdef WITH_SYSLOG
+    Output_Queue_Defaults( &MeerOutput->syslog_worker );
+#endif
+
+#ifdef WITH_BLUEDOT
+    Output_Queue_Defaults( &MeerOutput->bluedot_worker );
+#endif
 
     if (stat(yaml_file, &filecheck) != false )
         {
@@ -240,6 +313,7 @@ void Load_YAML_Config( char *yaml_file )
                         }
 
                     sub_type = 0;
+                    worker = NULL;
 
                 }
 
@@ -304,34 +378,119 @@ void Load_YAML_Config( char *yaml_file )
                     else if ( type == YAML_TYPE_OUTPUT )
                         {
 
-                            if ( !strcmp(value, "pipe") )
+                            /* "pipe",  "file" and "redis" can be given more
+                               than once as "<type>-<name>",  the same as
+                               "elasticsearch".  Each has its own routing and
+                               worker,  and the name is its queue's. */
+
+                            if ( !strcmp(value, "pipe") || !strncmp(value, "pipe-", 5) )
                                 {
                                     sub_type = YAML_MEER_PIPE;
                                     routing = false;
+
+                                    for ( i = 0; i < MeerOutput->pipe_count; i++ )
+                                        {
+                                            if ( !strcmp(MeerOutput->pipe[i]->name, value) )
+                                                {
+                                                    Meer_Log(ERROR, "[%s, line %d] Output '%s' is defined more than once.  Abort!", __FILE__, __LINE__, value);
+                                                }
+                                        }
+
+                                    MeerOutput->pipe = realloc(MeerOutput->pipe, ( MeerOutput->pipe_count + 1 ) * sizeof(struct _Pipe_Output *));
+                                    pipe_out = malloc(sizeof(struct _Pipe_Output));
+
+                                    if ( MeerOutput->pipe == NULL || pipe_out == NULL )
+                                        {
+                                            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Pipe_Output. Abort!", __FILE__, __LINE__);
+                                        }
+
+                                    Pipe_Output_Defaults( pipe_out );
+                                    strlcpy(pipe_out->name, value, sizeof(pipe_out->name));
+
+                                    worker = &pipe_out->worker;
+
+                                    MeerOutput->pipe[MeerOutput->pipe_count++] = pipe_out;
                                 }
 
                             if ( !strcmp(value, "external") )
                                 {
                                     sub_type = YAML_MEER_EXTERNAL;
                                     routing = false;
+                                    worker = &MeerOutput->external_worker;
                                 }
 
-                            if ( !strcmp(value, "redis") )
+                            if ( !strcmp(value, "redis") || !strncmp(value, "redis-", 6) )
                                 {
                                     sub_type = YAML_MEER_REDIS;
                                     routing = false;
+
+#ifdef HAVE_LIBHIREDIS
+
+                                    for ( i = 0; i < MeerOutput->redis_count; i++ )
+                                        {
+                                            if ( !strcmp(MeerOutput->redis[i]->name, value) )
+                                                {
+                                                    Meer_Log(ERROR, "[%s, line %d] Output '%s' is defined more than once.  Abort!", __FILE__, __LINE__, value);
+                                                }
+                                        }
+
+                                    MeerOutput->redis = realloc(MeerOutput->redis, ( MeerOutput->redis_count + 1 ) * sizeof(struct _Redis_Output *));
+                                    redis = malloc(sizeof(struct _Redis_Output));
+
+                                    if ( MeerOutput->redis == NULL || redis == NULL )
+                                        {
+                                            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Redis_Output. Abort!", __FILE__, __LINE__);
+                                        }
+
+                                    Redis_Output_Defaults( redis );
+                                    strlcpy(redis->name, value, sizeof(redis->name));
+
+                                    worker = &redis->worker;
+
+                                    MeerOutput->redis[MeerOutput->redis_count++] = redis;
+
+#endif
+
                                 }
 
-                            if ( !strcmp(value, "file") )
+                            if ( !strcmp(value, "file") || !strncmp(value, "file-", 5) )
                                 {
                                     sub_type = YAML_MEER_FILE;
                                     routing = false;
+
+                                    for ( i = 0; i < MeerOutput->file_count; i++ )
+                                        {
+                                            if ( !strcmp(MeerOutput->file[i]->name, value) )
+                                                {
+                                                    Meer_Log(ERROR, "[%s, line %d] Output '%s' is defined more than once.  Abort!", __FILE__, __LINE__, value);
+                                                }
+                                        }
+
+                                    MeerOutput->file = realloc(MeerOutput->file, ( MeerOutput->file_count + 1 ) * sizeof(struct _File_Output *));
+                                    file = malloc(sizeof(struct _File_Output));
+
+                                    if ( MeerOutput->file == NULL || file == NULL )
+                                        {
+                                            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for _File_Output. Abort!", __FILE__, __LINE__);
+                                        }
+
+                                    File_Output_Defaults( file );
+                                    strlcpy(file->name, value, sizeof(file->name));
+
+                                    worker = &file->worker;
+
+                                    MeerOutput->file[MeerOutput->file_count++] = file;
                                 }
 
                             if ( !strcmp(value, "syslog") )
                                 {
                                     sub_type = YAML_MEER_SYSLOG;
                                     routing = false;
+
+#ifdef WITH_SYSLOG
+                                    worker = &MeerOutput->syslog_worker;
+#endif
+
                                 }
 
 
@@ -341,14 +500,132 @@ void Load_YAML_Config( char *yaml_file )
                                 {
                                     sub_type = YAML_MEER_BLUEDOT;
                                     routing = false;
+                                    worker = &MeerOutput->bluedot_worker;
                                 }
 
 #endif
 
-                            if ( !strcmp(value, "elasticsearch") )
+                            /* "elasticsearch" can be given more than once as
+                               "elasticsearch-<name>",  each with its own cluster
+                               and routing */
+
+                            if ( !strcmp(value, "elasticsearch") || !strncmp(value, "elasticsearch-", 14) )
                                 {
                                     sub_type = YAML_MEER_ELASTICSEARCH;
                                     routing = false;
+
+#ifdef WITH_ELASTICSEARCH
+
+                                    for ( i = 0; i < MeerOutput->elasticsearch_count; i++ )
+                                        {
+                                            if ( !strcmp(MeerOutput->elasticsearch[i]->name, value) )
+                                                {
+                                                    Meer_Log(ERROR, "[%s, line %d] Output '%s' is defined more than once.  Abort!", __FILE__, __LINE__, value);
+                                                }
+                                        }
+
+                                    MeerOutput->elasticsearch = realloc(MeerOutput->elasticsearch, ( MeerOutput->elasticsearch_count + 1 ) * sizeof(struct _Elasticsearch_Output *));
+                                    es = malloc(sizeof(struct _Elasticsearch_Output));
+
+                                    if ( MeerOutput->elasticsearch == NULL || es == NULL )
+                                        {
+                                            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Elasticsearch_Output. Abort!", __FILE__, __LINE__);
+                                        }
+
+                                    Elasticsearch_Output_Defaults( es );
+                                    strlcpy(es->name, value, sizeof(es->name));
+
+                                    worker = &es->worker;
+
+                                    MeerOutput->elasticsearch[MeerOutput->elasticsearch_count++] = es;
+
+#endif
+
+                                }
+
+                        }
+
+                    /* The worker queue and circuit breaker every output has
+                       (see output-queue.c) */
+
+                    if ( type == YAML_TYPE_OUTPUT && worker != NULL )
+                        {
+
+                            if ( !strcmp(last_pass, "worker_queue" ) )
+                                {
+
+                                    worker->size = atoi(value);
+
+                                    if ( worker->size == 0 )
+                                        {
+                                            Meer_Log(ERROR, "[%s, line %d] 'worker_queue' must be at least 1. Abort!", __FILE__, __LINE__);
+                                        }
+                                }
+
+                            if ( !strcmp(last_pass, "worker_queue_full" ) )
+                                {
+
+                                    if ( !strcmp(value, "block") )
+                                        {
+                                            worker->full = OUTPUT_QUEUE_BLOCK;
+                                        }
+
+                                    else if ( !strcmp(value, "drop-oldest") )
+                                        {
+                                            worker->full = OUTPUT_QUEUE_DROP_OLDEST;
+                                        }
+
+                                    else
+                                        {
+                                            Meer_Log(ERROR, "Invalid 'worker_queue_full'.  Must be block or drop-oldest. Abort");
+                                        }
+                                }
+
+                            if ( !strcmp(last_pass, "breaker_failures" ) )
+                                {
+                                    worker->breaker_failures = atoi(value);
+                                }
+
+                            if ( !strcmp(last_pass, "breaker_timeout" ) )
+                                {
+                                    worker->breaker_timeout = atoi(value);
+                                }
+
+                            if ( !strcmp(last_pass, "breaker_cooldown" ) )
+                                {
+                                    worker->breaker_cooldown = atoi(value);
+                                }
+
+                            if ( !strcmp(last_pass, "spill_directory" ) )
+                                {
+                                    strlcpy(worker->spill, value, sizeof(worker->spill));
+                                }
+
+                            if ( !strcmp(last_pass, "spill_max" ) )
+                                {
+
+                                    worker->spill_max = Load_YAML_Size( value );
+
+                                    if ( worker->spill_max == 0 )
+                                        {
+                                            Meer_Log(ERROR, "[%s, line %d] 'spill_max' has an invalid size.  It needs to be kb, mb or gb.", __FILE__, __LINE__);
+                                        }
+                                }
+
+                            if ( !strcmp(last_pass, "spill_segment" ) )
+                                {
+
+                                    worker->spill_segment = Load_YAML_Size( value );
+
+                                    if ( worker->spill_segment == 0 || Load_YAML_Size( value ) > UINT32_MAX )
+                                        {
+                                            Meer_Log(ERROR, "[%s, line %d] 'spill_segment' has an invalid size.  It needs to be kb, mb or gb and under 4gb.", __FILE__, __LINE__);
+                                        }
+                                }
+
+                            if ( !strcmp(last_pass, "spill_deadline" ) )
+                                {
+                                    worker->spill_deadline = atoi(value);
                                 }
 
                         }
@@ -663,7 +940,82 @@ void Load_YAML_Config( char *yaml_file )
 
                             else if ( !strcmp(last_pass, "geoip_database" ) && MeerConfig->geoip == true )
                                 {
-                                    strlcpy(MeerConfig->geoip_database, value, sizeof(MeerConfig->geoip_database));
+
+                                    char *db_ptr = NULL;
+                                    char *tok = NULL;
+
+                                    Remove_Spaces(value);
+
+                                    db_ptr = strtok_r(value, ",", &tok);
+
+                                    while ( db_ptr != NULL )
+                                        {
+
+                                            if ( MeerConfig->geoip_database_count >= GEOIP_MAX_DATABASES )
+                                                {
+                                                    Meer_Log(ERROR, "[%s, line %d] Too many 'geoip_database' entries. The max is %d. Abort!", __FILE__, __LINE__, GEOIP_MAX_DATABASES);
+                                                }
+
+                                            strlcpy(MeerConfig->geoip_database[MeerConfig->geoip_database_count], db_ptr, sizeof(MeerConfig->geoip_database[0]));
+                                            MeerConfig->geoip_database_count++;
+
+                                            db_ptr = strtok_r(NULL, ",", &tok);
+                                        }
+
+                                }
+
+                            else if ( !strcmp(last_pass, "geoip_fields" ) && MeerConfig->geoip == true )
+                                {
+
+                                    char *field_ptr = NULL;
+                                    char *field_name = NULL;
+                                    char *tok = NULL;
+
+                                    Remove_Spaces(value);
+
+                                    field_ptr = strtok_r(value, ",", &tok);
+
+                                    while ( field_ptr != NULL )
+                                        {
+
+                                            if ( MeerConfig->geoip_field_count >= GEOIP_MAX_FIELDS )
+                                                {
+                                                    Meer_Log(ERROR, "[%s, line %d] Too many 'geoip_fields' entries. The max is %d. Abort!", __FILE__, __LINE__, GEOIP_MAX_FIELDS);
+                                                }
+
+                                            /* "path.to.value:name".  If no name is given,  the last
+                                               part of the path is used. */
+
+                                            field_name = strchr(field_ptr, ':');
+
+                                            if ( field_name != NULL )
+                                                {
+                                                    *field_name = '\0';
+                                                    field_name++;
+                                                }
+                                            else
+                                                {
+                                                    field_name = strrchr(field_ptr, '.');
+                                                    field_name = field_name != NULL ? field_name + 1 : field_ptr;
+                                                }
+
+                                            if ( field_ptr[0] == '\0' || field_name[0] == '\0' )
+                                                {
+                                                    Meer_Log(ERROR, "[%s, line %d] Invalid 'geoip_fields' entry. Abort!", __FILE__, __LINE__);
+                                                }
+
+                                            strlcpy(MeerConfig->geoip_field_path[MeerConfig->geoip_field_count], field_ptr, sizeof(MeerConfig->geoip_field_path[0]));
+                                            strlcpy(MeerConfig->geoip_field_name[MeerConfig->geoip_field_count], field_name, sizeof(MeerConfig->geoip_field_name[0]));
+                                            MeerConfig->geoip_field_count++;
+
+                                            field_ptr = strtok_r(NULL, ",", &tok);
+                                        }
+
+                                }
+
+                            else if ( !strcmp(last_pass, "geoip_cache" ) && MeerConfig->geoip == true )
+                                {
+                                    MeerConfig->geoip_cache = atol(value);
                                 }
 
 
@@ -714,6 +1066,11 @@ void Load_YAML_Config( char *yaml_file )
 
                                 }
 
+                            else if ( !strcmp(last_pass, "fingerprint_cache" ) )
+                                {
+                                    MeerConfig->fingerprint_cache = atoi(value);
+                                }
+
                             else if ( !strcmp(last_pass, "fingerprint_writer" ) )
                                 {
 
@@ -1142,235 +1499,377 @@ void Load_YAML_Config( char *yaml_file )
                                 {
                                     if (!strcasecmp(value, "yes") || !strcasecmp(value, "true") || !strcasecmp(value, "enabled"))
                                         {
-                                            MeerOutput->redis_enabled = true;
+                                            redis->enabled = true;
                                         }
                                 }
 
-                            if (!strcmp(last_pass, "debug") && MeerOutput->redis_enabled == true )
+                            if (!strcmp(last_pass, "debug") && redis->enabled == true )
                                 {
                                     if (!strcasecmp(value, "yes") || !strcasecmp(value, "true") || !strcasecmp(value, "enabled"))
                                         {
-                                            MeerOutput->redis_debug = true;
+                                            redis->debug = true;
                                         }
                                 }
 
-                            if ( !strcmp(last_pass, "server") && MeerOutput->redis_enabled == true )
+                            if ( !strcmp(last_pass, "server") && redis->enabled == true )
                                 {
-                                    strlcpy(MeerOutput->redis_server, value, sizeof(MeerOutput->redis_server));
+                                    strlcpy(redis->server, value, sizeof(redis->server));
                                 }
 
-                            if ( !strcmp(last_pass, "password") && MeerOutput->redis_enabled == true )
+                            /* The reader connection is the plain "redis"
+                               block's,  for fingerprinting */
+
+                            if ( !strcmp(last_pass, "reader_server") && redis->enabled == true )
                                 {
-                                    strlcpy(MeerOutput->redis_password, value, sizeof(MeerOutput->redis_password));
+
+                                    if ( strcmp(redis->name, "redis") )
+                                        {
+                                            Meer_Log(ERROR, "[%s, line %d] '%s' -> 'reader_server' is only for the 'redis' block. Abort!", __FILE__, __LINE__, redis->name);
+                                        }
+
+                                    strlcpy(MeerOutput->redis_reader_server, value, sizeof(MeerOutput->redis_reader_server));
                                 }
 
-                            if ( !strcmp(last_pass, "key") && MeerOutput->redis_enabled == true )
+                            if ( !strcmp(last_pass, "reader_port" ) && redis->enabled == true )
                                 {
-                                    strlcpy(MeerOutput->redis_key, value, sizeof(MeerOutput->redis_key));
+
+                                    if ( strcmp(redis->name, "redis") )
+                                        {
+                                            Meer_Log(ERROR, "[%s, line %d] '%s' -> 'reader_port' is only for the 'redis' block. Abort!", __FILE__, __LINE__, redis->name);
+                                        }
+
+                                    MeerOutput->redis_reader_port = atoi(value);
+
+                                    if ( MeerOutput->redis_reader_port == 0 )
+                                        {
+                                            Meer_Log(ERROR, "Invalid configuration.  redis -> reader_port is invalid");
+                                        }
                                 }
 
-                            if ( !strcmp(last_pass, "mode") && MeerOutput->redis_enabled == true )
+                            if ( !strcmp(last_pass, "password") && redis->enabled == true )
+                                {
+                                    strlcpy(redis->password, value, sizeof(redis->password));
+                                }
+
+                            if ( !strcmp(last_pass, "key") && redis->enabled == true )
+                                {
+                                    strlcpy(redis->key, value, sizeof(redis->key));
+                                }
+
+                            if ( !strcmp(last_pass, "mode") && redis->enabled == true )
                                 {
                                     if ( strcmp(value, "list") && strcmp(value, "lpush") &&
                                             strcmp(value, "rpush" ) && strcmp(value, "channel") &&
-                                            strcmp(value, "publish" ) && strcmp(value, "set"  ) )
+                                            strcmp(value, "publish" ) && strcmp(value, "set"  ) &&
+                                            strcmp(value, "stream" ) && strcmp(value, "xadd" ) )
                                         {
-                                            Meer_Log(ERROR, "Invalid 'redis' -> 'mode'.  Must be list, lpush, rpush, channel, public or set . Abort");
+                                            Meer_Log(ERROR, "Invalid '%s' -> 'mode'.  Must be list, lpush, rpush, channel, public, set or stream. Abort", redis->name);
                                         }
 
                                     if ( !strcmp(value, "list") || !strcmp(value, "lpush" ) )
                                         {
-                                            strlcpy( MeerOutput->redis_command, "lpush", sizeof(MeerOutput->redis_command) );
+                                            strlcpy( redis->command, "lpush", sizeof(redis->command) );
                                         }
 
                                     if ( !strcmp(value, "rpush"))
                                         {
-                                            strlcpy( MeerOutput->redis_command, "rpush", sizeof(MeerOutput->redis_command) );
+                                            strlcpy( redis->command, "rpush", sizeof(redis->command) );
                                         }
 
                                     if ( !strcmp(value, "channel") || !strcmp(value, "publish" ) )
                                         {
-                                            strlcpy( MeerOutput->redis_command, "publish", sizeof(MeerOutput->redis_command) );
+                                            strlcpy( redis->command, "publish", sizeof(redis->command) );
                                         }
 
                                     if ( !strcmp(value, "set") )
                                         {
-                                            strlcpy( MeerOutput->redis_command, "set", sizeof(MeerOutput->redis_command) );
+                                            strlcpy( redis->command, "set", sizeof(redis->command) );
+                                        }
+
+                                    if ( !strcmp(value, "stream") || !strcmp(value, "xadd" ) )
+                                        {
+                                            strlcpy( redis->command, "xadd", sizeof(redis->command) );
+                                            redis->stream = true;
                                         }
 
                                 }
 
-                            if ( !strcmp(last_pass, "append_id" ) && MeerOutput->redis_enabled == true )
+                            if ( !strcmp(last_pass, "append_id" ) && redis->enabled == true )
                                 {
                                     if (!strcasecmp(value, "yes") || !strcasecmp(value, "true") || !strcasecmp(value, "enabled"))
                                         {
-                                            MeerOutput->redis_append_id = true;
+                                            redis->append_id = true;
+                                        }
+                                }
+
+                            if ( !strcmp(last_pass, "port" ) && redis->enabled == true )
+                                {
+
+                                    redis->port = atoi(value);
+
+                                    if ( redis->port == 0 )
+                                        {
+                                            Meer_Log(ERROR, "Invalid configuration.  %s -> port is invalid", redis->name);
+                                        }
+                                }
+
+                            if ( !strcmp(last_pass, "batch" ) && redis->enabled == true )
+                                {
+
+                                    redis->batch = atoi(value);
+
+                                    if ( redis->batch == 0 )
+                                        {
+                                            Meer_Log(ERROR, "Invalid configuration.  %s -> batch is invalid", redis->name);
+                                        }
+                                }
+
+                            if ( !strcmp(last_pass, "shards" ) && redis->enabled == true )
+                                {
+
+                                    char *shard_ptr = NULL;
+                                    char *port_ptr = NULL;
+                                    char *tok = NULL;
+
+                                    Remove_Spaces(value);
+
+                                    shard_ptr = strtok_r(value, ",", &tok);
+
+                                    while ( shard_ptr != NULL )
+                                        {
+
+                                            if ( redis->shard_count >= REDIS_MAX_SHARDS )
+                                                {
+                                                    Meer_Log(ERROR, "[%s, line %d] Too many '%s' -> 'shards' entries. The max is %d. Abort!", __FILE__, __LINE__, redis->name, REDIS_MAX_SHARDS);
+                                                }
+
+                                            /* "host:port".  Port defaults to 6379 */
+
+                                            redis->shard_port[redis->shard_count] = 6379;
+
+                                            port_ptr = strchr(shard_ptr, ':');
+
+                                            if ( port_ptr != NULL )
+                                                {
+
+                                                    *port_ptr = '\0';
+
+                                                    redis->shard_port[redis->shard_count] = atoi(port_ptr + 1);
+
+                                                    if ( redis->shard_port[redis->shard_count] == 0 )
+                                                        {
+                                                            Meer_Log(ERROR, "Invalid configuration.  %s -> shards port for '%s' is invalid", redis->name, shard_ptr);
+                                                        }
+                                                }
+
+                                            strlcpy(redis->shard_server[redis->shard_count], shard_ptr, sizeof(redis->shard_server[0]));
+                                            redis->shard_count++;
+
+                                            shard_ptr = strtok_r(NULL, ",", &tok);
+                                        }
+
+                                }
+
+                            if ( !strcmp(last_pass, "shard_by" ) && redis->enabled == true )
+                                {
+
+                                    if ( !strcmp(value, "key") )
+                                        {
+                                            redis->shard_by_key = true;
+                                        }
+
+                                    else if ( strcmp(value, "flow_id") )
+                                        {
+                                            Meer_Log(ERROR, "Invalid '%s' -> 'shard_by'.  Must be flow_id or key. Abort", redis->name);
                                         }
                                 }
 
-                            if ( !strcmp(last_pass, "port" ) && MeerOutput->redis_enabled == true )
+                            if ( !strcmp(last_pass, "stream_maxlen" ) && redis->enabled == true )
                                 {
+                                    redis->stream_maxlen = atoi(value);
+                                }
 
-                                    MeerOutput->redis_port = atoi(value);
+                            /* Older names for "worker_queue" and
+                               "worker_queue_full".  Redis is always
+                               written by its worker now,  so 0 no longer
+                               means "from the decode thread". */
 
-                                    if ( MeerOutput->redis_port == 0 )
+                            if ( !strcmp(last_pass, "queue" ) && redis->enabled == true )
+                                {
+
+                                    redis->worker.size = atoi(value);
+
+                                    if ( redis->worker.size == 0 )
                                         {
-                                            Meer_Log(ERROR, "Invalid configuration.  redis -> port is invalid");
+                                            Meer_Log(ERROR, "[%s, line %d] '%s' -> 'queue' must be at least 1. Abort!", __FILE__, __LINE__, redis->name);
                                         }
                                 }
 
-                            if ( !strcmp(last_pass, "batch" ) && MeerOutput->redis_enabled == true )
+                            if ( !strcmp(last_pass, "queue_full" ) && redis->enabled == true )
                                 {
 
-                                    MeerOutput->redis_batch = atoi(value);
+                                    if ( !strcmp(value, "block") )
+                                        {
+                                            redis->worker.full = OUTPUT_QUEUE_BLOCK;
+                                        }
+
+                                    else if ( !strcmp(value, "drop-oldest") )
+                                        {
+                                            redis->worker.full = OUTPUT_QUEUE_DROP_OLDEST;
+                                        }
+
+                                    else if ( !strcmp(value, "spill") )
+                                        {
+                                            Meer_Log(ERROR, "'%s' -> 'queue_full: spill' has been replaced by 'spill_directory',  which is replayed once Redis is back. Abort", redis->name);
+                                        }
 
-                                    if ( MeerOutput->redis_batch == 0 )
+                                    else
                                         {
-                                            Meer_Log(ERROR, "Invalid configuration.  redis -> batch is invalid");
+                                            Meer_Log(ERROR, "Invalid '%s' -> 'queue_full'.  Must be block or drop-oldest. Abort", redis->name);
                                         }
                                 }
 
-                            if ( !strcmp(last_pass, "routing" ) && MeerOutput->redis_enabled == true )
+                            if ( !strcmp(last_pass, "routing" ) && redis->enabled == true )
                                 {
                                     routing = true;
                                 }
 
-                            if ( routing == true && MeerOutput->redis_enabled == true )
+                            if ( routing == true && redis->enabled == true )
                                 {
 
                                     if ( !strcmp(value, "alert" ) )
                                         {
-                                            MeerOutput->redis_alert = true;
+                                            redis->alert = true;
                                         }
 
                                     else if ( !strcmp(value, "files" ) )
                                         {
-                                            MeerOutput->redis_files = true;
+                                            redis->files = true;
                                         }
 
                                     else if ( !strcmp(value, "flow" ) )
                                         {
-                                            MeerOutput->redis_flow = true;
+                                            redis->flow = true;
                                         }
 
                                     else if ( !strcmp(value, "dns" ) )
                                         {
-                                            MeerOutput->redis_dns = true;
+                                            redis->dns = true;
                                         }
 
                                     else if ( !strcmp(value, "http" ) )
                                         {
-                                            MeerOutput->redis_http = true;
+                                            redis->http = true;
                                         }
 
                                     else if ( !strcmp(value, "tls" ) )
                                         {
-                                            MeerOutput->redis_tls = true;
+                                            redis->tls = true;
                                         }
 
                                     else if ( !strcmp(value, "ssh" ) )
                                         {
-                                            MeerOutput->redis_ssh = true;
+                                            redis->ssh = true;
                                         }
 
                                     else if ( !strcmp(value, "smtp" ) )
                                         {
-                                            MeerOutput->redis_smtp = true;
+                                            redis->smtp = true;
                                         }
 
                                     else if ( !strcmp(value, "email" ) )
                                         {
-                                            MeerOutput->redis_email = true;
+                                            redis->email = true;
                                         }
 
                                     else if ( !strcmp(value, "fileinfo" ) )
                                         {
-                                            MeerOutput->redis_fileinfo = true;
+                                            redis->fileinfo = true;
                                         }
 
                                     else if ( !strcmp(value, "dhcp" ) )
                                         {
-                                            MeerOutput->redis_dhcp = true;
+                                            redis->dhcp = true;
                                         }
 
                                     else if ( !strcmp(value, "stats" ) )
                                         {
-                                            MeerOutput->redis_stats = true;
+                                            redis->stats = true;
                                         }
 
                                     else if ( !strcmp(value, "rdp" ) )
                                         {
-                                            MeerOutput->redis_rdp  = true;
+                                            redis->rdp  = true;
                                         }
 
                                     else if ( !strcmp(value, "sip" ) )
                                         {
-                                            MeerOutput->redis_sip = true;
+                                            redis->sip = true;
                                         }
 
                                     else if ( !strcmp(value, "ftp" ) )
                                         {
-                                            MeerOutput->redis_ftp = true;
+                                            redis->ftp = true;
                                         }
 
                                     else if ( !strcmp(value, "ikev2" ) )
                                         {
-                                            MeerOutput->redis_ikev2 = true;
+                                            redis->ikev2 = true;
                                         }
 
                                     else if ( !strcmp(value, "nfs" ) )
                                         {
-                                            MeerOutput->redis_nfs = true;
+                                            redis->nfs = true;
                                         }
 
                                     else if ( !strcmp(value, "tftp" ) )
                                         {
-                                            MeerOutput->redis_tftp = true;
+                                            redis->tftp = true;
                                         }
 
                                     else if ( !strcmp(value, "smb" ) )
                                         {
-                                            MeerOutput->redis_smb = true;
+                                            redis->smb = true;
                                         }
 
                                     else if ( !strcmp(value, "dcerpc" ) )
                                         {
-                                            MeerOutput->redis_dcerpc = true;
+                                            redis->dcerpc = true;
                                         }
 
                                     else if ( !strcmp(value, "mqtt" ) )
                                         {
-                                            MeerOutput->redis_mqtt = true;
+                                            redis->mqtt = true;
                                         }
 
                                     else if ( !strcmp(value, "netflow" ) )
                                         {
-                                            MeerOutput->redis_netflow = true;
+                                            redis->netflow = true;
                                         }
 
                                     else if ( !strcmp(value, "metadata" ) )
                                         {
-                                            MeerOutput->redis_metadata = true;
+                                            redis->metadata = true;
                                         }
 
                                     else if ( !strcmp(value, "dnp3" ) )
                                         {
-                                            MeerOutput->redis_dnp3 = true;
+                                            redis->dnp3 = true;
                                         }
 
                                     else if ( !strcmp(value, "anomaly" ) )
                                         {
-                                            MeerOutput->redis_anomaly = true;
+                                            redis->anomaly = true;
                                         }
 
                                     else if ( !strcmp(value, "fingerprint" ) )
                                         {
-                                            MeerOutput->redis_fingerprint = true;
+                                            redis->fingerprint = true;
                                         }
 
                                     else if ( !strcmp(value, "client_stats" ) )
                                         {
-                                            MeerOutput->redis_client_stats = true;
+                                            redis->client_stats = true;
                                         }
 
                                 }
@@ -1404,30 +1903,30 @@ void Load_YAML_Config( char *yaml_file )
                                 {
                                     if (!strcasecmp(value, "yes") || !strcasecmp(value, "true") || !strcasecmp(value, "enabled"))
                                         {
-                                            MeerOutput->elasticsearch_enabled = true;
+                                            es->enabled = true;
                                         }
                                 }
 
-                            if ( MeerOutput->elasticsearch_enabled == true && !strcmp(last_pass, "debug") )
+                            if ( es->enabled == true && !strcmp(last_pass, "debug") )
                                 {
 
                                     if (!strcasecmp(value, "yes") || !strcasecmp(value, "true") || !strcasecmp(value, "enabled"))
                                         {
-                                            MeerOutput->elasticsearch_debug = true;
+                                            es->debug = true;
                                         }
                                 }
 
-                            if ( MeerOutput->elasticsearch_enabled == true && !strcmp(last_pass, "insecure") )
+                            if ( es->enabled == true && !strcmp(last_pass, "insecure") )
                                 {
 
                                     if (!strcasecmp(value, "yes") || !strcasecmp(value, "true") || !strcasecmp(value, "enabled"))
                                         {
-                                            MeerOutput->elasticsearch_insecure = true;
+                                            es->insecure = true;
                                         }
                                 }
 
 
-                            if ( MeerOutput->elasticsearch_enabled == true && !strcmp(last_pass, "url") )
+                            if ( es->enabled == true && !strcmp(last_pass, "url") )
                                 {
 
                                     if ( value[0] == '\0' )
@@ -1435,10 +1934,10 @@ void Load_YAML_Config( char *yaml_file )
                                             Meer_Log(ERROR, "Invalid configuration.  'elasticsearch' url is invalid");
                                         }
 
-                                    strlcpy(MeerOutput->elasticsearch_url, value, sizeof(MeerOutput->elasticsearch_url));
+                                    strlcpy(es->url, value, sizeof(es->url));
                                 }
 
-                            if ( MeerOutput->elasticsearch_enabled == true && !strcmp(last_pass, "index") )
+                            if ( es->enabled == true && !strcmp(last_pass, "index") )
                                 {
 
                                     if ( value[0] == '\0' )
@@ -1446,10 +1945,10 @@ void Load_YAML_Config( char *yaml_file )
                                             Meer_Log(ERROR, "Invalid configuration.  'elasticsearch' index is invalid");
                                         }
 
-                                    strlcpy(MeerOutput->elasticsearch_index, value, sizeof(MeerOutput->elasticsearch_index));
+                                    strlcpy(es->index, value, sizeof(es->index));
                                 }
 
-                            if ( MeerOutput->elasticsearch_enabled == true && !strcmp(last_pass, "username") )
+                            if ( es->enabled == true && !strcmp(last_pass, "username") )
                                 {
 
                                     if ( value[0] == '\0' )
@@ -1457,10 +1956,10 @@ void Load_YAML_Config( char *yaml_file )
                                             Meer_Log(ERROR, "Invalid configuration. 'elasticsearch' username is invalid");
                                         }
 
-                                    strlcpy(MeerOutput->elasticsearch_username, value, sizeof(MeerOutput->elasticsearch_username));
+                                    strlcpy(es->username, value, sizeof(es->username));
                                 }
 
-                            if ( MeerOutput->elasticsearch_enabled == true && !strcmp(last_pass, "password") )
+                            if ( es->enabled == true && !strcmp(last_pass, "password") )
                                 {
 
                                     if ( value[0] == '\0' )
@@ -1468,172 +1967,308 @@ void Load_YAML_Config( char *yaml_file )
                                             Meer_Log(ERROR, "Invalid configuration. 'elasticsearch' password is invalid");
                                         }
 
-                                    strlcpy(MeerOutput->elasticsearch_password, value, sizeof(MeerOutput->elasticsearch_password));
+                                    strlcpy(es->password, value, sizeof(es->password));
                                 }
 
-                            if ( MeerOutput->elasticsearch_enabled == true && !strcmp(last_pass, "batch") )
+                            if ( es->enabled == true && !strcmp(last_pass, "batch") )
                                 {
 
-                                    MeerOutput->elasticsearch_batch = atoi(value);
+                                    es->batch = atoi(value);
 
-                                    if ( MeerOutput->elasticsearch_batch == 0 )
+                                    if ( es->batch == 0 )
                                         {
                                             Meer_Log(ERROR, "Invalid configuration. 'elasticsearch' batch is invalid");
                                         }
                                 }
 
-                            if ( MeerOutput->elasticsearch_enabled == true && !strcmp(last_pass, "threads") )
+                            if ( es->enabled == true && !strcmp(last_pass, "threads") )
                                 {
 
-                                    MeerOutput->elasticsearch_threads = atoi(value);
+                                    es->threads = atoi(value);
 
-                                    if ( MeerOutput->elasticsearch_threads == 0 )
+                                    if ( es->threads == 0 )
                                         {
                                             Meer_Log(ERROR, "Invalid configuration. 'elasticsearch' threads is invalid");
                                         }
                                 }
 
-                            if ( !strcmp(last_pass, "routing" ) && MeerOutput->elasticsearch_enabled == true )
+                            if ( es->enabled == true && !strcmp(last_pass, "queue") )
+                                {
+                                    es->queue = atoi(value);
+                                }
+
+                            if ( es->enabled == true && !strcmp(last_pass, "max_body") )
+                                {
+
+                                    if ( strlen(value) < 3 ||
+                                            ( ( value[ strlen(value) - 2 ] != 'k' || value[ strlen(value) - 1 ] != 'b' ) &&
+                                              ( value[ strlen(value) - 2 ] != 'm' || value[ strlen(value) - 1 ] != 'b' ) &&
+                                              ( value[ strlen(value) - 2 ] != 'g' || value[ strlen(value) - 1 ] != 'b' ) ) )
+                                        {
+                                            Meer_Log(ERROR, "[%s, line %d] The 'elasticsearch' 'max_body' has an invalid size.  It needs to be kb, mb or gb.", __FILE__, __LINE__);
+                                        }
+
+                                    strlcpy(tmp, value, sizeof(tmp));
+                                    tmp[ strlen(tmp) - 2 ] = '\0';		/* Remove kb, mb, gb */
+
+                                    if ( value[ strlen(value) - 2 ] == 'k' )
+                                        {
+                                            es->max_body = strtoull(tmp, NULL, 10) * 1024;
+                                        }
+
+                                    else if ( value[ strlen(value) - 2 ] == 'm' )
+                                        {
+                                            es->max_body = strtoull(tmp, NULL, 10) * 1024 * 1024;
+                                        }
+
+                                    else
+                                        {
+                                            es->max_body = strtoull(tmp, NULL, 10) * 1024 * 1024 * 1024;
+                                        }
+
+                                    if ( es->max_body == 0 )
+                                        {
+                                            Meer_Log(ERROR, "Invalid configuration. 'elasticsearch' max_body is invalid");
+                                        }
+                                }
+
+                            if ( es->enabled == true && !strcmp(last_pass, "compression") )
+                                {
+
+                                    if ( !strcasecmp(value, "gzip") )
+                                        {
+#ifndef HAVE_LIBZ
+                                            Meer_Log(ERROR, "[%s, line %d] 'elasticsearch' 'compression' is 'gzip' but Meer wasn't compiled with libz support.  Abort!", __FILE__, __LINE__);
+#endif
+                                            es->gzip = true;
+                                        }
+
+                                    else if ( strcasecmp(value, "none") )
+                                        {
+                                            Meer_Log(ERROR, "[%s, line %d] 'elasticsearch' 'compression' must be 'gzip' or 'none'.  Abort!", __FILE__, __LINE__);
+                                        }
+                                }
+
+                            if ( es->enabled == true && !strcmp(last_pass, "compression_level") )
+                                {
+
+                                    es->gzip_level = atoi(value);
+
+                                    if ( es->gzip_level < 1 || es->gzip_level > 9 )
+                                        {
+                                            Meer_Log(ERROR, "Invalid configuration. 'elasticsearch' compression_level must be 1 - 9");
+                                        }
+                                }
+
+                            if ( es->enabled == true && !strcmp(last_pass, "index_date") )
+                                {
+
+                                    if ( !strcasecmp(value, "event") )
+                                        {
+                                            es->index_event_date = true;
+                                        }
+
+                                    else if ( strcasecmp(value, "now") )
+                                        {
+                                            Meer_Log(ERROR, "[%s, line %d] 'elasticsearch' 'index_date' must be 'now' or 'event'.  Abort!", __FILE__, __LINE__);
+                                        }
+                                }
+
+                            if ( es->enabled == true && !strcmp(last_pass, "document_id") )
+                                {
+
+                                    if ( !strcasecmp(value, "hash") )
+                                        {
+                                            es->document_id = true;
+                                        }
+
+                                    else if ( strcasecmp(value, "none") )
+                                        {
+                                            Meer_Log(ERROR, "[%s, line %d] 'elasticsearch' 'document_id' must be 'none' or 'hash'.  Abort!", __FILE__, __LINE__);
+                                        }
+                                }
+
+                            if ( es->enabled == true && !strcmp(last_pass, "engine") )
+                                {
+
+                                    if ( !strcasecmp(value, "multi") )
+                                        {
+                                            es->multi = true;
+                                        }
+
+                                    else if ( strcasecmp(value, "threads") )
+                                        {
+                                            Meer_Log(ERROR, "[%s, line %d] 'elasticsearch' 'engine' must be 'threads' or 'multi'.  Abort!", __FILE__, __LINE__);
+                                        }
+                                }
+
+                            if ( es->enabled == true && !strcmp(last_pass, "concurrency") )
+                                {
+
+                                    es->concurrency = atoi(value);
+
+                                    if ( es->concurrency == 0 )
+                                        {
+                                            Meer_Log(ERROR, "Invalid configuration. 'elasticsearch' concurrency is invalid");
+                                        }
+                                }
+
+                            if ( es->enabled == true && !strcmp(last_pass, "flush_interval") )
+                                {
+                                    es->flush_interval = atoi(value);
+                                }
+
+                            if ( es->enabled == true && !strcmp(last_pass, "retries") )
+                                {
+                                    es->retries = atoi(value);
+                                }
+
+                            if ( es->enabled == true && !strcmp(last_pass, "dead_letter") )
+                                {
+                                    strlcpy(es->dead_letter, value, sizeof(es->dead_letter));
+                                }
+
+                            if ( !strcmp(last_pass, "routing" ) && es->enabled == true )
                                 {
                                     routing = true;
                                 }
 
-                            if ( routing == true && MeerOutput->elasticsearch_enabled == true )
+                            if ( routing == true && es->enabled == true )
                                 {
 
                                     if ( !strcmp(value, "alert" ) )
                                         {
-                                            MeerOutput->elasticsearch_alert = true;
+                                            es->alert = true;
                                         }
 
                                     else if ( !strcmp(value, "files" ) )
                                         {
-                                            MeerOutput->elasticsearch_files = true;
+                                            es->files = true;
                                         }
 
                                     else if ( !strcmp(value, "flow" ) )
                                         {
-                                            MeerOutput->elasticsearch_flow = true;
+                                            es->flow = true;
                                         }
 
                                     else if ( !strcmp(value, "dns" ) )
                                         {
-                                            MeerOutput->elasticsearch_dns = true;
+                                            es->dns = true;
                                         }
 
                                     else if ( !strcmp(value, "http" ) )
                                         {
-                                            MeerOutput->elasticsearch_http = true;
+                                            es->http = true;
                                         }
 
                                     else if ( !strcmp(value, "tls" ) )
                                         {
-                                            MeerOutput->elasticsearch_tls = true;
+                                            es->tls = true;
                                         }
 
                                     else if ( !strcmp(value, "ssh" ) )
                                         {
-                                            MeerOutput->elasticsearch_ssh = true;
+                                            es->ssh = true;
                                         }
 
                                     else if ( !strcmp(value, "smtp" ) )
                                         {
-                                            MeerOutput->elasticsearch_smtp = true;
+                                            es->smtp = true;
                                         }
 
                                     else if ( !strcmp(value, "email" ) )
                                         {
-                                            MeerOutput->elasticsearch_email = true;
+                                            es->email = true;
                                         }
 
                                     else if ( !strcmp(value, "fileinfo" ) )
                                         {
-                                            MeerOutput->elasticsearch_fileinfo = true;
+                                            es->fileinfo = true;
                                         }
 
                                     else if ( !strcmp(value, "dhcp" ) )
                                         {
-                                            MeerOutput->elasticsearch_dhcp = true;
+                                            es->dhcp = true;
                                         }
 
                                     else if ( !strcmp(value, "stats" ) )
                                         {
-                                            MeerOutput->elasticsearch_stats = true;
+                                            es->stats = true;
                                         }
 
                                     else if ( !strcmp(value, "rdp" ) )
                                         {
-                                            MeerOutput->elasticsearch_rdp  = true;
+                                            es->rdp  = true;
                                         }
 
                                     else if ( !strcmp(value, "sip" ) )
                                         {
-                                            MeerOutput->elasticsearch_sip = true;
+                                            es->sip = true;
                                         }
 
                                     else if ( !strcmp(value, "ftp" ) )
                                         {
-                                            MeerOutput->elasticsearch_ftp = true;
+                                            es->ftp = true;
                                         }
 
                                     else if ( !strcmp(value, "ikev2" ) )
                                         {
-                                            MeerOutput->elasticsearch_ikev2 = true;
+                                            es->ikev2 = true;
                                         }
 
                                     else if ( !strcmp(value, "nfs" ) )
                                         {
-                                            MeerOutput->elasticsearch_nfs = true;
+                                            es->nfs = true;
                                         }
 
                                     else if ( !strcmp(value, "tftp" ) )
                                         {
-                                            MeerOutput->elasticsearch_tftp = true;
+                                            es->tftp = true;
                                         }
 
                                     else if ( !strcmp(value, "smb" ) )
                                         {
-                                            MeerOutput->elasticsearch_smb = true;
+                                            es->smb = true;
                                         }
 
                                     else if ( !strcmp(value, "dcerpc" ) )
                                         {
-                                            MeerOutput->elasticsearch_dcerpc = true;
+                                            es->dcerpc = true;
                                         }
 
                                     else if ( !strcmp(value, "mqtt" ) )
                                         {
-                                            MeerOutput->elasticsearch_mqtt = true;
+                                            es->mqtt = true;
                                         }
 
                                     else if ( !strcmp(value, "netflow" ) )
                                         {
-                                            MeerOutput->elasticsearch_netflow = true;
+                                            es->netflow = true;
                                         }
 
                                     else if ( !strcmp(value, "metadata" ) )
                                         {
-                                            MeerOutput->elasticsearch_metadata = true;
+                                            es->metadata = true;
                                         }
 
                                     else if ( !strcmp(value, "dnp3" ) )
                                         {
-                                            MeerOutput->elasticsearch_dnp3 = true;
+                                            es->dnp3 = true;
                                         }
 
                                     else if ( !strcmp(value, "anomaly" ) )
                                         {
-                                            MeerOutput->elasticsearch_anomaly = true;
+                                            es->anomaly = true;
                                         }
 
                                     else if ( !strcmp(value, "fingerprint" ) )
                                         {
-                                            MeerOutput->elasticsearch_fingerprint = true;
+                                            es->fingerprint = true;
                                         }
 
                                     else if ( !strcmp(value, "ndp" ) )
                                         {
-                                            MeerOutput->elasticsearch_ndp = true;
+                                            es->ndp = true;
                                         }
                                 }
 
@@ -2056,7 +2691,7 @@ void Load_YAML_Config( char *yaml_file )
                                     routing = true;
                                 }
 
-                            if ( routing == true && MeerOutput->file_enabled == true )
+                            if ( routing == true && MeerOutput->syslog_enabled == true )
                                 {
 
                                     if ( !strcmp(value, "alert" ) )
@@ -2203,151 +2838,151 @@ void Load_YAML_Config( char *yaml_file )
 
                                     if ( !strcasecmp(value, "yes") || !strcasecmp(value, "true" ) || !strcasecmp(value, "enabled"))
                                         {
-                                            MeerOutput->file_enabled = true;
+                                            file->enabled = true;
                                         }
                                 }
 
-                            if ( !strcmp(last_pass, "file_location") && MeerOutput->file_enabled == true )
+                            if ( !strcmp(last_pass, "file_location") && file->enabled == true )
                                 {
-                                    strlcpy(MeerOutput->file_location, value, sizeof(MeerOutput->file_location));
+                                    strlcpy(file->location, value, sizeof(file->location));
                                 }
 
-                            if ( !strcmp(last_pass, "routing" ) && MeerOutput->file_enabled == true )
+                            if ( !strcmp(last_pass, "routing" ) && file->enabled == true )
                                 {
                                     routing = true;
                                 }
 
-                            if ( routing == true && MeerOutput->file_enabled == true )
+                            if ( routing == true && file->enabled == true )
                                 {
 
                                     if ( !strcmp(value, "alert" ) )
                                         {
-                                            MeerOutput->file_alert = true;
+                                            file->alert = true;
                                         }
 
                                     else if ( !strcmp(value, "files" ) )
                                         {
-                                            MeerOutput->file_files = true;
+                                            file->files = true;
                                         }
 
                                     else if ( !strcmp(value, "flow" ) )
                                         {
-                                            MeerOutput->file_flow = true;
+                                            file->flow = true;
                                         }
 
                                     else if ( !strcmp(value, "dns" ) )
                                         {
-                                            MeerOutput->file_dns = true;
+                                            file->dns = true;
                                         }
 
                                     else if ( !strcmp(value, "http" ) )
                                         {
-                                            MeerOutput->file_http = true;
+                                            file->http = true;
                                         }
 
                                     else if ( !strcmp(value, "tls" ) )
                                         {
-                                            MeerOutput->file_tls = true;
+                                            file->tls = true;
                                         }
 
                                     else if ( !strcmp(value, "ssh" ) )
                                         {
-                                            MeerOutput->file_ssh = true;
+                                            file->ssh = true;
                                         }
 
                                     else if ( !strcmp(value, "smtp" ) )
                                         {
-                                            MeerOutput->file_smtp = true;
+                                            file->smtp = true;
                                         }
 
                                     else if ( !strcmp(value, "email" ) )
                                         {
-                                            MeerOutput->file_email = true;
+                                            file->email = true;
                                         }
 
                                     else if ( !strcmp(value, "fileinfo" ) )
                                         {
-                                            MeerOutput->file_fileinfo = true;
+                                            file->fileinfo = true;
                                         }
 
                                     else if ( !strcmp(value, "dhcp" ) )
                                         {
-                                            MeerOutput->file_dhcp = true;
+                                            file->dhcp = true;
                                         }
 
                                     else if ( !strcmp(value, "stats" ) )
                                         {
-                                            MeerOutput->file_stats = true;
+                                            file->stats = true;
                                         }
 
                                     else if ( !strcmp(value, "rdp" ) )
                                         {
-                                            MeerOutput->file_rdp  = true;
+                                            file->rdp  = true;
                                         }
 
                                     else if ( !strcmp(value, "sip" ) )
                                         {
-                                            MeerOutput->file_sip = true;
+                                            file->sip = true;
                                         }
 
                                     else if ( !strcmp(value, "ftp" ) )
                                         {
-                                            MeerOutput->file_ftp = true;
+                                            file->ftp = true;
                                         }
 
                                     else if ( !strcmp(value, "ikev2" ) )
                                         {
-                                            MeerOutput->file_ikev2 = true;
+                                            file->ikev2 = true;
                                         }
 
                                     else if ( !strcmp(value, "nfs" ) )
                                         {
-                                            MeerOutput->file_nfs = true;
+                                            file->nfs = true;
                                         }
 
                                     else if ( !strcmp(value, "tftp" ) )
                                         {
-                                            MeerOutput->file_tftp = true;
+                                            file->tftp = true;
                                         }
 
                                     else if ( !strcmp(value, "smb" ) )
                                         {
-                                            MeerOutput->file_smb = true;
+                                            file->smb = true;
                                         }
 
                                     else if ( !strcmp(value, "dcerpc" ) )
                                         {
-                                            MeerOutput->file_dcerpc = true;
+                                            file->dcerpc = true;
                                         }
 
                                     else if ( !strcmp(value, "mqtt" ) )
                                         {
-                                            MeerOutput->file_mqtt = true;
+                                            file->mqtt = true;
                                         }
 
                                     else if ( !strcmp(value, "netflow" ) )
                                         {
-                                            MeerOutput->file_netflow = true;
+                                            file->netflow = true;
                                         }
 
                                     else if ( !strcmp(value, "metadata" ) )
                                         {
-                                            MeerOutput->file_metadata = true;
+                                            file->metadata = true;
                                         }
 
                                     else if ( !strcmp(value, "dnp3" ) )
                                         {
-                                            MeerOutput->file_dnp3 = true;
+                                            file->dnp3 = true;
                                         }
 
                                     else if ( !strcmp(value, "anomaly" ) )
                                         {
-                                            MeerOutput->file_anomaly = true;
+                                            file->anomaly = true;
                                         }
 
                                     else if ( !strcmp(value, "fingerprint" ) )
                                         {
-                                            MeerOutput->file_fingerprint = true;
+                                            file->fingerprint = true;
                                         }
 
                                 }
@@ -2361,32 +2996,32 @@ void Load_YAML_Config( char *yaml_file )
 
                                     if ( !strcasecmp(value, "yes") || !strcasecmp(value, "true" ) || !strcasecmp(value, "enabled"))
                                         {
-                                            MeerOutput->pipe_enabled = true;
+                                            pipe_out->enabled = true;
                                         }
 
                                 }
 
-                            if ( !strcmp(last_pass, "pipe_location") && MeerOutput->pipe_enabled == true )
+                            if ( !strcmp(last_pass, "pipe_location") && pipe_out->enabled == true )
                                 {
-                                    strlcpy(MeerOutput->pipe_location, value, sizeof(MeerOutput->pipe_location));
+                                    strlcpy(pipe_out->location, value, sizeof(pipe_out->location));
                                 }
 
-                            if ( !strcmp(last_pass, "pipe_size" ) && MeerOutput->pipe_enabled == true )
+                            if ( !strcmp(last_pass, "pipe_size" ) && pipe_out->enabled == true )
                                 {
 
-                                    MeerOutput->pipe_size = atoi(value);
+                                    pipe_out->size = atoi(value);
 
-                                    if ( MeerOutput->pipe_size == 0 )
+                                    if ( pipe_out->size == 0 )
                                         {
                                             Meer_Log(ERROR, "Invalid configuration.  'pipe_size' is invalid");
                                         }
 
 
-                                    if ( MeerOutput->pipe_size != 65536 &&
-                                            MeerOutput->pipe_size != 131072 &&
-                                            MeerOutput->pipe_size != 262144 &&
-                                            MeerOutput->pipe_size != 524288 &&
-                                            MeerOutput->pipe_size != 1048576 )
+                                    if ( pipe_out->size != 65536 &&
+                                            pipe_out->size != 131072 &&
+                                            pipe_out->size != 262144 &&
+                                            pipe_out->size != 524288 &&
+                                            pipe_out->size != 1048576 )
                                         {
 
                                             Meer_Log(ERROR, "Invalid configuration. 'pipe_size' must be 65536, 131072, 262144, 524288 or 1048576. Abort!");
@@ -2395,142 +3030,142 @@ void Load_YAML_Config( char *yaml_file )
 
                                 }
 
-                            if ( !strcmp(last_pass, "routing" ) && MeerOutput->pipe_enabled == true )
+                            if ( !strcmp(last_pass, "routing" ) && pipe_out->enabled == true )
                                 {
                                     routing = true;
                                 }
 
-                            if ( routing == true && MeerOutput->pipe_enabled == true )
+                            if ( routing == true && pipe_out->enabled == true )
                                 {
 
                                     if ( !strcmp(value, "alert" ) )
                                         {
-                                            MeerOutput->pipe_alert = true;
+                                            pipe_out->alert = true;
                                         }
 
                                     else if ( !strcmp(value, "files" ) )
                                         {
-                                            MeerOutput->pipe_files = true;
+                                            pipe_out->files = true;
                                         }
 
                                     else if ( !strcmp(value, "flow" ) )
                                         {
-                                            MeerOutput->pipe_flow = true;
+                                            pipe_out->flow = true;
                                         }
 
                                     else if ( !strcmp(value, "dns" ) )
                                         {
-                                            MeerOutput->pipe_dns = true;
+                                            pipe_out->dns = true;
                                         }
 
                                     else if ( !strcmp(value, "http" ) )
                                         {
-                                            MeerOutput->pipe_http = true;
+                                            pipe_out->http = true;
                                         }
 
                                     else if ( !strcmp(value, "tls" ) )
                                         {
-                                            MeerOutput->pipe_tls = true;
+                                            pipe_out->tls = true;
                                         }
 
                                     else if ( !strcmp(value, "ssh" ) )
                                         {
-                                            MeerOutput->pipe_ssh = true;
+                                            pipe_out->ssh = true;
                                         }
 
                                     else if ( !strcmp(value, "smtp" ) )
                                         {
-                                            MeerOutput->pipe_smtp = true;
+                                            pipe_out->smtp = true;
                                         }
 
                                     else if ( !strcmp(value, "email" ) )
                                         {
-                                            MeerOutput->pipe_email = true;
+                                            pipe_out->email = true;
                                         }
 
                                     else if ( !strcmp(value, "fileinfo" ) )
                                         {
-                                            MeerOutput->pipe_fileinfo = true;
+                                            pipe_out->fileinfo = true;
                                         }
 
                                     else if ( !strcmp(value, "dhcp" ) )
                                         {
-                                            MeerOutput->pipe_dhcp = true;
+                                            pipe_out->dhcp = true;
                                         }
 
                                     else if ( !strcmp(value, "stats" ) )
                                         {
-                                            MeerOutput->pipe_stats = true;
+                                            pipe_out->stats = true;
                                         }
 
                                     else if ( !strcmp(value, "rdp" ) )
                                         {
-                                            MeerOutput->pipe_rdp  = true;
+                                            pipe_out->rdp  = true;
                                         }
 
                                     else if ( !strcmp(value, "sip" ) )
                                         {
-                                            MeerOutput->pipe_sip = true;
+                                            pipe_out->sip = true;
                                         }
 
                                     else if ( !strcmp(value, "ftp" ) )
                                         {
-                                            MeerOutput->pipe_ftp = true;
+                                            pipe_out->ftp = true;
                                         }
 
                                     else if ( !strcmp(value, "ikev2" ) )
                                         {
-                                            MeerOutput->pipe_ikev2 = true;
+                                            pipe_out->ikev2 = true;
                                         }
 
                                     else if ( !strcmp(value, "nfs" ) )
                                         {
-                                            MeerOutput->pipe_nfs = true;
+                                            pipe_out->nfs = true;
                                         }
 
                                     else if ( !strcmp(value, "tftp" ) )
                                         {
-                                            MeerOutput->pipe_tftp = true;
+                                            pipe_out->tftp = true;
                                         }
 
                                     else if ( !strcmp(value, "smb" ) )
                                         {
-                                            MeerOutput->pipe_smb = true;
+                                            pipe_out->smb = true;
                                         }
 
                                     else if ( !strcmp(value, "dcerpc" ) )
                                         {
-                                            MeerOutput->pipe_dcerpc = true;
+                                            pipe_out->dcerpc = true;
                                         }
 
                                     else if ( !strcmp(value, "mqtt" ) )
                                         {
-                                            MeerOutput->pipe_mqtt = true;
+                                            pipe_out->mqtt = true;
                                         }
 
                                     else if ( !strcmp(value, "netflow" ) )
                                         {
-                                            MeerOutput->pipe_netflow = true;
+                                            pipe_out->netflow = true;
                                         }
 
                                     else if ( !strcmp(value, "metadata" ) )
                                         {
-                                            MeerOutput->pipe_metadata = true;
+                                            pipe_out->metadata = true;
                                         }
 
                                     else if ( !strcmp(value, "dnp3" ) )
                                         {
-                                            MeerOutput->pipe_dnp3 = true;
+                                            pipe_out->dnp3 = true;
                                         }
 
                                     else if ( !strcmp(value, "anomaly" ) )
                                         {
-                                            MeerOutput->pipe_anomaly = true;
+                                            pipe_out->anomaly = true;
                                         }
 
                                     else if ( !strcmp(value, "fingerprint" ) )
                                         {
-                                            MeerOutput->pipe_fingerprint = true;
+                                            pipe_out->fingerprint = true;
                                         }
                                 }
 
@@ -2693,5 +3328,118 @@ void Load_YAML_Config( char *yaml_file )
 
         }
 
+    /* Only "enabled" outputs are kept */
+
+    count = 0;
+
+    for ( i = 0; i < MeerOutput->file_count; i++ )
+        {
+
+            if ( MeerOutput->file[i]->enabled == false )
+                {
+                    free(MeerOutput->file[i]);
+                    continue;
+                }
+
+            if ( MeerOutput->file[i]->location[0] == '\0' )
+                {
+                    Meer_Log(ERROR, "Configuration incomplete.  No '%s' -> 'file_location' specified!", MeerOutput->file[i]->name);
+                }
+
+            MeerOutput->file[count++] = MeerOutput->file[i];
+
+        }
+
+    MeerOutput->file_count = count;
+    MeerOutput->file_enabled = ( count != 0 );
+
+    count = 0;
+
+    for ( i = 0; i < MeerOutput->pipe_count; i++ )
+        {
+
+            if ( MeerOutput->pipe[i]->enabled == false )
+                {
+                    free(MeerOutput->pipe[i]);
+                    continue;
+                }
+
+            if ( MeerOutput->pipe[i]->location[0] == '\0' )
+                {
+                    Meer_Log(ERROR, "Configuration incomplete.  No '%s' -> 'pipe_location' specified!", MeerOutput->pipe[i]->name);
+                }
+
+            MeerOutput->pipe[count++] = MeerOutput->pipe[i];
+
+        }
+
+    MeerOutput->pipe_count = count;
+    MeerOutput->pipe_enabled = ( count != 0 );
+
+#ifdef HAVE_LIBHIREDIS
+
+    /* The plain "redis" block's server is also the one fingerprinting and
+       client_stats use */
+
+    count = 0;
+
+    for ( i = 0; i < MeerOutput->redis_count; i++ )
+        {
+
+            redis = MeerOutput->redis[i];
+
+            if ( redis->enabled == false )
+                {
+                    free(redis);
+                    continue;
+                }
+
+            if ( !strcmp(redis->name, "redis") )
+                {
+
+                    MeerOutput->redis_enabled = true;
+                    MeerOutput->redis_debug = redis->debug;
+                    MeerOutput->redis_port = redis->port;
+
+                    strlcpy(MeerOutput->redis_server, redis->server, sizeof(MeerOutput->redis_server));
+                    strlcpy(MeerOutput->redis_password, redis->password, sizeof(MeerOutput->redis_password));
+
+                }
+
+            MeerOutput->redis[count++] = redis;
+
+        }
+
+    MeerOutput->redis_count = count;
+
+#endif
+
+#ifdef WITH_ELASTICSEARCH
+
+    for ( i = 0; i < MeerOutput->elasticsearch_count; i++ )
+        {
+
+            es = MeerOutput->elasticsearch[i];
+
+            if ( es->enabled == false )
+                {
+                    free(es);
+                    continue;
+                }
+
+            if ( es->queue == 0 )
+                {
+                    es->queue = ( es->multi == true ? es->concurrency : es->threads ) * 2;
+                }
+
+            MeerOutput->elasticsearch[es_count++] = es;
+
+        }
+
+    MeerOutput->elasticsearch_count = es_count;
+    MeerOutput->elasticsearch_enabled = ( es_count != 0 );
+
+#endif
+
     Meer_Log(NORMAL, "Configuration '%s' for host '%s' successfully loaded.", yaml_file, MeerConfig->hostname);
 }
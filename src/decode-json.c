@@ -41,18 +41,19 @@ libjson-c is required for Meer to function!
 #include "decode-json.h"
 #include "decode-output-json-client-stats.h"
 
-#include "output-plugins/pipe.h"
-#include "output-plugins/file.h"
-
 #include "meer.h"
 #include "meer-def.h"
 #include "util.h"
 #include "output.h"
+#include "output-queue.h"
+#include "output-plugins/pipe.h"
+#include "output-plugins/file.h"
 #include "get-dns.h"
 #include "get-oui.h"
 #include "counters.h"
 #include "calculate-stats.h"
 #include "ndp-collector.h"
+#include "reload.h"
 
 #ifdef HAVE_LIBMAXMINDDB
 #include "get-geoip.h"
@@ -82,10 +83,18 @@ bool Decode_JSON( char *json_string )
 
     char fixed_ip[64] = { 0 };
 
+    /* Pick up any reloaded (SIGHUP) enrichment data */
+
+    Reload_Check();
+
     /* Remove \n from string */
 
     json_string[ strlen(json_string) - 1 ] = '\0';
 
+    /* The line as read.  "json_string" moves to the enriched copy below */
+
+    const char *raw_string = json_string;
+
     char *new_json_string = malloc( MeerConfig->payload_buffer_size );
 
     if ( new_json_string == NULL )
@@ -308,6 +317,8 @@ bool Decode_JSON( char *json_string )
             if ( Is_Fingerprint( json_obj ) == true )
                 {
 
+                    bool fingerprint_written = false;
+
                     /* If it's a "fingerprint" add it to our database.  First,  is our "fingerprint"
                      * in range? */
 
@@ -335,7 +346,14 @@ bool Decode_JSON( char *json_string )
                             return(false);
                         }
 
-                    if ( Fingerprint_JSON_Event_Redis( json_obj, new_json_string, MeerConfig->payload_buffer_size ) == false )
+                    fingerprint_written = Fingerprint_JSON_Event_Redis( json_obj, new_json_string, MeerConfig->payload_buffer_size );
+
+                    /* The "ip",  "event" and "index" writes were pipelined.  Read
+                       all of the replies back in one go */
+
+                    Redis_Pipeline_Flush( REDIS_WRITER );
+
+                    if ( fingerprint_written == false )
                         {
                             Meer_Log(WARN, "[%s, line %d] Couldn't write Redis 'fingerprint|event' key! Skipping!", __FILE__, __LINE__);
                             json_object_put(json_obj);
@@ -404,57 +422,9 @@ bool Decode_JSON( char *json_string )
 
 #endif
 
-    if ( MeerOutput->pipe_enabled == true )
-        {
-            Output_Pipe( json_string, event_type );
-        }
-
-    if ( MeerOutput->external_enabled == true )
-        {
-            Output_External( json_string, json_obj, event_type );
-        }
-
-
-    if ( MeerOutput->file_enabled == true )
-        {
-            Output_File( json_string, event_type );
-        }
-
-#ifdef WITH_SYSLOG
+    /* Every output is fed by its own worker (see output-queue.c) */
 
-    if ( MeerOutput->syslog_enabled == true )
-        {
-            Output_Syslog( json_string, event_type );
-        }
-
-#endif
-
-#ifdef HAVE_LIBHIREDIS
-
-    if ( MeerOutput->redis_enabled == true )
-        {
-            Output_Redis( json_string, event_type );
-        }
-
-#endif
-
-#ifdef WITH_ELASTICSEARCH
-
-    if ( MeerOutput->elasticsearch_enabled == true )
-        {
-            Output_Elasticsearch( json_string, event_type, NULL );
-        }
-
-#endif
-
-#ifdef WITH_BLUEDOT
-
-    if ( ( MeerOutput->bluedot_flag = true && !strcmp( event_type, "alert" ) ) )
-        {
-            Output_Bluedot( json_obj );
-        }
-
-#endif
+    Output_Queue_Event( json_string, event_type, flow_id, raw_string );
 
 #ifdef HAVE_LIBHIREDIS
 
@@ -25,10 +25,13 @@
 #ifdef HAVE_LIBMAXMINDDB
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <maxminddb.h>
 #include <errno.h>
+#include <arpa/inet.h>
+#include <json-c/json.h>
 
 #include "meer.h"
 #include "meer-def.h"
@@ -36,136 +39,692 @@
 #include "geoip.h"
 
 extern struct _MeerConfig *MeerConfig;
+extern struct _MeerCounters *MeerCounters;
 
-MMDB_s 	geoip;
+/* The open databases.  Replaced as a whole by GeoIP_Swap_Databases() on
+   a reload (SIGHUP). */
 
-void Open_GeoIP_Database( void )
+struct _GeoIP_Databases
+{
+    uint8_t count;
+    MMDB_s mmdb[GEOIP_MAX_DATABASES];
+};
+
+struct _GeoIP_Databases *GeoIP_Databases = NULL;
+
+struct _GeoIP_Cache *GeoIP_Cache = NULL;
+struct _GeoIP_Cache **GeoIP_Cache_Hash = NULL;
+struct _GeoIP_Cache *GeoIP_Cache_Head = NULL;
+struct _GeoIP_Cache *GeoIP_Cache_Tail = NULL;
+
+uint32_t GeoIP_Cache_Used = 0;
+uint32_t GeoIP_Cache_Buckets = 0;
+
+/* Fields we pull out of a Maxmind "City" record.  Records are decoded
+   once with MMDB_get_entry_data_list() and each leaf is matched against
+   the path table (these,  followed by any "geoip_fields"),  rather than
+   walking the record once per field. */
+
+static const struct
+{
+    const char *path[GEOIP_MAX_DEPTH];
+    size_t offset;
+    size_t size;
+} GeoIP_Fields[] =
+{
+    { { "country", "iso_code" }, offsetof(struct _GeoIP, country), 3 },
+    { { "city", "names", "en" }, offsetof(struct _GeoIP, city), sizeof(((struct _GeoIP *)0)->city) },
+    { { "subdivisions", "0", "iso_code" }, offsetof(struct _GeoIP, subdivision), sizeof(((struct _GeoIP *)0)->subdivision) },
+    { { "postal", "code" }, offsetof(struct _GeoIP, postal), sizeof(((struct _GeoIP *)0)->postal) },
+    { { "location", "time_zone" }, offsetof(struct _GeoIP, timezone), sizeof(((struct _GeoIP *)0)->timezone) },
+    { { "location", "latitude" }, offsetof(struct _GeoIP, latitude), sizeof(((struct _GeoIP *)0)->latitude) },
+    { { "location", "longitude" }, offsetof(struct _GeoIP, longitude), sizeof(((struct _GeoIP *)0)->longitude) },
+};
+
+#define GEOIP_MAX_PATHS		( sizeof(GeoIP_Fields) / sizeof(GeoIP_Fields[0]) + GEOIP_MAX_FIELDS )
+
+struct _GeoIP_Path
+{
+    char path[GEOIP_MAX_DEPTH][GEOIP_MAX_KEY];
+    uint8_t depth;
+    size_t offset;
+    size_t size;
+};
+
+struct _GeoIP_Path GeoIP_Paths[GEOIP_MAX_PATHS];
+uint8_t GeoIP_Path_Count = 0;
+
+/****************************************************************************
+ * GeoIP_Load_Databases - Open every "geoip_database".  Returns NULL (after
+ * logging why) if any of them can't be loaded.  This is used at startup
+ * and by the reload thread,  so it never exits.
+ ****************************************************************************/
+
+struct _GeoIP_Databases *GeoIP_Load_Databases( void )
 {
 
     int status;
+    uint8_t i = 0;
 
-    /*
-     * The GeoIP library gives a really vague error when it cannot load
-     * the GeoIP database.  We give the user more information here so
-     * that they might fix the issue.
-     */
+    struct _GeoIP_Databases *Databases = NULL;
 
-    status = access(MeerConfig->geoip_database, R_OK);
+    Databases = calloc( 1, sizeof(struct _GeoIP_Databases) );
 
-    if ( status != 0 )
+    if ( Databases == NULL )
         {
-            Meer_Log(WARN, "Cannot open '%s' [%s]!",  MeerConfig->geoip_database, strerror(errno));
-            Meer_Log(ERROR, "Make sure the GeoIP database '%s' is readable by '%s'.", MeerConfig->geoip_database, MeerConfig->runas);
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for _GeoIP_Databases. Abort!", __FILE__, __LINE__);
         }
 
-    status = MMDB_open(MeerConfig->geoip_database, MMDB_MODE_MMAP, &geoip);
+    for ( i = 0; i < MeerConfig->geoip_database_count; i++ )
+        {
+
+            /*
+             * The GeoIP library gives a really vague error when it cannot load
+             * the GeoIP database.  We give the user more information here so
+             * that they might fix the issue.
+             */
+
+            status = access(MeerConfig->geoip_database[i], R_OK);
+
+            if ( status != 0 )
+                {
+                    Meer_Log(WARN, "Cannot open '%s' [%s]!",  MeerConfig->geoip_database[i], strerror(errno));
+                    Meer_Log(WARN, "Make sure the GeoIP database '%s' is readable by '%s'.", MeerConfig->geoip_database[i], MeerConfig->runas);
+                    GeoIP_Free_Databases( Databases );
+                    return(NULL);
+                }
+
+            status = MMDB_open(MeerConfig->geoip_database[i], MMDB_MODE_MMAP, &Databases->mmdb[i]);
+
+            if ( status != 0 )
+                {
+                    Meer_Log(WARN, "Error loading Maxmind GeoIP data (%s).  Are you trying to load an older, non-GeoIP database?", MeerConfig->geoip_database[i]);
+                    GeoIP_Free_Databases( Databases );
+                    return(NULL);
+                }
+
+            Databases->count++;
+
+        }
+
+    return(Databases);
+
+}
+
+void GeoIP_Free_Databases( struct _GeoIP_Databases *Databases )
+{
+
+    uint8_t i = 0;
+
+    if ( Databases == NULL )
+        {
+            return;
+        }
 
-    if ( status != 0 )
+    for ( i = 0; i < Databases->count; i++ )
         {
-            Meer_Log(ERROR, "Error loading Maxmind GeoIP data (%s).  Are you trying to load an older, non-GeoIP database?", MeerConfig->geoip_database);
+            MMDB_close(&Databases->mmdb[i]);
         }
 
+    free(Databases);
 
 }
 
-void GeoIP_Lookup( const char *ip_address, struct _GeoIP *GeoIP )
+/****************************************************************************
+ * GeoIP_Swap_Databases - Put a freshly loaded set of databases into service
+ * and release the old set.  This must be called from the decoding thread
+ * between events (see reload.c),  which is the only user of the handles.
+ * The cache is flushed so stale results aren't served.
+ ****************************************************************************/
+
+void GeoIP_Swap_Databases( struct _GeoIP_Databases *Databases )
 {
 
-    int gai_error;
-    int mmdb_error;
-    int res;
+    struct _GeoIP_Databases *old = GeoIP_Databases;
+    uint32_t i = 0;
+
+    GeoIP_Databases = Databases;
+    GeoIP_Free_Databases( old );
+
+    if ( GeoIP_Cache == NULL )
+        {
+            return;
+        }
+
+    for ( i = 0; i < GeoIP_Cache_Used; i++ )
+        {
+
+            if ( GeoIP_Cache[i].json != NULL )
+                {
+                    json_object_put(GeoIP_Cache[i].json);
+                }
+        }
+
+    memset(GeoIP_Cache, 0, GeoIP_Cache_Used * sizeof(_GeoIP_Cache));
+    memset(GeoIP_Cache_Hash, 0, GeoIP_Cache_Buckets * sizeof(struct _GeoIP_Cache *));
+
+    GeoIP_Cache_Used = 0;
+    GeoIP_Cache_Head = NULL;
+    GeoIP_Cache_Tail = NULL;
+
+}
+
+void Open_GeoIP_Database( void )
+{
+
+    uint8_t i = 0;
+    uint8_t depth = 0;
+
+    char tmp[128] = { 0 };
+    char *ptr = NULL;
+    char *tok = NULL;
+
+    GeoIP_Databases = GeoIP_Load_Databases();
+
+    if ( GeoIP_Databases == NULL )
+        {
+            Meer_Log(ERROR, "Unable to load GeoIP database(s).  Abort!");
+        }
+
+    /* Build the path table.  Built in "City" fields first,  then the
+       user's "geoip_fields" ("traits.isp" becomes "traits" -> "isp"). */
+
+    for ( i = 0; i < sizeof(GeoIP_Fields) / sizeof(GeoIP_Fields[0]); i++ )
+        {
 
-    bool failure = false;
+            for ( depth = 0; depth < GEOIP_MAX_DEPTH && GeoIP_Fields[i].path[depth] != NULL; depth++ )
+                {
+                    strlcpy(GeoIP_Paths[GeoIP_Path_Count].path[depth], GeoIP_Fields[i].path[depth], GEOIP_MAX_KEY);
+                }
 
-    unsigned char ip_convert[MAXIPBIT] = { 0 };
+            GeoIP_Paths[GeoIP_Path_Count].depth = depth;
+            GeoIP_Paths[GeoIP_Path_Count].offset = GeoIP_Fields[i].offset;
+            GeoIP_Paths[GeoIP_Path_Count].size = GeoIP_Fields[i].size;
+            GeoIP_Path_Count++;
 
-    IP2Bit( (char*)ip_address, ip_convert);
+        }
 
-    if ( Is_Notroutable(ip_convert) )
+    for ( i = 0; i < MeerConfig->geoip_field_count; i++ )
+        {
+
+            strlcpy(tmp, MeerConfig->geoip_field_path[i], sizeof(tmp));
+
+            depth = 0;
+            ptr = strtok_r(tmp, ".", &tok);
+
+            while ( ptr != NULL )
+                {
+
+                    if ( depth >= GEOIP_MAX_DEPTH )
+                        {
+                            Meer_Log(ERROR, "'geoip_fields' path '%s' is too deep.  The max depth is %d.  Abort!", MeerConfig->geoip_field_path[i], GEOIP_MAX_DEPTH);
+                        }
+
+                    strlcpy(GeoIP_Paths[GeoIP_Path_Count].path[depth], ptr, GEOIP_MAX_KEY);
+                    depth++;
+
+                    ptr = strtok_r(NULL, ".", &tok);
+                }
+
+            GeoIP_Paths[GeoIP_Path_Count].depth = depth;
+            GeoIP_Paths[GeoIP_Path_Count].offset = offsetof(struct _GeoIP, field) + ( i * GEOIP_FIELD_SIZE );
+            GeoIP_Paths[GeoIP_Path_Count].size = GEOIP_FIELD_SIZE;
+            GeoIP_Path_Count++;
+
+        }
+
+    /* Set up the lookup cache.  All entries are allocated up front so
+       nothing is malloc()'ed per lookup. */
+
+    if ( MeerConfig->geoip_cache == 0 )
         {
             return;
         }
 
-    MMDB_lookup_result_s result = MMDB_lookup_string(&geoip, ip_address, &gai_error, &mmdb_error);
-    MMDB_entry_data_s entry_data;
+    GeoIP_Cache_Buckets = 1;
 
-    /* Country code */
+    while ( GeoIP_Cache_Buckets < MeerConfig->geoip_cache )
+        {
+            GeoIP_Cache_Buckets <<= 1;
+        }
 
-    res = MMDB_get_value(&result.entry, &entry_data, "country", "iso_code", NULL);
+    GeoIP_Cache = calloc( MeerConfig->geoip_cache, sizeof(_GeoIP_Cache) );
 
-    if (res != MMDB_SUCCESS)
+    if ( GeoIP_Cache == NULL )
         {
-            strlcpy(GeoIP->country, "LOOKUP_FAILURE", sizeof(GeoIP->country));
-            failure = true;
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for _GeoIP_Cache. Abort!", __FILE__, __LINE__);
         }
 
-    if ( !entry_data.has_data || entry_data.type != MMDB_DATA_TYPE_UTF8_STRING )
+    GeoIP_Cache_Hash = calloc( GeoIP_Cache_Buckets, sizeof(struct _GeoIP_Cache *) );
+
+    if ( GeoIP_Cache_Hash == NULL )
         {
-            strlcpy( GeoIP->country, "NOT_FOUND", sizeof( GeoIP->country ) );
-            failure = true;
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for GeoIP_Cache_Hash. Abort!", __FILE__, __LINE__);
         }
 
-    if ( failure == false )
+}
+
+/****************************************************************************
+ * GeoIP_Store - Copy a single decoded leaf into the _GeoIP destination.
+ ****************************************************************************/
+
+static void GeoIP_Store( MMDB_entry_data_s *entry_data, char *dest, size_t size )
+{
+
+    size_t len = 0;
+
+    switch ( entry_data->type )
         {
-            strlcpy(GeoIP->country, entry_data.utf8_string, 3);
+
+        case MMDB_DATA_TYPE_UTF8_STRING:
+
+            len = entry_data->data_size < size - 1 ? entry_data->data_size : size - 1;
+            memcpy(dest, entry_data->utf8_string, len);
+            dest[len] = '\0';
+            break;
+
+        case MMDB_DATA_TYPE_DOUBLE:
+
+            snprintf(dest, size, "%f", entry_data->double_value);
+            dest[ size - 1 ] = '\0';
+            break;
+
+        case MMDB_DATA_TYPE_FLOAT:
+
+            snprintf(dest, size, "%f", entry_data->float_value);
+            dest[ size - 1 ] = '\0';
+            break;
+
+        case MMDB_DATA_TYPE_UINT16:
+
+            snprintf(dest, size, "%u", entry_data->uint16);
+            dest[ size - 1 ] = '\0';
+            break;
+
+        case MMDB_DATA_TYPE_UINT32:
+
+            snprintf(dest, size, "%u", entry_data->uint32);
+            dest[ size - 1 ] = '\0';
+            break;
+
+        case MMDB_DATA_TYPE_INT32:
+
+            snprintf(dest, size, "%d", entry_data->int32);
+            dest[ size - 1 ] = '\0';
+            break;
+
+        case MMDB_DATA_TYPE_UINT64:
+
+            snprintf(dest, size, "%" PRIu64 "", entry_data->uint64);
+            dest[ size - 1 ] = '\0';
+            break;
+
+        case MMDB_DATA_TYPE_BOOLEAN:
+
+            strlcpy(dest, entry_data->boolean ? "true" : "false", size);
+            break;
+
         }
 
-    /* City */
+}
+
+/****************************************************************************
+ * GeoIP_Walk - Walk one value of a decoded MMDB entry list,  recursing into
+ * maps and arrays.  "path" holds the keys leading to the current value.
+ * Returns the list element following the value (and its children).
+ ****************************************************************************/
+
+static MMDB_entry_data_list_s *GeoIP_Walk( MMDB_entry_data_list_s *list, char path[GEOIP_MAX_DEPTH][GEOIP_MAX_KEY], uint8_t depth, struct _GeoIP *GeoIP )
+{
 
-    MMDB_get_value(&result.entry, &entry_data, "city", "names", "en", NULL);
+    uint32_t size = 0;
+    uint32_t i = 0;
+    uint8_t  a = 0;
+    uint8_t  f = 0;
+    size_t   len = 0;
 
-    if ( entry_data.has_data )
+    if ( list == NULL )
         {
-            strlcpy(GeoIP->city, entry_data.utf8_string, entry_data.data_size+1);
+            return(NULL);
         }
 
-    /* Subdivision */
+    switch ( list->entry_data.type )
+        {
+
+        case MMDB_DATA_TYPE_MAP:
+
+            size = list->entry_data.data_size;
+            list = list->next;
+
+            for ( i = 0; i < size && list != NULL; i++ )
+                {
+
+                    /* Key,  followed by its value */
+
+                    if ( depth < GEOIP_MAX_DEPTH )
+                        {
+                            len = list->entry_data.data_size < GEOIP_MAX_KEY - 1 ? list->entry_data.data_size : GEOIP_MAX_KEY - 1;
+                            memcpy(path[depth], list->entry_data.utf8_string, len);
+                            path[depth][len] = '\0';
+                        }
+
+                    list = GeoIP_Walk( list->next, path, depth + 1, GeoIP );
+                }
+
+            return(list);
+
+        case MMDB_DATA_TYPE_ARRAY:
+
+            size = list->entry_data.data_size;
+            list = list->next;
+
+            for ( i = 0; i < size && list != NULL; i++ )
+                {
 
-    MMDB_get_value(&result.entry, &entry_data, "subdivisions", "0", "iso_code", NULL);
+                    if ( depth < GEOIP_MAX_DEPTH )
+                        {
+                            snprintf(path[depth], GEOIP_MAX_KEY, "%u", i);
+                        }
 
-    if ( entry_data.has_data )
+                    list = GeoIP_Walk( list, path, depth + 1, GeoIP );
+                }
+
+            return(list);
+
+        }
+
+    /* Leaf value - see if it's one we want.  Earlier databases win,  so
+       a value that is already set is left alone. */
+
+    for ( f = 0; f < GeoIP_Path_Count; f++ )
         {
-            strlcpy(GeoIP->subdivision, entry_data.utf8_string, entry_data.data_size+1);
+
+            if ( GeoIP_Paths[f].depth != depth )
+                {
+                    continue;
+                }
+
+            for ( a = 0; a < depth; a++ )
+                {
+
+                    if ( strcmp(GeoIP_Paths[f].path[a], path[a]) )
+                        {
+                            break;
+                        }
+                }
+
+            if ( a == depth )
+                {
+
+                    if ( *( (char *)GeoIP + GeoIP_Paths[f].offset ) == '\0' )
+                        {
+                            GeoIP_Store( &list->entry_data, (char *)GeoIP + GeoIP_Paths[f].offset, GeoIP_Paths[f].size );
+                        }
+
+                    break;
+                }
         }
 
-    /* Postal */
+    return(list->next);
 
-    MMDB_get_value(&result.entry, &entry_data, "postal", "code", NULL);
+}
+
+/****************************************************************************
+ * GeoIP_Parse - Convert an address once into a sockaddr (for Maxmind) and
+ * the binary form used by Is_Notroutable() and the cache.  The last byte of
+ * "key" tags the family,  as IPv4 and IPv6 share the same 16 byte space.
+ ****************************************************************************/
+
+static bool GeoIP_Parse( const char *ip_address, struct sockaddr_storage *sa, unsigned char *key )
+{
 
-    if ( entry_data.has_data )
+    struct sockaddr_in *sa4 = (struct sockaddr_in *)sa;
+    struct sockaddr_in6 *sa6 = (struct sockaddr_in6 *)sa;
+
+    memset(sa, 0, sizeof(struct sockaddr_storage));
+    memset(key, 0, MAXIPBIT+1);
+
+    if ( strchr(ip_address, ':') != NULL )
+        {
+
+            if ( inet_pton(AF_INET6, ip_address, &sa6->sin6_addr) != 1 )
+                {
+                    return(false);
+                }
+
+            sa6->sin6_family = AF_INET6;
+            memcpy(key, &sa6->sin6_addr, sizeof(sa6->sin6_addr));
+            key[MAXIPBIT] = IPv6;
+
+            return(true);
+        }
+
+    if ( inet_pton(AF_INET, ip_address, &sa4->sin_addr) != 1 )
         {
-            strlcpy(GeoIP->postal, entry_data.utf8_string, entry_data.data_size+1);
+            return(false);
         }
 
-    /* Timezone */
+    sa4->sin_family = AF_INET;
+    memcpy(key, &sa4->sin_addr, sizeof(sa4->sin_addr));
+    key[MAXIPBIT] = IPv4;
+
+    return(true);
+
+}
 
-    MMDB_get_value(&result.entry, &entry_data, "location", "time_zone", NULL);
+/****************************************************************************
+ * GeoIP_Resolve - Look an already parsed address up in every database and
+ * merge the results into one _GeoIP record.
+ ****************************************************************************/
 
-    if ( entry_data.has_data )
+static void GeoIP_Resolve( struct sockaddr_storage *sa, unsigned char *key, struct _GeoIP *GeoIP )
+{
+
+    int mmdb_error;
+    int res;
+
+    uint8_t i = 0;
+
+    char path[GEOIP_MAX_DEPTH][GEOIP_MAX_KEY];
+
+    MMDB_entry_data_list_s *entry_data_list = NULL;
+    MMDB_lookup_result_s result;
+
+    if ( Is_Notroutable(key) )
         {
-            strlcpy(GeoIP->timezone, entry_data.utf8_string, entry_data.data_size+1);
+            return;
         }
 
-    /* Latitude */
+    MeerCounters->GeoIPLookupCount++;
+
+    for ( i = 0; i < GeoIP_Databases->count; i++ )
+        {
+
+            result = MMDB_lookup_sockaddr(&GeoIP_Databases->mmdb[i], (struct sockaddr *)sa, &mmdb_error);
+
+            if ( mmdb_error != MMDB_SUCCESS || result.found_entry == false )
+                {
+                    continue;
+                }
+
+            /* Decode the whole record in one pass */
+
+            entry_data_list = NULL;
+
+            res = MMDB_get_entry_data_list(&result.entry, &entry_data_list);
+
+            if ( res == MMDB_SUCCESS )
+                {
+                    GeoIP_Walk( entry_data_list, path, 0, GeoIP );
+                }
 
-    MMDB_get_value(&result.entry, &entry_data, "location", "latitude", NULL);
+            MMDB_free_entry_data_list(entry_data_list);
 
-    if ( entry_data.has_data )
+        }
+
+    if ( GeoIP->country[0] == '\0' )
         {
-            snprintf(GeoIP->latitude, sizeof(GeoIP->latitude), "%f", entry_data.double_value);
-            GeoIP->latitude[ sizeof(GeoIP->latitude) - 1 ] = '\0';
+            strlcpy( GeoIP->country, "NOT_FOUND", sizeof( GeoIP->country ) );
         }
 
-    /* Longitude */
+}
+
+void GeoIP_Lookup( const char *ip_address, struct _GeoIP *GeoIP )
+{
 
-    MMDB_get_value(&result.entry, &entry_data, "location", "longitude", NULL);
+    struct sockaddr_storage sa;
+    unsigned char key[MAXIPBIT+1];
 
-    if ( entry_data.has_data )
+    if ( GeoIP_Parse( ip_address, &sa, key ) == false )
         {
-            snprintf(GeoIP->longitude, sizeof(GeoIP->longitude), "%f", entry_data.double_value);
-            GeoIP->longitude[ sizeof(GeoIP->longitude) - 1 ] = '\0';
+            strlcpy(GeoIP->country, "LOOKUP_FAILURE", sizeof(GeoIP->country));
+            return;
         }
 
+    GeoIP_Resolve( &sa, key, GeoIP );
+
+}
+
+/****************************************************************************
+ * GeoIP_Cache_Key_Hash - FNV-1a of the binary address,  masked to the
+ * bucket count.
+ ****************************************************************************/
+
+static uint32_t GeoIP_Cache_Key_Hash( const unsigned char *key )
+{
+
+    uint32_t hash = 2166136261U;
+    uint8_t i = 0;
+
+    for ( i = 0; i < MAXIPBIT+1; i++ )
+        {
+            hash = ( hash ^ key[i] ) * 16777619U;
+        }
+
+    return( hash & ( GeoIP_Cache_Buckets - 1 ) );
+
+}
+
+/****************************************************************************
+ * GeoIP_Cache_Lookup - Return the cached GeoIP record for an address,
+ * resolving and inserting it on a miss (evicting the least recently used
+ * entry when full).  Returns NULL if the cache is disabled or the address
+ * can't be parsed.
+ ****************************************************************************/
+
+struct _GeoIP_Cache *GeoIP_Cache_Lookup( const char *ip_address )
+{
+
+    struct sockaddr_storage sa;
+    unsigned char key[MAXIPBIT+1] = { 0 };
+    uint32_t hash = 0;
+
+    struct _GeoIP_Cache *entry = NULL;
+    struct _GeoIP_Cache **prev = NULL;
+
+    if ( GeoIP_Cache == NULL || GeoIP_Parse( ip_address, &sa, key ) == false )
+        {
+            return(NULL);
+        }
+
+    hash = GeoIP_Cache_Key_Hash( key );
+
+    for ( entry = GeoIP_Cache_Hash[hash]; entry != NULL; entry = entry->hash_next )
+        {
+
+            if ( !memcmp(entry->ip, key, sizeof(key)) )
+                {
+
+                    MeerCounters->GeoIPCacheHitCount++;
+
+                    /* Move to the front of the LRU list */
+
+                    if ( entry != GeoIP_Cache_Head )
+                        {
+
+                            entry->lru_prev->lru_next = entry->lru_next;
+
+                            if ( entry->lru_next != NULL )
+                                {
+                                    entry->lru_next->lru_prev = entry->lru_prev;
+                                }
+                            else
+                                {
+                                    GeoIP_Cache_Tail = entry->lru_prev;
+                                }
+
+                            entry->lru_prev = NULL;
+                            entry->lru_next = GeoIP_Cache_Head;
+                            GeoIP_Cache_Head->lru_prev = entry;
+                            GeoIP_Cache_Head = entry;
+
+                        }
+
+                    return(entry);
+                }
+        }
+
+    /* Miss.  Grab an unused entry or recycle the oldest one */
+
+    if ( GeoIP_Cache_Used < MeerConfig->geoip_cache )
+        {
+            entry = &GeoIP_Cache[GeoIP_Cache_Used++];
+        }
+    else
+        {
+
+            entry = GeoIP_Cache_Tail;
+
+            GeoIP_Cache_Tail = entry->lru_prev;
+
+            if ( GeoIP_Cache_Tail != NULL )
+                {
+                    GeoIP_Cache_Tail->lru_next = NULL;
+                }
+            else
+                {
+                    GeoIP_Cache_Head = NULL;
+                }
+
+            /* Unlink from its hash chain */
+
+            for ( prev = &GeoIP_Cache_Hash[ GeoIP_Cache_Key_Hash(entry->ip) ]; *prev != entry; prev = &(*prev)->hash_next );
+
+            *prev = entry->hash_next;
+
+            if ( entry->json != NULL )
+                {
+                    json_object_put(entry->json);
+                }
+
+            memset(entry, 0, sizeof(_GeoIP_Cache));
+
+        }
+
+    memcpy(entry->ip, key, sizeof(key));
+
+    GeoIP_Resolve( &sa, key, &entry->GeoIP );
+
+    entry->hash_next = GeoIP_Cache_Hash[hash];
+    GeoIP_Cache_Hash[hash] = entry;
+
+    entry->lru_prev = NULL;
+    entry->lru_next = GeoIP_Cache_Head;
+
+    if ( GeoIP_Cache_Head != NULL )
+        {
+            GeoIP_Cache_Head->lru_prev = entry;
+        }
+
+    GeoIP_Cache_Head = entry;
+
+    if ( GeoIP_Cache_Tail == NULL )
+        {
+            GeoIP_Cache_Tail = entry;
+        }
+
+    return(entry);
+
 }
 
 #endif
@@ -31,9 +31,39 @@ struct _GeoIP
     char latitude[16];
     char longitude[16];
 
+    char field[GEOIP_MAX_FIELDS][GEOIP_FIELD_SIZE];	/* "geoip_fields" */
+
 };
 
+/* LRU cache of resolved GeoIP records.  Entries are keyed by the binary
+   IP address (plus family) and carry the JSON nest that gets attached to
+   "geoip_src" / "geoip_dest" so repeat addresses don't rebuild it. */
+
+struct json_object;
+
+typedef struct _GeoIP_Cache _GeoIP_Cache;
+struct _GeoIP_Cache
+{
+
+    unsigned char ip[MAXIPBIT+1];
+    struct _GeoIP GeoIP;
+
+    bool json_built;
+    struct json_object *json;
+
+    struct _GeoIP_Cache *hash_next;
+    struct _GeoIP_Cache *lru_prev;
+    struct _GeoIP_Cache *lru_next;
+
+};
+
+
+struct _GeoIP_Databases;
 
 void Open_GeoIP_Database( void );
+struct _GeoIP_Databases *GeoIP_Load_Databases( void );
+void GeoIP_Free_Databases( struct _GeoIP_Databases *Databases );
+void GeoIP_Swap_Databases( struct _GeoIP_Databases *Databases );
 void GeoIP_Lookup( const char *ip_address, struct _GeoIP *GeoIP );
+struct _GeoIP_Cache *GeoIP_Cache_Lookup( const char *ip_address );
 
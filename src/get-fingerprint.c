@@ -25,6 +25,7 @@
 #ifdef HAVE_LIBHIREDIS
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <json-c/json.h>
 #include <hiredis/hiredis.h>
@@ -87,7 +88,10 @@ void Fingerprint_DHCP ( struct json_object *json_obj, const char *json_string )
     snprintf(key, sizeof(key), "%s|dhcp|%s", FINGERPRINT_REDIS_KEY, assigned_ip);
     key[ sizeof( key ) - 1 ] = '\0';
 
-    Redis_Writer( "SET", key, json_string, FINGERPRINT_DHCP_REDIS_EXPIRE );
+    Redis_Pipeline_Append( REDIS_WRITER, "SET %s %s EX %d", key, json_string, FINGERPRINT_DHCP_REDIS_EXPIRE );
+    Redis_Pipeline_Flush( REDIS_WRITER );
+
+    Fingerprint_Cache_Invalidate( assigned_ip );
 
 
     free(json_obj_dhcp );
@@ -159,13 +163,30 @@ bool Fingerprint_JSON_IP_Redis( struct json_object *json_obj )
     snprintf(key, sizeof(key), "%s|ip|%s", FINGERPRINT_REDIS_KEY, src_ip);  // DEBUG: what exactly is this used for?!
     key[ sizeof(key) - 1] = '\0';
 
-    Redis_Writer( "SET", key, json_object_to_json_string(encode_json), FINGERPRINT_IP_REDIS_EXPIRE);
+    /* Queued only.  The caller flushes once the "event" and "index" writes
+       are queued behind it. */
+
+    Redis_Pipeline_Append( REDIS_WRITER, "SET %s %s EX %d", key, json_object_to_json_string(encode_json), FINGERPRINT_IP_REDIS_EXPIRE );
 
     json_object_put(encode_json);
 
     return(true);
 }
 
+/****************************************************************************
+ * Fingerprint_Index_Writer - Add a fingerprint to the "fingerprint|index|IP"
+ * hash.  The field is the signature_id,  with a "signature_id|expire" field
+ * holding the epoch the entry stops being valid.
+ ****************************************************************************/
+
+static void Fingerprint_Index_Writer( const char *key, uint64_t signature_id, const char *value, int expire )
+{
+
+    Redis_Pipeline_Append( REDIS_WRITER, "HSET %s %" PRIu64 " %s %" PRIu64 "|expire %" PRIu64 "", key, signature_id, value, signature_id, Current_Epoch() + expire );
+    Redis_Pipeline_Append( REDIS_WRITER, "EXPIRE %s %d", key, expire > FINGERPRINT_EVENT_REDIS_EXPIRE ? expire : FINGERPRINT_EVENT_REDIS_EXPIRE );
+
+}
+
 bool Fingerprint_JSON_Event_Redis( struct json_object *json_obj, char *str, size_t size )
 {
 
@@ -395,7 +416,19 @@ bool Fingerprint_JSON_Event_Redis( struct json_object *json_obj, char *str, size
 
     snprintf(new_string, MeerConfig->payload_buffer_size, "%s, \"fingerprint\": %s}", string_f, json_object_to_json_string_ext(encode_json, JSON_C_TO_STRING_PLAIN) );
 
-    Redis_Writer( "SET", key, new_string, fingerprint_expire_int);
+    Redis_Pipeline_Append( REDIS_WRITER, "SET %s %s EX %d", key, new_string, fingerprint_expire_int );
+
+    /* Per-IP index so readers can pull every fingerprint for a host with
+       one HGETALL rather than a SCAN of the whole keyspace.  Each entry
+       carries its own expire time,  and the index lives as long as the
+       most recent fingerprint for the host needs it to. */
+
+    snprintf(key, sizeof(key), "%s|index|%s", FINGERPRINT_REDIS_KEY, src_ip);
+    key[ sizeof(key) -1 ] = '\0';
+
+    Fingerprint_Index_Writer( key, signature_id, new_string, fingerprint_expire_int );
+
+    Fingerprint_Cache_Invalidate( src_ip );
 
     snprintf(str, size, "%s", new_string);		/* String to return back */
 
@@ -480,199 +513,463 @@ bool Is_Fingerprint( struct json_object *json_obj )
 
 }
 
-void Get_Fingerprint( struct json_object *json_obj, char *str, size_t size, const char *json_string )
+/****************************************************************************
+ * Local read-through cache of what Redis holds for an IP (DHCP data and the
+ * "fingerprint" nests).  It is direct mapped on the binary IP,  so a busy
+ * slot simply replaces what was there.  Entries are refetched after
+ * "fingerprint_cache" seconds,  or right away if this instance writes new
+ * fingerprint data for the IP.
+ ****************************************************************************/
+
+struct _Fingerprint_Cache
 {
+    unsigned char ip[MAXIPBIT];
+    uint64_t expire;
 
-#define SRC_IP  0
-#define DEST_IP  1
+    char *dhcp;
+    char **fingerprint;
+    uint16_t fingerprint_count;
+};
 
-    redisReply *reply_r;
-    redisReply *kr;
+static struct _Fingerprint_Cache *Fingerprint_Cache = NULL;
 
-    struct json_object *tmp = NULL;
-    struct json_object *json_obj_fingerprint = NULL;
+static void Fingerprint_Cache_Clear( struct _Fingerprint_Cache *entry )
+{
 
-    char src_ip[64] = { 0 };
-    char dest_ip[64] = { 0 };
+    uint16_t i = 0;
 
-    char tmp_command[256] = { 0 };
+    for ( i = 0; i < entry->fingerprint_count; i++ )
+        {
+            free(entry->fingerprint[i]);
+        }
 
-    unsigned char ip[MAXIPBIT] = { 0 };
+    free(entry->fingerprint);
+    free(entry->dhcp);
 
-    char *tmp_ip = NULL;
-    char *tmp_type = NULL;
+    memset(entry, 0, sizeof(struct _Fingerprint_Cache));
 
-    uint8_t a = 0;
-    uint16_t z = 0;
-    uint16_t i = 0;
+}
 
-    bool valid_fingerprint_net = false;
+static struct _Fingerprint_Cache *Fingerprint_Cache_Slot( const unsigned char *ip )
+{
 
-    char *tmp_redis = malloc(MeerConfig->payload_buffer_size);
+    uint32_t hash = 2166136261U;
+    uint8_t i = 0;
 
-    if ( tmp_redis == NULL )
+    if ( Fingerprint_Cache == NULL )
         {
-            fprintf(stderr, "[%s, line %d] Fatal Error: Can't allocate memory! Abort!\n", __FILE__, __LINE__);
-            exit(-1);
+
+            Fingerprint_Cache = calloc( FINGERPRINT_CACHE_SIZE, sizeof(struct _Fingerprint_Cache) );
+
+            if ( Fingerprint_Cache == NULL )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Fingerprint_Cache. Abort!", __FILE__, __LINE__);
+                }
         }
 
-    memset(tmp_redis, 0, MeerConfig->payload_buffer_size );
+    for ( i = 0; i < MAXIPBIT; i++ )
+        {
+            hash = ( hash ^ ip[i] ) * 16777619U;
+        }
 
-    char *new_json_string = malloc(MeerConfig->payload_buffer_size);
+    return( &Fingerprint_Cache[ hash & ( FINGERPRINT_CACHE_SIZE - 1 ) ] );
 
-    if ( new_json_string == NULL )
+}
+
+/****************************************************************************
+ * Fingerprint_Cache_Invalidate - Called when we write fingerprint data for
+ * an IP so the next alert for it goes back to Redis.
+ ****************************************************************************/
+
+void Fingerprint_Cache_Invalidate( const char *ip_address )
+{
+
+    unsigned char ip[MAXIPBIT] = { 0 };
+    struct _Fingerprint_Cache *entry = NULL;
+
+    if ( MeerConfig->fingerprint_cache == 0 || Fingerprint_Cache == NULL )
         {
-            fprintf(stderr, "[%s, line %d] Fatal Error: Can't allocate memory! Abort!\n", __FILE__, __LINE__);
-            exit(-1);
+            return;
         }
 
-    memset(new_json_string, 0, MeerConfig->payload_buffer_size );
+    IP2Bit( (char *)ip_address, ip );
 
-    char *tmp_json_string = malloc(MeerConfig->payload_buffer_size);
+    entry = Fingerprint_Cache_Slot( ip );
 
-    if ( tmp_json_string == NULL )
+    if ( !memcmp(entry->ip, ip, MAXIPBIT) )
         {
-            fprintf(stderr, "[%s, line %d] Fatal Error: Can't allocate memory! Abort!\n", __FILE__, __LINE__);
-            exit(-1);
+            entry->expire = 0;
         }
 
-    memset(tmp_json_string, 0, MeerConfig->payload_buffer_size );
+}
 
-    strlcpy(new_json_string, json_string, MeerConfig->payload_buffer_size );
+/****************************************************************************
+ * Fingerprint_Index_Load - Walk a "fingerprint|index|IP" HGETALL reply and
+ * keep each still valid "fingerprint" nest.  Expired entries are removed.
+ ****************************************************************************/
 
-    json_object_object_get_ex(json_obj, "src_ip", &tmp);
-    strlcpy( src_ip, json_object_get_string(tmp), sizeof(src_ip) );
+static void Fingerprint_Index_Load( redisReply *reply, const char *ip, struct _Fingerprint_Cache *entry )
+{
 
-    json_object_object_get_ex(json_obj, "dest_ip", &tmp);
-    strlcpy( dest_ip, json_object_get_string(tmp), sizeof(dest_ip) );
+    struct json_object *tmp = NULL;
+    struct json_object *json_obj_fingerprint = NULL;
 
-    /* a = 0 = src,  a = 1 = dest */
+    char expire_field[64] = { 0 };
 
-    for (a = 0; a < 2; a++ )
+    uint64_t now = Current_Epoch();
+    uint64_t expire = 0;
+
+    size_t i = 0;
+    size_t e = 0;
+
+    if ( reply->type != REDIS_REPLY_ARRAY || reply->elements == 0 )
         {
+            return;
+        }
 
-            if ( a == SRC_IP )
-                {
-                    tmp_ip = src_ip;
-                    tmp_type = "src";
-                }
+    entry->fingerprint = calloc( reply->elements / 2, sizeof(char *) );
+
+    if ( entry->fingerprint == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for fingerprint cache. Abort!", __FILE__, __LINE__);
+        }
+
+    /* Reply is field,  value,  field,  value ... */
 
-            if ( a == DEST_IP )
+    for ( i = 0; i + 1 < reply->elements; i += 2 )
+        {
+
+            if ( strchr(reply->element[i]->str, '|') != NULL )
                 {
-                    tmp_ip = dest_ip;
-                    tmp_type = "dest";
+                    continue;		/* "|expire" entry */
                 }
 
+            /* Find this entry's expire time */
 
-            IP2Bit(tmp_ip, ip);
+            snprintf(expire_field, sizeof(expire_field), "%s|expire", reply->element[i]->str);
+            expire_field[ sizeof(expire_field) - 1 ] = '\0';
 
-            valid_fingerprint_net = false;
+            expire = 0;
 
-            for ( z = 0; z < MeerCounters->fingerprint_network_count; z++ )
+            for ( e = 0; e + 1 < reply->elements; e += 2 )
                 {
-                    if ( Is_Inrange( ip, (unsigned char *)&Fingerprint_Networks[z].range, 1) )
+                    if ( !strcmp(reply->element[e]->str, expire_field) )
                         {
-                            valid_fingerprint_net = true;
+                            expire = strtoull(reply->element[e+1]->str, NULL, 10);
                             break;
                         }
                 }
 
-            if ( valid_fingerprint_net == true )
+            if ( expire != 0 && expire < now )
                 {
 
-                    /* Get any DHCP information we might have */
+                    /* Goes out on the writer connection when Get_Fingerprint()
+                       is done */
+
+                    Redis_Pipeline_Append( REDIS_WRITER, "HDEL %s|index|%s %s %s", FINGERPRINT_REDIS_KEY, ip, reply->element[i]->str, expire_field );
+                    continue;
+                }
+
+            /* Validate fingerprint JSON */
 
-                    snprintf(tmp_command, sizeof(tmp_command), "GET %s|dhcp|%s", FINGERPRINT_REDIS_KEY, tmp_ip);
-                    tmp_command[ sizeof(tmp_command) - 1 ] = '\0';
+            if ( Validate_JSON_String( reply->element[i+1]->str ) != 0 )
+                {
+                    Meer_Log(WARN, "Incomplete or invalid fingerprint JSON.");
+                    continue;
+                }
 
-                    Redis_Reader(tmp_command, tmp_redis, MeerConfig->payload_buffer_size);
+            json_obj_fingerprint = json_tokener_parse(reply->element[i+1]->str);
 
-                    /* We have DHCP data, we append it to the alert */
+            if ( json_object_object_get_ex(json_obj_fingerprint, "fingerprint", &tmp))
+                {
 
-                    if ( tmp_redis[0] != '\0' )
+                    entry->fingerprint[entry->fingerprint_count] = strdup( json_object_get_string(tmp) );
+
+                    if ( entry->fingerprint[entry->fingerprint_count] == NULL )
                         {
+                            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for fingerprint cache. Abort!", __FILE__, __LINE__);
+                        }
 
-                            new_json_string[ strlen(new_json_string) - 2 ] = '\0';      /* Snip */
+                    entry->fingerprint_count++;
 
-                            /* Append DHCP JSON */
+                }
 
-                            snprintf(tmp_json_string, MeerConfig->payload_buffer_size, "%s, \"fingerprint_dhcp_%s\": %s }", new_json_string, tmp_type, tmp_redis);
-                            tmp_json_string[ MeerConfig->payload_buffer_size - 1 ] = '\0';
+            json_object_put(json_obj_fingerprint);
 
-                            strlcpy(new_json_string, tmp_json_string, MeerConfig->payload_buffer_size);
+        }
 
-                        }
+}
+
+/****************************************************************************
+ * Fingerprint_Fetch_Queue - Queue the DHCP GET and index HGETALL for an IP.
+ * Replies are read back with Fingerprint_Fetch_Read() so both the "src" and
+ * "dest" lookups share one round trip.  On a failure the pipeline is
+ * drained,  which drops anything queued before it too.
+ ****************************************************************************/
+
+static bool Fingerprint_Fetch_Queue( const char *ip_address )
+{
+
+    /* If only part was queued,  drain the pipeline so a stale reply isn't
+       handed to the next reader */
+
+    if ( Redis_Pipeline_Append( REDIS_READER, "GET %s|dhcp|%s", FINGERPRINT_REDIS_KEY, ip_address ) == false ||
+            Redis_Pipeline_Append( REDIS_READER, "HGETALL %s|index|%s", FINGERPRINT_REDIS_KEY, ip_address ) == false )
+        {
+            Redis_Pipeline_Flush( REDIS_READER );
+            return(false);
+        }
+
+    return(true);
 
-                    reply_r = redisCommand(MeerOutput->c_redis, "SCAN 0 MATCH %s|event|%s|* count 1000000", FINGERPRINT_REDIS_KEY, tmp_ip);
+}
+
+/****************************************************************************
+ * Fingerprint_Fetch_Read - Load the queued DHCP and fingerprint replies for
+ * an IP into "entry".  Returns false if they could not be read.
+ ****************************************************************************/
+
+static bool Fingerprint_Fetch_Read( const char *ip_address, struct _Fingerprint_Cache *entry )
+{
+
+    redisReply *reply_r = NULL;
+
+    /* Get any DHCP information we might have */
+
+    reply_r = Redis_Pipeline_Reply( REDIS_READER );
+
+    if ( reply_r == NULL )
+        {
+            Meer_Log(WARN, "[%s, line %d] Redis error reading DHCP data for %s.", __FILE__, __LINE__, ip_address);
+            return(false);
+        }
+
+    if ( MeerOutput->redis_debug )
+        {
+            Meer_Log(DEBUG, "[%s, line %d] Redis Reply: \"%s\"", __FILE__, __LINE__, reply_r->str);
+        }
 
-                    if ( reply_r->element[1]->elements > 0 )
+    if ( reply_r->type == REDIS_REPLY_STRING && reply_r->len != 0 )
+        {
+
+            entry->dhcp = strdup( reply_r->str );
+
+            if ( entry->dhcp == NULL )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for fingerprint cache. Abort!", __FILE__, __LINE__);
+                }
+        }
+
+    freeReplyObject(reply_r);
+
+    /* Every fingerprint for this IP from the index */
+
+    reply_r = Redis_Pipeline_Reply( REDIS_READER );
+
+    if ( reply_r == NULL )
+        {
+            Meer_Log(WARN, "[%s, line %d] Redis error reading fingerprint index for %s.", __FILE__, __LINE__, ip_address);
+            return(false);
+        }
+
+    Fingerprint_Index_Load( reply_r, ip_address, entry );
+
+    freeReplyObject(reply_r);
+    return(true);
+
+}
+
+void Get_Fingerprint( struct json_object *json_obj, char *str, size_t size, const char *json_string )
+{
+
+#define SRC_IP  0
+#define DEST_IP  1
+
+    struct json_object *tmp = NULL;
+
+    struct _Fingerprint_Cache uncached[2];
+    struct _Fingerprint_Cache *entry[2] = { NULL, NULL };
+
+    bool fetch[2] = { false, false };
+    bool queued[2] = { false, false };
+
+    char ip_address[2][64] = { { 0 } };
+    char *type[2] = { "src", "dest" };
+
+    char tmp_field[64] = { 0 };
+
+    unsigned char ip[2][MAXIPBIT] = { { 0 } };
+
+    uint64_t now = Current_Epoch();
+
+    uint8_t a = 0;
+    uint16_t z = 0;
+    uint16_t i = 0;
+
+    bool snipped = false;
+    bool valid_fingerprint_net = false;
+
+    char *new_json_string = malloc(MeerConfig->payload_buffer_size);
+
+    if ( new_json_string == NULL )
+        {
+            fprintf(stderr, "[%s, line %d] Fatal Error: Can't allocate memory! Abort!\n", __FILE__, __LINE__);
+            exit(-1);
+        }
+
+    memset(new_json_string, 0, MeerConfig->payload_buffer_size );
+    memset(uncached, 0, sizeof(uncached));
+
+    strlcpy(new_json_string, json_string, MeerConfig->payload_buffer_size );
+
+    json_object_object_get_ex(json_obj, "src_ip", &tmp);
+    strlcpy( ip_address[SRC_IP], json_object_get_string(tmp), sizeof(ip_address[SRC_IP]) );
+
+    json_object_object_get_ex(json_obj, "dest_ip", &tmp);
+    strlcpy( ip_address[DEST_IP], json_object_get_string(tmp), sizeof(ip_address[DEST_IP]) );
+
+    /* First pass: work out what we need from Redis and queue it.  a = 0 = src,
+       a = 1 = dest */
+
+    for (a = 0; a < 2; a++ )
+        {
+
+            IP2Bit(ip_address[a], ip[a]);
+
+            valid_fingerprint_net = false;
+
+            for ( z = 0; z < MeerCounters->fingerprint_network_count; z++ )
+                {
+                    if ( Is_Inrange( ip[a], (unsigned char *)&Fingerprint_Networks[z].range, 1) )
                         {
+                            valid_fingerprint_net = true;
+                            break;
+                        }
+                }
+
+            if ( valid_fingerprint_net == false )
+                {
+                    continue;
+                }
+
+            if ( MeerConfig->fingerprint_cache != 0 )
+                {
+
+                    entry[a] = Fingerprint_Cache_Slot( ip[a] );
 
+                    /* "src" and "dest" landed in the same slot.  Share it if
+                       it's the same IP,  otherwise don't cache "dest" */
 
-                            /* Grab individual fingerprint */
-                            for ( i = 0; i < reply_r->element[1]->elements; i++ )
+                    if ( a == DEST_IP && entry[a] == entry[SRC_IP] )
+                        {
+
+                            if ( !memcmp(ip[SRC_IP], ip[DEST_IP], MAXIPBIT) )
                                 {
+                                    continue;
+                                }
 
-                                    kr = reply_r->element[1]->element[i];
-                                    snprintf(tmp_command, sizeof(tmp_command), "GET %s", kr->str);
-                                    tmp_command[ sizeof(tmp_command) - 1 ] = '\0';
+                            entry[a] = &uncached[a];
+                            fetch[a] = true;
 
-                                    Redis_Reader(tmp_command, tmp_redis, MeerConfig->payload_buffer_size);
+                        }
 
-                                    /* Validate fingerprint JSON */
+                    else if ( memcmp(entry[a]->ip, ip[a], MAXIPBIT) || entry[a]->expire < now )
+                        {
 
-                                    if ( Validate_JSON_String( tmp_redis ) == 0 )
-                                        {
+                            Fingerprint_Cache_Clear( entry[a] );
+                            memcpy(entry[a]->ip, ip[a], MAXIPBIT);
 
-                                            json_obj_fingerprint = json_tokener_parse(tmp_redis);
+                            fetch[a] = true;
 
-                                        }
-                                    else
-                                        {
+                            MeerCounters->FingerprintCacheMissCount++;
 
-                                            Meer_Log(WARN, "Incomplete or invalid fingerprint JSON.");
+                        }
+                    else
+                        {
+                            MeerCounters->FingerprintCacheHitCount++;
+                        }
 
-                                            continue;
+                }
+            else
+                {
+                    entry[a] = &uncached[a];
+                    fetch[a] = true;
+                }
 
-                                        }
+            if ( fetch[a] == true )
+                {
 
-                                    if ( json_object_object_get_ex(json_obj_fingerprint, "fingerprint", &tmp))
-                                        {
+                    queued[a] = Fingerprint_Fetch_Queue( ip_address[a] );
 
-                                            new_json_string[ strlen(new_json_string) - 2 ] = '\0'; /* Snip */
+                    if ( queued[a] == false )
+                        {
+                            queued[0] = false;		/* Drained with the pipeline */
+                        }
 
-                                            snprintf(tmp_json_string, MeerConfig->payload_buffer_size, "%s, \"fingerprint_%s_%d\": %s }", new_json_string, tmp_type, i, json_object_get_string(tmp) );
+                }
 
-                                            tmp_json_string[ MeerConfig->payload_buffer_size - 1 ] = '\0';
+        }
 
+    /* Second pass: read the replies back and append DHCP and fingerprint
+       JSON to the alert */
 
-                                            /* Copy final_json_string to new_json_string in case we have more modifications
-                                               to make */
+    for (a = 0; a < 2; a++ )
+        {
 
-                                            strlcpy(new_json_string, tmp_json_string, MeerConfig->payload_buffer_size);
+            if ( entry[a] == NULL )
+                {
+                    continue;
+                }
 
-                                        }
+            if ( queued[a] == true && Fingerprint_Fetch_Read( ip_address[a], entry[a] ) == true && entry[a] != &uncached[a] )
+                {
+                    entry[a]->expire = now + MeerConfig->fingerprint_cache;   /* Don't hold on to a failed read */
+                }
 
-                                    json_object_put(json_obj_fingerprint);
+            if ( entry[a]->dhcp != NULL || entry[a]->fingerprint_count != 0 )
+                {
 
-                                }
+                    if ( snipped == false )
+                        {
+                            new_json_string[ strlen(new_json_string) - 2 ] = '\0';      /* Snip */
+                            snipped = true;
+                        }
 
-//				freeReplyObject(kr);
+                    if ( entry[a]->dhcp != NULL )
+                        {
+                            snprintf(tmp_field, sizeof(tmp_field), ", \"fingerprint_dhcp_%s\": ", type[a]);
+                            strlcat(new_json_string, tmp_field, MeerConfig->payload_buffer_size);
+                            strlcat(new_json_string, entry[a]->dhcp, MeerConfig->payload_buffer_size);
+                        }
+
+                    for ( i = 0; i < entry[a]->fingerprint_count; i++ )
+                        {
+                            snprintf(tmp_field, sizeof(tmp_field), ", \"fingerprint_%s_%d\": ", type[a], i);
+                            strlcat(new_json_string, tmp_field, MeerConfig->payload_buffer_size);
+                            strlcat(new_json_string, entry[a]->fingerprint[i], MeerConfig->payload_buffer_size);
                         }
 
-                    freeReplyObject(reply_r);
                 }
 
         } /* for (a = 0; a < 2; a++ ) */
 
+    /* Send any HDELs of expired index entries */
+
+    Redis_Pipeline_Flush( REDIS_WRITER );
+
+    Fingerprint_Cache_Clear( &uncached[SRC_IP] );
+    Fingerprint_Cache_Clear( &uncached[DEST_IP] );
+
+    if ( snipped == true )
+        {
+            strlcat(new_json_string, " }", MeerConfig->payload_buffer_size);
+        }
+
     snprintf(str, MeerConfig->payload_buffer_size, "%s", new_json_string);
     str[ MeerConfig->payload_buffer_size - 1 ] = '\0';
 
-    free(tmp_redis);
-    free(tmp_json_string);
     free(new_json_string);
 
-//freeReplyObject(reply_r);
 }
 
 bool Fingerprint_In_Range( char *ip_address )
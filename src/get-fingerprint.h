@@ -24,5 +24,6 @@ bool Fingerprint_In_Range( char *ip_address );
 bool Is_Fingerprint( struct json_object *json_obj );
 bool Fingerprint_JSON_IP_Redis ( struct json_object *json_obj );
 bool Fingerprint_JSON_Event_Redis ( struct json_object *json_obj, char *str, size_t size );
+void Fingerprint_Cache_Invalidate( const char *ip_address );
 void Get_Fingerprint( struct json_object *json_obj, char *str, size_t size, const char *json_string );
 
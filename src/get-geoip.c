@@ -36,140 +36,136 @@ extern struct _MeerConfig *MeerConfig;
 
 #ifdef HAVE_LIBMAXMINDDB
 
-void Get_GeoIP( struct json_object *json_obj, char *str, const char *src_ip, const char *dest_ip )
-{
+/****************************************************************************
+ * GeoIP_JSON - Build the "geoip_src" / "geoip_dest" nest from a _GeoIP
+ * record.  Returns NULL if there is nothing to add.
+ ****************************************************************************/
 
-    /*************************************************/
-    /* Add any GeoIP data for the source/destination */
-    /*************************************************/
+static struct json_object *GeoIP_JSON( struct _GeoIP *GeoIP )
+{
 
-    struct _GeoIP *GeoIP;
-    GeoIP = malloc(sizeof(_GeoIP));
+    struct json_object *jobj_geoip = NULL;
+    uint8_t i = 0;
 
-    if ( GeoIP == NULL )
+    if ( GeoIP->country[0] == '\0' )
         {
-            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for _GeoIP. Abort!", __FILE__, __LINE__);
+            return(NULL);
         }
 
-    memset(GeoIP, 0, sizeof(_GeoIP));
+    jobj_geoip = json_object_new_object();
 
-    /*******************/
-    /* Get src_ip data */
-    /*******************/
+    json_object *jgeoip_country = json_object_new_string( GeoIP->country );
+    json_object_object_add(jobj_geoip,"country", jgeoip_country);
 
-    GeoIP_Lookup( src_ip,  GeoIP );
+    if ( GeoIP->city[0] != '\0' )
+        {
+            json_object *jgeoip_city = json_object_new_string( GeoIP->city );
+            json_object_object_add(jobj_geoip,"city", jgeoip_city);
+        }
 
-    if ( GeoIP->country[0] != '\0' )
+    if ( GeoIP->subdivision[0] != '\0' )
         {
+            json_object *jgeoip_subdivision = json_object_new_string( GeoIP->subdivision );
+            json_object_object_add(jobj_geoip,"subdivision", jgeoip_subdivision);
+        }
 
-            /* Only allocate json_object when we actually need to tie it to *json_obj
-                   We won't need to deallocate it as it will become part of *json_obj! */
+    if ( GeoIP->postal[0] != '\0' )
+        {
+            json_object *jgeoip_postal = json_object_new_string( GeoIP->postal );
+            json_object_object_add(jobj_geoip,"postal", jgeoip_postal);
+        }
 
-            struct json_object *jobj_geoip_src = NULL;
-            jobj_geoip_src = json_object_new_object();
+    if ( GeoIP->timezone[0] != '\0' )
+        {
+            json_object *jgeoip_timezone = json_object_new_string( GeoIP->timezone );
+            json_object_object_add(jobj_geoip,"timezone", jgeoip_timezone);
+        }
 
-            json_object *jgeoip_country = json_object_new_string( GeoIP->country );
-            json_object_object_add(jobj_geoip_src,"country", jgeoip_country);
+    if ( GeoIP->longitude[0] != '\0' )
+        {
+            json_object *jgeoip_longitude = json_object_new_string( GeoIP->longitude );
+            json_object_object_add(jobj_geoip,"longitude", jgeoip_longitude);
+        }
 
-            if ( GeoIP->city[0] != '\0' )
-                {
-                    json_object *jgeoip_city = json_object_new_string( GeoIP->city );
-                    json_object_object_add(jobj_geoip_src,"city", jgeoip_city);
-                }
+    if ( GeoIP->latitude[0] != '\0' )
+        {
+            json_object *jgeoip_latitude = json_object_new_string( GeoIP->latitude );
+            json_object_object_add(jobj_geoip,"latitude", jgeoip_latitude);
+        }
 
-            if ( GeoIP->subdivision[0] != '\0' )
-                {
-                    json_object *jgeoip_subdivision = json_object_new_string( GeoIP->subdivision );
-                    json_object_object_add(jobj_geoip_src,"subdivision", jgeoip_subdivision);
-                }
+    /* Any extra "geoip_fields" (ASN,  ISP,  etc) */
 
-            if ( GeoIP->postal[0] != '\0' )
-                {
-                    json_object *jgeoip_postal = json_object_new_string( GeoIP->postal );
-                    json_object_object_add(jobj_geoip_src,"postal", jgeoip_postal);
-                }
+    for ( i = 0; i < MeerConfig->geoip_field_count; i++ )
+        {
 
-            if ( GeoIP->timezone[0] != '\0' )
+            if ( GeoIP->field[i][0] != '\0' )
                 {
-                    json_object *jgeoip_timezone = json_object_new_string( GeoIP->timezone );
-                    json_object_object_add(jobj_geoip_src,"timezone", jgeoip_timezone);
+                    json_object *jgeoip_field = json_object_new_string( GeoIP->field[i] );
+                    json_object_object_add(jobj_geoip, MeerConfig->geoip_field_name[i], jgeoip_field);
                 }
+        }
 
-            if ( GeoIP->longitude[0] != '\0' )
-                {
-                    json_object *jgeoip_longitude = json_object_new_string( GeoIP->longitude );
-                    json_object_object_add(jobj_geoip_src,"longitude", jgeoip_longitude);
-                }
+    return(jobj_geoip);
 
-            if ( GeoIP->latitude[0] != '\0' )
-                {
-                    json_object *jgeoip_latitude = json_object_new_string( GeoIP->latitude );
-                    json_object_object_add(jobj_geoip_src,"latitude", jgeoip_latitude);
-                }
+}
 
-            json_object_object_add(json_obj, "geoip_src", jobj_geoip_src);
+/****************************************************************************
+ * Add_GeoIP - Look up a single address and attach its nest as "key".
+ ****************************************************************************/
 
-        }
+static void Add_GeoIP( struct json_object *json_obj, const char *key, const char *ip_address )
+{
 
-    /*****************************************/
-    /* Get dest_ip GeoIP information (reset) */
-    /*****************************************/
+    struct _GeoIP_Cache *entry = NULL;
+    struct _GeoIP GeoIP = { 0 };
+    struct json_object *jobj_geoip = NULL;
 
-    memset(GeoIP, 0, sizeof(_GeoIP));
+    entry = GeoIP_Cache_Lookup( ip_address );
 
-    GeoIP_Lookup( dest_ip,  GeoIP );
+    /* Cache disabled */
 
-    if ( GeoIP->country[0] != '\0' )
+    if ( entry == NULL )
         {
 
-            struct json_object *jobj_geoip_dest = NULL;
-            jobj_geoip_dest = json_object_new_object();
+            GeoIP_Lookup( ip_address, &GeoIP );
 
-            json_object *jgeoip_country = json_object_new_string( GeoIP->country );
-            json_object_object_add(jobj_geoip_dest,"country", jgeoip_country);
+            jobj_geoip = GeoIP_JSON( &GeoIP );
 
-            if ( GeoIP->city[0] != '\0' )
+            if ( jobj_geoip != NULL )
                 {
-                    json_object *jgeoip_city = json_object_new_string( GeoIP->city );
-                    json_object_object_add(jobj_geoip_dest,"city", jgeoip_city);
+                    json_object_object_add(json_obj, key, jobj_geoip);
                 }
 
-            if ( GeoIP->subdivision[0] != '\0' )
-                {
-                    json_object *jgeoip_subdivision = json_object_new_string( GeoIP->subdivision );
-                    json_object_object_add(jobj_geoip_dest,"subdivision", jgeoip_subdivision);
-                }
+            return;
+        }
 
-            if ( GeoIP->postal[0] != '\0' )
-                {
-                    json_object *jgeoip_postal = json_object_new_string( GeoIP->postal );
-                    json_object_object_add(jobj_geoip_dest,"postal", jgeoip_postal);
-                }
+    /* The cached nest is shared between events.  json_object_get() takes a
+       reference so it survives json_obj being released. */
 
-            if ( GeoIP->timezone[0] != '\0' )
-                {
-                    json_object *jgeoip_timezone = json_object_new_string( GeoIP->timezone );
-                    json_object_object_add(jobj_geoip_dest,"timezone", jgeoip_timezone);
-                }
+    if ( entry->json_built == false )
+        {
+            entry->json = GeoIP_JSON( &entry->GeoIP );
+            entry->json_built = true;
+        }
 
-            if ( GeoIP->longitude[0] != '\0' )
-                {
-                    json_object *jgeoip_longitude = json_object_new_string( GeoIP->longitude );
-                    json_object_object_add(jobj_geoip_dest,"longitude", jgeoip_longitude);
-                }
+    if ( entry->json != NULL )
+        {
+            json_object_object_add(json_obj, key, json_object_get(entry->json));
+        }
 
-            if ( GeoIP->latitude[0] != '\0' )
-                {
-                    json_object *jgeoip_latitude = json_object_new_string( GeoIP->latitude );
-                    json_object_object_add(jobj_geoip_dest,"latitude", jgeoip_latitude);
-                }
+}
 
-            json_object_object_add(json_obj, "geoip_dest", jobj_geoip_dest);
+void Get_GeoIP( struct json_object *json_obj, char *str, const char *src_ip, const char *dest_ip )
+{
 
-        }
+    /*************************************************/
+    /* Add any GeoIP data for the source/destination */
+    /*************************************************/
+
+    Add_GeoIP( json_obj, "geoip_src", src_ip );
+    Add_GeoIP( json_obj, "geoip_dest", dest_ip );
 
     snprintf(str, MeerConfig->payload_buffer_size, "%s", (char*)json_object_to_json_string(json_obj) );
-    free(GeoIP);
 
 }
 
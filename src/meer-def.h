@@ -50,6 +50,13 @@
 #define IPv6		6
 
 #define DNS_CACHE_DEFAULT	900
+
+#define GEOIP_CACHE_DEFAULT	10000		/* Number of cached GeoIP records */
+#define GEOIP_MAX_DEPTH		4		/* Max depth of a GeoIP field path */
+#define GEOIP_MAX_KEY		32		/* Max length of a GeoIP map key */
+#define GEOIP_MAX_DATABASES	8		/* Max number of Maxmind databases */
+#define GEOIP_MAX_FIELDS	16		/* Max number of "geoip_fields" */
+#define GEOIP_FIELD_SIZE	64		/* Max length of a "geoip_fields" value */
 #define DNS_LOOKUP_TYPES	"alert,ssh,http,rdp,ftp"
 #define DNS_MAX_TYPES		20
 #define DNS_MAX_TYPES_LEN	16
@@ -77,16 +84,65 @@
 
 #define 	DEFAULT_PIPE_SIZE			1048576
 
-#define 	MAX_REDIS_BATCH				100
 #define		DEFAULT_REDIS_KEY			"suricata"
 
+#define		REDIS_READER				0		/* Decode thread connections */
+#define		REDIS_WRITER				1
+#define		REDIS_ROLES				2
+#define		REDIS_STREAM_MAXLEN_DEFAULT		100000
+#define		REDIS_STREAM_FIELD			"event"
+
+#define		REDIS_MAX_SHARDS			16
+#define		REDIS_SHARD_POINTS			160		/* Ring points per shard */
+#define		REDIS_SHARD_RETRY_MIN			1000		/* ms,  first wait on a down shard */
+#define		REDIS_SHARD_RETRY_MAX			30000		/* ms,  longest wait */
+
+#define		OUTPUT_QUEUE_DEFAULT			10000		/* Events per output worker */
+#define		OUTPUT_QUEUE_BLOCK			0
+#define		OUTPUT_QUEUE_DROP_OLDEST		1
+
+#define		OUTPUT_BREAKER_CLOSED			0
+#define		OUTPUT_BREAKER_OPEN			1
+#define		OUTPUT_BREAKER_HALF_OPEN		2
+#define		OUTPUT_BREAKER_FAILURES_DEFAULT		5
+#define		OUTPUT_BREAKER_TIMEOUT_DEFAULT		5000		/* ms */
+#define		OUTPUT_BREAKER_COOLDOWN_DEFAULT		30000		/* ms */
+
+#define		OUTPUT_SPILL_MAX_DEFAULT		1073741824	/* 1gb */
+#define		OUTPUT_SPILL_SEGMENT_DEFAULT		16777216	/* 16mb */
+#define		OUTPUT_SPILL_DEADLINE_DEFAULT		1000		/* ms */
+
 #define		MAX_ELASTICSEARCH_BATCH			10000
+#define		ELASTICSEARCH_MAX_BODY_DEFAULT		10485760	/* 10mb */
+#define		ELASTICSEARCH_BATCH_START		65536		/* Batch buffers grow from here */
+#define		ELASTICSEARCH_GZIP_LEVEL_DEFAULT	6
+#define		ELASTICSEARCH_RETRIES_DEFAULT		10
+#define		ELASTICSEARCH_RETRY_BASE_MS		1000
+#define		ELASTICSEARCH_RETRY_MAX_MS		60000
+#define		ELASTICSEARCH_CONCURRENCY_DEFAULT	8
+#define		ELASTICSEARCH_MULTI_WAIT_MS		50
+#define		ELASTICSEARCH_MAX_NODES			32
+#define		ELASTICSEARCH_PROBE_MS			5000		/* Health checks of ejected nodes */
+#define		ELASTICSEARCH_PROBE_TIMEOUT		5		/* Seconds */
+
+#define		ELASTICSEARCH_INDEX_CACHE		64		/* Rendered index names */
+#define		ELASTICSEARCH_INDEX_PARTS		32		/* Pieces of the "index" template */
+
+#define		ELASTICSEARCH_INDEX_LITERAL		0
+#define		ELASTICSEARCH_INDEX_EVENTTYPE		1
+#define		ELASTICSEARCH_INDEX_YEAR		2
+#define		ELASTICSEARCH_INDEX_MONTH		3
+#define		ELASTICSEARCH_INDEX_DAY			4
+
+#define		FLUSH_INTERVAL_DEFAULT			1000		/* ms,  partial batches */
 
 #define 	FINGERPRINT_REDIS_KEY			"fingerprint"
 #define		FINGERPRINT_REDIS_EXPIRE		3600
 #define		FINGERPRINT_DHCP_REDIS_EXPIRE		86400
 #define         FINGERPRINT_IP_REDIS_EXPIRE             86400
 #define		FINGERPRINT_EVENT_REDIS_EXPIRE		86400
+#define		FINGERPRINT_CACHE_DEFAULT		60		/* Seconds */
+#define		FINGERPRINT_CACHE_SIZE			4096		/* Must be a power of 2 */
 
 #define 	MEER_USER_AGENT 			"User-Agent: Meer"
 #define 	MEER_BLUEDOT_SOURCE			"Meer"
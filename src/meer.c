@@ -85,7 +85,7 @@ int main (int argc, char *argv[])
     signal(SIGPIPE, &Signal_Handler);
 //    signal(SIGSEGV,  &Signal_Handler);
     signal(SIGABRT,  &Signal_Handler);
-//    signal(SIGHUP,  &Signal_Handler);		/* DEBUG: Need SIGHUP handler */
+    signal(SIGHUP,  &Signal_Handler);
     signal(SIGUSR1,  &Signal_Handler);
 
     /* MOST configuration options should happen in the meer.yaml.  Barnyard2's
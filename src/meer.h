@@ -86,7 +86,12 @@ struct _MeerConfig
 #ifdef HAVE_LIBMAXMINDDB
 
     bool geoip;
-    char geoip_database[256];
+    char geoip_database[GEOIP_MAX_DATABASES][256];
+    uint8_t geoip_database_count;
+    char geoip_field_path[GEOIP_MAX_FIELDS][128];
+    char geoip_field_name[GEOIP_MAX_FIELDS][32];
+    uint8_t geoip_field_count;
+    uint32_t geoip_cache;
 
 #endif
 
@@ -104,6 +109,7 @@ struct _MeerConfig
     bool fingerprint;
     bool fingerprint_reader;
     bool fingerprint_writer;
+    uint32_t fingerprint_cache;
 
     bool client_stats;
     uint8_t client_stats_type;
@@ -135,52 +141,41 @@ struct _MeerInput
 };
 
 
+/* Each output's worker queue and circuit breaker (see output-queue.c) */
+
+struct _Output_Queue_Config
+{
+    uint32_t size;				/* Events */
+    uint8_t full;				/* OUTPUT_QUEUE_BLOCK, etc */
+    uint16_t breaker_failures;			/* Failed writes in a row,  0 == no breaker */
+    uint32_t breaker_timeout;			/* ms a write may take */
+    uint32_t breaker_cooldown;			/* ms the breaker stays open */
+    char spill[256];				/* Directory,  "" == don't spill */
+    uint64_t spill_max;				/* Bytes on disk */
+    uint32_t spill_segment;			/* Bytes per segment file */
+    uint32_t spill_deadline;			/* ms to wait on a full queue */
+};
+
 typedef struct _MeerOutput _MeerOutput;
 struct _MeerOutput
 {
 
 #ifdef HAVE_LIBHIREDIS
 
-    bool redis_enabled;
+    bool redis_enabled;				/* The plain "redis" block,  for fingerprint and client_stats */
     char redis_server[255];
     int  redis_port;
-    int  redis_batch;
     char redis_password[255];
     bool redis_debug;
-    bool redis_error;
-    char redis_key[128];
-    char redis_command[16];
-    bool redis_append_id;
-
-    redisContext *c_redis;
-
-    bool redis_alert;
-    bool redis_files;
-    bool redis_flow;
-    bool redis_dns;
-    bool redis_http;
-    bool redis_tls;
-    bool redis_ssh;
-    bool redis_smtp;
-    bool redis_email;
-    bool redis_fileinfo;
-    bool redis_dhcp;
-    bool redis_stats;
-    bool redis_rdp;
-    bool redis_sip;
-    bool redis_ftp;
-    bool redis_ikev2;
-    bool redis_nfs;
-    bool redis_tftp;
-    bool redis_smb;
-    bool redis_mqtt;
-    bool redis_dcerpc;
-    bool redis_netflow;
-    bool redis_metadata;
-    bool redis_dnp3;
-    bool redis_anomaly;
-    bool redis_fingerprint;
-    bool redis_client_stats;
+    bool redis_error[REDIS_ROLES];
+
+    char redis_reader_server[255];		/* Empty == "server" */
+    int  redis_reader_port;
+
+    redisContext *c_redis[REDIS_ROLES];		/* REDIS_READER / REDIS_WRITER */
+
+    struct _Redis_Output **redis;		/* Every enabled "redis" output */
+    uint8_t redis_count;
 
 #endif
 
@@ -191,52 +186,20 @@ struct _MeerOutput
     char bluedot_url[8192];
     bool bluedot_insecure;
     char bluedot_source[128];
+    struct _Output_Queue_Config bluedot_worker;
 
 #endif
 
 #ifdef WITH_ELASTICSEARCH
 
-    bool elasticsearch_enabled;
-    bool elasticsearch_debug;
-    bool elasticsearch_insecure;
-    char elasticsearch_url[8192];
-    char elasticsearch_index[512];
-    char elasticsearch_username[64];
-    char elasticsearch_password[128];
-    uint16_t elasticsearch_batch;
-    uint8_t elasticsearch_threads;
-
-    bool elasticsearch_alert;
-    bool elasticsearch_files;
-    bool elasticsearch_flow;
-    bool elasticsearch_dns;
-    bool elasticsearch_http;
-    bool elasticsearch_tls;
-    bool elasticsearch_ssh;
-    bool elasticsearch_smtp;
-    bool elasticsearch_email;
-    bool elasticsearch_fileinfo;
-    bool elasticsearch_dhcp;
-    bool elasticsearch_stats;
-    bool elasticsearch_rdp;
-    bool elasticsearch_sip;
-    bool elasticsearch_ftp;
-    bool elasticsearch_ikev2;
-    bool elasticsearch_nfs;
-    bool elasticsearch_tftp;
-    bool elasticsearch_smb;
-    bool elasticsearch_mqtt;
-    bool elasticsearch_dcerpc;
-    bool elasticsearch_netflow;
-    bool elasticsearch_metadata;
-    bool elasticsearch_dnp3;
-    bool elasticsearch_anomaly;
-    bool elasticsearch_fingerprint;
-    bool elasticsearch_ndp;
+    bool elasticsearch_enabled;			/* At least one "elasticsearch" output */
+    struct _Elasticsearch_Output **elasticsearch;
+    uint8_t elasticsearch_count;
 
 #endif
 
     bool external_enabled;
+    struct _Output_Queue_Config external_worker;
     uint8_t external_based_on;
     bool external_debug;
     bool external_meer_metadata_flag;
@@ -285,6 +248,7 @@ struct _MeerOutput
 #ifdef WITH_SYSLOG
 
     bool syslog_enabled;
+    struct _Output_Queue_Config syslog_worker;
     int  syslog_facility;
     int  syslog_priority;
     int  syslog_options;
@@ -319,68 +283,13 @@ struct _MeerOutput
 #endif
 
 
-    bool file_enabled;
-    FILE *file_fd;
-    char file_location[256];
-
-    bool file_alert;
-    bool file_email;
-    bool file_files;
-    bool file_flow;
-    bool file_stats;
-    bool file_http;
-    bool file_smtp;
-    bool file_ssh;
-    bool file_tls;
-    bool file_dns;
-    bool file_fileinfo;
-    bool file_dhcp;
-    bool file_rdp;
-    bool file_sip;
-    bool file_ftp;
-    bool file_ikev2;
-    bool file_nfs;
-    bool file_tftp;
-    bool file_smb;
-    bool file_dcerpc;
-    bool file_mqtt;
-    bool file_netflow;
-    bool file_metadata;
-    bool file_dnp3;
-    bool file_anomaly;
-    bool file_fingerprint;
-
-    bool pipe_enabled;
-    char pipe_location[256];
-    int  pipe_fd;
-    uint32_t pipe_size;
-
-    bool pipe_alert;
-    bool pipe_files;
-    bool pipe_flow;
-    bool pipe_dns;
-    bool pipe_http;
-    bool pipe_tls;
-    bool pipe_ssh;
-    bool pipe_smtp;
-    bool pipe_email;
-    bool pipe_fileinfo;
-    bool pipe_dhcp;
-    bool pipe_stats;
-    bool pipe_rdp;
-    bool pipe_sip;
-    bool pipe_ftp;
-    bool pipe_ikev2;
-    bool pipe_nfs;
-    bool pipe_tftp;
-    bool pipe_smb;
-    bool pipe_dcerpc;
-    bool pipe_mqtt;
-    bool pipe_netflow;
-    bool pipe_metadata;
-    bool pipe_dnp3;
-    bool pipe_anomaly;
-    bool pipe_fingerprint;
+    bool file_enabled;				/* At least one "file" output */
+    struct _File_Output **file;
+    uint8_t file_count;
+
+    bool pipe_enabled;				/* At least one "pipe" output */
+    struct _Pipe_Output **pipe;
+    uint8_t pipe_count;
 
 };
 
@@ -468,6 +377,19 @@ struct _MeerCounters
     uint64_t DNSCacheCount;
     uint64_t BluedotCount;
 
+    uint64_t GeoIPLookupCount;
+    uint64_t GeoIPCacheHitCount;
+
+    uint64_t FingerprintCacheHitCount;
+    uint64_t FingerprintCacheMissCount;
+
+    uint64_t ElasticsearchRawBytes;		/* Bulk bodies before compression */
+    uint64_t ElasticsearchWireBytes;		/* What was actually POSTed */
+    uint64_t ElasticsearchIndexedCount;
+    uint64_t ElasticsearchRetryCount;		/* Events sent again */
+    uint64_t ElasticsearchDeadLetterCount;
+    uint64_t ElasticsearchDropCount;		/* Failed,  no dead letter file */
+
 };
 
 
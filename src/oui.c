@@ -38,32 +38,187 @@
 extern struct _MeerCounters *MeerCounters;
 extern struct _MeerConfig *MeerConfig;
 
-struct _Manfact_Struct *MF_Struct = NULL;
+/* The loaded table.  Replaced as a whole by OUI_Swap_Table() on a
+   reload (SIGHUP). */
+
+struct _OUI_Table
+{
+    struct _Manfact_Struct *entries;
+    uint32_t count;
+    uint32_t capacity;
+
+    char *pool;
+    size_t pool_len;
+    size_t pool_size;
+
+    uint8_t bits[8];		/* Prefix lengths in use,  longest first */
+    uint8_t bits_count;
+};
+
+struct _OUI_Table *OUI_Table = NULL;
+
+/****************************************************************************
+ * OUI_Parse_MAC - Convert "00:1B:C5", "00-1b-c5-00-00-00" etc into a 48 bit
+ * value.  Returns the number of bits that were present.
+ ****************************************************************************/
+
+static uint8_t OUI_Parse_MAC( const char *mac, uint64_t *out )
+{
+
+    uint64_t value = 0;
+    uint8_t digits = 0;
+    int c = 0;
+
+    for ( ; *mac != '\0' && *mac != '/' && digits < 12; mac++ )
+        {
+
+            c = *mac;
+
+            if ( c >= '0' && c <= '9' )
+                {
+                    c = c - '0';
+                }
+            else if ( c >= 'a' && c <= 'f' )
+                {
+                    c = c - 'a' + 10;
+                }
+            else if ( c >= 'A' && c <= 'F' )
+                {
+                    c = c - 'A' + 10;
+                }
+            else
+                {
+                    continue;		/* Separator */
+                }
+
+            value = ( value << 4 ) | c;
+            digits++;
+        }
+
+    *out = value << ( ( 12 - digits ) * 4 );
+
+    return( digits * 4 );
+
+}
+
+/****************************************************************************
+ * OUI_Mask - Mask a 48 bit MAC down to "bits"
+ ****************************************************************************/
+
+static inline uint64_t OUI_Mask( uint64_t mac, uint8_t bits )
+{
+    return( mac & ( 0xFFFFFFFFFFFFULL << ( 48 - bits ) ) & 0xFFFFFFFFFFFFULL );
+}
+
+static int OUI_Compare( const void *a, const void *b )
+{
+
+    const struct _Manfact_Struct *x = a;
+    const struct _Manfact_Struct *y = b;
+
+    if ( x->prefix != y->prefix )
+        {
+            return( x->prefix < y->prefix ? -1 : 1 );
+        }
+
+    return( (int)x->bits - (int)y->bits );
+
+}
+
+/****************************************************************************
+ * OUI_Pool_Add - Copy a string into the pool,  returning its offset
+ ****************************************************************************/
+
+static uint32_t OUI_Pool_Add( struct _OUI_Table *Table, const char *str )
+{
+
+    size_t len = strlen(str) + 1;
+    uint32_t offset = Table->pool_len;
+
+    if ( Table->pool_len + len > Table->pool_size )
+        {
+
+            Table->pool_size = Table->pool_size == 0 ? 65536 : Table->pool_size * 2;
+
+            while ( Table->pool_len + len > Table->pool_size )
+                {
+                    Table->pool_size *= 2;
+                }
+
+            Table->pool = realloc(Table->pool, Table->pool_size);
+
+            if ( Table->pool == NULL )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Failed to reallocate memory for the OUI string pool. Abort!", __FILE__, __LINE__);
+                }
+        }
+
+    memcpy(Table->pool + offset, str, len);
+    Table->pool_len += len;
+
+    return(offset);
+
+}
+
+void OUI_Free_Table( struct _OUI_Table *Table )
+{
+
+    if ( Table == NULL )
+        {
+            return;
+        }
+
+    free(Table->entries);
+    free(Table->pool);
+    free(Table);
+
+}
 
 /*****************************************************************************/
 /* Load MAC/Vendor information into memory.  This list is from the Wireshark */
 /* team.  Get it:							     */
 /* https://gitlab.com/wireshark/wireshark/raw/master/manuf                   */
 /* The list need to be in the wireshark format!                              */
+/*                                                                           */
+/* OUI_Load_Table() is used at startup and by the reload thread,  so it      */
+/* returns NULL rather than exiting when the file is bad.                    */
 /*****************************************************************************/
 
-void Load_OUI( void )
+struct _OUI_Table *OUI_Load_Table( void )
 {
 
     char buf[1024] = { 0 };
     char *saveptr = NULL;
 
     char *mac = NULL;
+    char *mask = NULL;
     char *short_manfact = NULL;
     char *long_manfact = NULL;
 
     int linecount = 0;
 
+    uint64_t prefix = 0;
+    uint8_t bits = 0;
+    uint8_t i = 0;
+    uint8_t j = 0;
+    uint32_t count = 0;
+    uint32_t unique = 0;
+
+    struct _OUI_Table *Table = NULL;
+
     FILE *mf;
 
     if (( mf = fopen(MeerConfig->oui_filename, "r" )) == NULL )
         {
-            Meer_Log(ERROR, "[%s, line %d] Cannot open rule file %s. [%s]", __FILE__,  __LINE__, MeerConfig->oui_filename, strerror(errno) );
+            Meer_Log(WARN, "[%s, line %d] Cannot open OUI file %s. [%s]", __FILE__,  __LINE__, MeerConfig->oui_filename, strerror(errno) );
+            return(NULL);
+        }
+
+    Table = calloc( 1, sizeof(struct _OUI_Table) );
+
+    if ( Table == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for _OUI_Table. Abort!", __FILE__, __LINE__);
         }
 
     while(fgets(buf, sizeof(buf), mf) != NULL)
@@ -78,7 +233,7 @@ void Load_OUI( void )
                     continue;
                 }
 
-            buf[ strlen(buf) - 1 ] = '\0';		/* Remove return */
+            buf[ strcspn(buf, "\r\n") ] = '\0';		/* Remove return */
 
             /* Pull in all values */
 
@@ -91,42 +246,136 @@ void Load_OUI( void )
 
             if ( mac == NULL || short_manfact == NULL )
                 {
-                    Meer_Log(ERROR, "[%s, line %d] %s incorrectly formated at line %d", __FILE__,  __LINE__, MeerConfig->oui_filename, linecount );
+                    Meer_Log(WARN, "[%s, line %d] %s incorrectly formated at line %d", __FILE__,  __LINE__, MeerConfig->oui_filename, linecount );
+                    fclose(mf);
+                    OUI_Free_Table( Table );
+                    return(NULL);
                 }
 
-            /* if no long_manfact is present */
+            bits = OUI_Parse_MAC( mac, &prefix );
+
+            /* Wireshark uses 00:1B:C5:00:00:00/36 for MA-M/MA-S blocks */
 
-            if ( long_manfact == NULL )
+            mask = strchr(mac, '/');
+
+            if ( mask != NULL )
                 {
-                    long_manfact = "0";
+                    bits = atoi(mask + 1);
                 }
 
-            /* Allocate memory for classifications,  but not comments */
+            if ( bits == 0 || bits > 48 )
+                {
+                    Meer_Log(WARN, "[%s, line %d] %s has an invalid prefix at line %d. Skipping.", __FILE__,  __LINE__, MeerConfig->oui_filename, linecount );
+                    continue;
+                }
 
-            MF_Struct = (_Manfact_Struct *) realloc(MF_Struct, (MeerCounters->OUICount+1) * sizeof(_Manfact_Struct));
+            /* Grow the table geometrically rather than once per line */
 
-            if ( MF_Struct == NULL )
+            if ( Table->count >= Table->capacity )
                 {
-                    Meer_Log(ERROR, "[%s, line %d] Failed to reallocate memory for _Manfact_Struct. Abort!", __FILE__, __LINE__);
-                }
 
-            memset(&MF_Struct[MeerCounters->OUICount], 0, sizeof(struct _Manfact_Struct));
+                    Table->capacity = Table->capacity == 0 ? 32768 : Table->capacity * 2;
+
+                    Table->entries = (_Manfact_Struct *) realloc(Table->entries, Table->capacity * sizeof(_Manfact_Struct));
 
+                    if ( Table->entries == NULL )
+                        {
+                            Meer_Log(ERROR, "[%s, line %d] Failed to reallocate memory for _Manfact_Struct. Abort!", __FILE__, __LINE__);
+                        }
+                }
 
             /* Store into memory the values */
 
-            strlcpy(MF_Struct[MeerCounters->OUICount].mac, mac, sizeof(MF_Struct[MeerCounters->OUICount].mac));
-            strlcpy(MF_Struct[MeerCounters->OUICount].short_manfact, short_manfact, sizeof(MF_Struct[MeerCounters->OUICount].short_manfact));
-            strlcpy(MF_Struct[MeerCounters->OUICount].long_manfact, long_manfact, sizeof(MF_Struct[MeerCounters->OUICount].long_manfact));
+            Table->entries[Table->count].prefix = OUI_Mask( prefix, bits );
+            Table->entries[Table->count].bits = bits;
+            Table->entries[Table->count].short_manfact = OUI_Pool_Add( Table, short_manfact );
+            Table->entries[Table->count].long_manfact = long_manfact == NULL ? OUI_NONE : OUI_Pool_Add( Table, long_manfact );
+
+            /* Track which prefix lengths we need to search */
+
+            for ( i = 0; i < Table->bits_count; i++ )
+                {
+                    if ( Table->bits[i] == bits )
+                        {
+                            break;
+                        }
+                }
+
+            if ( i == Table->bits_count && Table->bits_count < sizeof(Table->bits) )
+                {
+                    Table->bits[Table->bits_count++] = bits;
+                }
+
+            Table->count++;
+
+        }
+
+    fclose(mf);
+
+    /* Longest (most specific) prefix first */
+
+    for ( i = 1; i < Table->bits_count; i++ )
+        {
+            for ( j = i; j > 0 && Table->bits[j] > Table->bits[j-1]; j-- )
+                {
+                    bits = Table->bits[j];
+                    Table->bits[j] = Table->bits[j-1];
+                    Table->bits[j-1] = bits;
+                }
+        }
+
+    qsort(Table->entries, Table->count, sizeof(_Manfact_Struct), OUI_Compare);
 
-            MeerCounters->OUICount++;
+    /* Drop duplicate prefixes */
 
+    for ( count = 0; count < Table->count; count++ )
+        {
+            if ( unique == 0 || OUI_Compare( &Table->entries[count], &Table->entries[unique-1] ) != 0 )
+                {
+                    Table->entries[unique++] = Table->entries[count];
+                }
         }
 
+    Table->count = unique;
+
+    return(Table);
+
+}
+
+/****************************************************************************
+ * OUI_Swap_Table - Put a freshly loaded table into service and release the
+ * old one.  This must be called from the decoding thread between events
+ * (see reload.c),  which is the only user of the table.
+ ****************************************************************************/
+
+void OUI_Swap_Table( struct _OUI_Table *Table )
+{
+
+    struct _OUI_Table *old = OUI_Table;
+
+    OUI_Table = Table;
+    MeerCounters->OUICount = Table->count;
+
+    OUI_Free_Table( old );
+
     Meer_Log(NORMAL, "Loaded %d entries from OUI database [%s].",  MeerCounters->OUICount,  MeerConfig->oui_filename);
 
 }
 
+void Load_OUI( void )
+{
+
+    struct _OUI_Table *Table = OUI_Load_Table();
+
+    if ( Table == NULL )
+        {
+            Meer_Log(ERROR, "Unable to load the OUI database %s. Abort!", MeerConfig->oui_filename);
+        }
+
+    OUI_Swap_Table( Table );
+
+}
+
 
 /**************************************************************/
 /* OUI_Lookup - looks up a MAC address and returns the vender */
@@ -135,63 +384,42 @@ void Load_OUI( void )
 void OUI_Lookup ( char *mac, char *str, size_t size )
 {
 
-    char *s1 = NULL;
-    char *s2 = NULL;
-    char *s3 = NULL;
-    char *saveptr = NULL;
-
-    int i = 0;
-
-    char new_mac[32] = { 0 };
-    char search_string[9] = { 0 };
-
-    /* Convert the MAC to upper case */
+    struct _Manfact_Struct key;
+    struct _Manfact_Struct *entry = NULL;
 
-    strlcpy(new_mac, mac, sizeof(new_mac));
-    To_UpperC(new_mac);
+    uint64_t value = 0;
+    uint8_t i = 0;
 
-    /* Break up the MAC ( 00:00:00 ) */
+    str[0] = '\0';
 
-    s1 = strtok_r(new_mac, ":", &saveptr);
-    s2 = strtok_r(NULL, ":", &saveptr);
-    s3 = strtok_r(NULL, ":", &saveptr);
+    if ( OUI_Table == NULL || OUI_Parse_MAC( mac, &value ) != 48 )
+        {
+            return;
+        }
 
-    /* Our new search string */
+    /* Try the most specific prefix first (/36,  then /28,  then /24) */
 
-    snprintf(search_string, sizeof(search_string), "%s:%s:%s", s1, s2, s3);
-    search_string[ sizeof(search_string) - 1 ] = '\0';
+    for ( i = 0; i < OUI_Table->bits_count; i++ )
+        {
 
-    /* See if we can find the MAC address */
+            key.bits = OUI_Table->bits[i];
+            key.prefix = OUI_Mask( value, OUI_Table->bits[i] );
 
-    for ( i = 0; i < MeerCounters->OUICount; i++ )
-        {
+            entry = bsearch(&key, OUI_Table->entries, OUI_Table->count, sizeof(_Manfact_Struct), OUI_Compare);
 
-            if ( !strncmp(search_string,  MF_Struct[i].mac, 8) )
+            if ( entry != NULL )
                 {
 
                     /* By default, return the long_manfact information.  If that
                        isn't present,  then return the short_manfact data */
 
-                    if ( MF_Struct[i].long_manfact[0] != '0' )
-                        {
-                            snprintf(str, size, "%s", MF_Struct[i].long_manfact);
-                            str[ size - 1 ] = '\0';
-                            return;
-                        }
-                    else
-                        {
-                            snprintf(str, size, "%s", MF_Struct[i].short_manfact);
-                            str[ size - 1 ] = '\0';
-                            return;
-                        }
+                    snprintf(str, size, "%s", OUI_Table->pool + ( entry->long_manfact != OUI_NONE ? entry->long_manfact : entry->short_manfact ) );
+                    str[ size - 1 ] = '\0';
+                    return;
 
                 }
-
         }
 
     /* Unknown / not found */
 
-    str[0] = '\0';
-
 }
-
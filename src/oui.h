@@ -18,16 +18,28 @@
 ** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
+/* Vendor names are stored once in a string pool (see oui.c) and
+   referenced by offset.  The table is sorted by prefix/bits so lookups
+   are a binary search per prefix length. */
+
+#define OUI_NONE	0xFFFFFFFF
+
 typedef struct _Manfact_Struct _Manfact_Struct;
 struct _Manfact_Struct
 {
-    char mac[22];
-    char short_manfact[9];
-    char long_manfact[128];
+    uint64_t prefix;		/* 48 bit MAC,  masked to "bits" */
+    uint8_t bits;		/* 24,  28,  36,  etc */
+    uint32_t short_manfact;	/* Offset into OUI_Pool */
+    uint32_t long_manfact;	/* Offset into OUI_Pool or OUI_NONE */
 };
 
 
+struct _OUI_Table;
+
 void Load_OUI( void );
+struct _OUI_Table *OUI_Load_Table( void );
+void OUI_Free_Table( struct _OUI_Table *Table );
+void OUI_Swap_Table( struct _OUI_Table *Table );
 void OUI_Lookup ( char *mac, char *str, size_t size );
 
 
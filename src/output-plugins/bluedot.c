@@ -50,6 +50,7 @@
 #include "meer-def.h"
 #include "util.h"
 #include "bluedot.h"
+#include "output-queue.h"
 
 extern struct _MeerOutput *MeerOutput;
 extern struct _MeerCounters *MeerCounters;
@@ -209,6 +210,7 @@ void Bluedot ( const char *metadata, struct json_object *json_obj )
     if(res != CURLE_OK)
         {
             Meer_Log(WARN, "curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
+            Output_Queue_Failed();
         }
 
     json_object_put(json_obj_metadata);
@@ -32,32 +32,48 @@
 #include <unistd.h>
 #include <json-c/json.h>
 #include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <stdint.h>
+#include <ctype.h>
 
 #include <curl/curl.h>
 
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
 #include "meer-def.h"
 #include "meer.h"
 #include "util.h"
 #include "lockfile.h"
+#include "output-queue.h"
 
 #include "output-plugins/elasticsearch.h"
 
 extern struct _MeerConfig *MeerConfig;
 extern struct _MeerOutput *MeerOutput;
+extern struct _MeerCounters *MeerCounters;
 
 extern bool elasticsearch_death;
 
-/* Globals for Elasticsearch threads */
+/* Each output's queue worker fills "es->current" under "batch_mutex",
+   which Elasticsearch_Flush_Thread() also takes to send a partial batch
+   once it is "flush_interval" ms old.  Once it holds "batch" events it
+   goes on a bounded queue and any free worker of that output posts it.
+   Each batch owns its buffer,  so a batch is never overwritten while it
+   waits.  Posted batches go back on a free list for reuse.  When the queue
+   is full,  the queue worker waits on a condition variable until a worker
+   takes a batch.
 
-uint16_t elasticsearch_batch_count = 0;
-char *big_batch;
-char *big_batch_THREAD;
+   Nodes come from "url".  Each request goes to the healthy node with the
+   fewest requests in flight.  A node that fails is ejected until a
+   background probe finds it answering again. */
 
-extern pthread_cond_t MeerElasticWork;
-extern pthread_mutex_t MeerElasticMutex;
+/* Batches queued,  being posted or waiting to retry.  Shutdown waits for
+   this to reach 0 */
 
-extern uint_fast16_t elastic_proc_msgslot;
-extern uint_fast16_t elastic_proc_running;
+uint_fast16_t elastic_proc_running = 0;
 
 static size_t WriteMemoryCallback(void *contents, size_t size, size_t nmemb, void *userp)
 {
@@ -80,321 +96,2127 @@ static size_t WriteMemoryCallback(void *contents, size_t size, size_t nmemb, voi
     return realsize;
 }
 
-void Elasticsearch_Init( void )
-{
+/****************************************************************************
+ * Elasticsearch_Read_Callback - Hand libcurl the bulk body one segment at a
+ * time,  so the body is never joined into one buffer.
+ ****************************************************************************/
 
-    uint8_t i=0;
-    int rc=0;
+static size_t Elasticsearch_Read_Callback(char *buffer, size_t size, size_t nitems, void *userp)
+{
 
-    pthread_t elasticsearch_id[MeerOutput->elasticsearch_threads];
-    pthread_attr_t thread_elasticsearch_attr;
-    pthread_attr_init(&thread_elasticsearch_attr);
-    pthread_attr_setdetachstate(&thread_elasticsearch_attr,  PTHREAD_CREATE_DETACHED);
+    struct _Elasticsearch_Batch *batch = (struct _Elasticsearch_Batch *)userp;
+    struct _Elasticsearch_Segment *segment = NULL;
 
-    big_batch = malloc( (MeerConfig->payload_buffer_size * MeerOutput->elasticsearch_batch )*sizeof(char));
+    size_t room = size * nitems;
+    size_t copied = 0;
+    size_t len = 0;
 
-    if ( big_batch == NULL )
+    while ( copied < room && batch->read_segment < batch->segment_count )
         {
-            fprintf(stderr, "[%s, line %d] Fatal Error:  Can't allocate memory! Abort!\n", __FILE__, __LINE__);
-            exit(-1);
+
+            segment = &batch->segments[batch->read_segment];
+
+            len = segment->len - batch->read_offset;
+
+            if ( len > room - copied )
+                {
+                    len = room - copied;
+                }
+
+            memcpy( buffer + copied, batch->data + segment->offset + batch->read_offset, len );
+
+            copied += len;
+            batch->read_offset += len;
+
+            if ( batch->read_offset == segment->len )
+                {
+                    batch->read_segment++;
+                    batch->read_offset = 0;
+                }
+
         }
 
-    big_batch_THREAD = malloc( (MeerConfig->payload_buffer_size * MeerOutput->elasticsearch_batch )*sizeof(char));
+    return(copied);
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Seek_Callback - libcurl rewinds the body when it has to send
+ * it again (redirects,  authentication).
+ ****************************************************************************/
+
+static int Elasticsearch_Seek_Callback(void *userp, curl_off_t offset, int origin)
+{
 
-    if ( big_batch_THREAD == NULL )
+    struct _Elasticsearch_Batch *batch = (struct _Elasticsearch_Batch *)userp;
+
+    if ( origin != SEEK_SET || offset < 0 || (size_t)offset > batch->body_len )
         {
-            fprintf(stderr, "[%s, line %d] Fatal Error:  Can't allocate memory! Abort!\n", __FILE__, __LINE__);
-            exit(-1);
+            return(CURL_SEEKFUNC_CANTSEEK);
         }
 
-    Meer_Log(NORMAL, "");
-    Meer_Log(NORMAL, "Spawning %d Elasticsearch threads.", MeerOutput->elasticsearch_threads);
+    batch->read_segment = 0;
+    batch->read_offset = 0;
 
-    for (i = 0; i < MeerOutput->elasticsearch_threads; i++)
+    while ( batch->read_segment < batch->segment_count &&
+            (size_t)offset >= batch->segments[batch->read_segment].len )
         {
+            offset -= batch->segments[batch->read_segment].len;
+            batch->read_segment++;
+        }
 
-            rc = pthread_create ( &elasticsearch_id[i], &thread_elasticsearch_attr, (void *)Elasticsearch, NULL );
-
-            if ( rc != 0 )
-                {
+    batch->read_offset = offset;
 
-                    Remove_Lock_File();
-                    Meer_Log(ERROR, "Could not pthread_create() for I/O processors [error: %d]", rc);
-                }
-        }
+    return(CURL_SEEKFUNC_OK);
 
 }
 
-void Elasticsearch_Get_Index ( char *str, size_t size, const char *event_type )
+/****************************************************************************
+ * Elasticsearch_Index_Compile - Split the "index" template into literal
+ * text and $EVENTTYPE,  $YEAR,  $MONTH and $DAY tokens.  Done once at
+ * startup.
+ ****************************************************************************/
+
+static void Elasticsearch_Index_Compile( struct _Elasticsearch_Output *es )
 {
 
-    char tmp[512] = { 0 };
-    char index[512] = { 0 };
-    uint16_t i = 0;
-    uint16_t a = 0;
-    uint8_t pos=0;
+    const char *template = es->index;
+    struct _Elasticsearch_Index_Part *part = NULL;
 
-    time_t t = time(NULL);
-    struct tm tm = *localtime(&t);
+    uint8_t type = 0;
+    size_t len = 0;
+    size_t i = 0;
 
-    for (i = 0; i < strlen(MeerOutput->elasticsearch_index); i++ )
+    es->index_part_count = 0;
+
+    while ( template[i] != '\0' )
         {
-            /* $EVENTTYPE */
 
-            if ( MeerOutput->elasticsearch_index[i] == '$' &&
-                    MeerOutput->elasticsearch_index[i+1] == 'E' &&
-                    MeerOutput->elasticsearch_index[i+2] == 'V' &&
-                    MeerOutput->elasticsearch_index[i+3] == 'E' &&
-                    MeerOutput->elasticsearch_index[i+4] == 'N' &&
-                    MeerOutput->elasticsearch_index[i+5] == 'T' &&
-                    MeerOutput->elasticsearch_index[i+6] == 'T' &&
-                    MeerOutput->elasticsearch_index[i+7] == 'Y' &&
-                    MeerOutput->elasticsearch_index[i+8] == 'P' &&
-                    MeerOutput->elasticsearch_index[i+9] == 'E' )
+            if ( !strncmp(&template[i], "$EVENTTYPE", 10) )
                 {
-                    for ( a = 0; a < strlen(event_type); a++ )
-                        {
-                            index[pos] = event_type[a];
-                            pos++;
-                        }
-                    i = i+10;
+                    type = ELASTICSEARCH_INDEX_EVENTTYPE;
+                    len = 10;
                 }
 
-            /* $YEAR */
-
-            if ( MeerOutput->elasticsearch_index[i] == '$' &&
-                    MeerOutput->elasticsearch_index[i+1] == 'Y' &&
-                    MeerOutput->elasticsearch_index[i+2] == 'E' &&
-                    MeerOutput->elasticsearch_index[i+3] == 'A' &&
-                    MeerOutput->elasticsearch_index[i+4] == 'R' )
+            else if ( !strncmp(&template[i], "$YEAR", 5) )
                 {
+                    type = ELASTICSEARCH_INDEX_YEAR;
+                    len = 5;
+                }
 
-                    snprintf(tmp, sizeof(tmp), "%d", tm.tm_year + 1900);
-                    tmp[ sizeof(tmp) - 1 ] = '\0';
-
-                    for ( a = 0; a < strlen(tmp); a++ )
-                        {
-                            index[pos] = tmp[a];
-                            pos++;
-                        }
+            else if ( !strncmp(&template[i], "$MONTH", 6) )
+                {
+                    type = ELASTICSEARCH_INDEX_MONTH;
+                    len = 6;
+                }
 
-                    i = i+5;
+            else if ( !strncmp(&template[i], "$DAY", 4) )
+                {
+                    type = ELASTICSEARCH_INDEX_DAY;
+                    len = 4;
                 }
 
-            /* $MONTH */
+            else
+                {
+                    type = ELASTICSEARCH_INDEX_LITERAL;
+                    len = 1;
+                }
 
-            if ( MeerOutput->elasticsearch_index[i] == '$' &&
-                    MeerOutput->elasticsearch_index[i+1] == 'M' &&
-                    MeerOutput->elasticsearch_index[i+2] == 'O' &&
-                    MeerOutput->elasticsearch_index[i+3] == 'N' &&
-                    MeerOutput->elasticsearch_index[i+4] == 'T' &&
-                    MeerOutput->elasticsearch_index[i+5] == 'H' )
+            if ( type == ELASTICSEARCH_INDEX_LITERAL && part != NULL && part->type == ELASTICSEARCH_INDEX_LITERAL )
                 {
 
-                    snprintf(tmp, sizeof(tmp), "%02d", tm.tm_mon + 1);
-                    tmp[ sizeof(tmp) - 1 ] = '\0';
+                    /* Grow the literal we're in */
 
-                    for ( a = 0; a < strlen(tmp); a++ )
+                    part->len++;
+
+                }
+            else
+                {
+
+                    if ( es->index_part_count == ELASTICSEARCH_INDEX_PARTS )
                         {
-                            index[pos] = tmp[a];
-                            pos++;
+                            Meer_Log(ERROR, "[%s, line %d] The 'elasticsearch' 'index' template is too complex. Abort!", __FILE__, __LINE__);
                         }
 
-                    i = i+6;
+                    part = &es->index_parts[es->index_part_count++];
+
+                    part->type = type;
+                    part->literal = &template[i];
+                    part->len = ( type == ELASTICSEARCH_INDEX_LITERAL ? 1 : 0 );
+
+                    if ( type == ELASTICSEARCH_INDEX_YEAR || type == ELASTICSEARCH_INDEX_MONTH || type == ELASTICSEARCH_INDEX_DAY )
+                        {
+                            es->index_dated = true;
+                        }
 
                 }
 
-            /* $DAY */
+            i += len;
 
-            if ( MeerOutput->elasticsearch_index[i] == '$' &&
-                    MeerOutput->elasticsearch_index[i+1] == 'D' &&
-                    MeerOutput->elasticsearch_index[i+2] == 'A' &&
-                    MeerOutput->elasticsearch_index[i+3] == 'Y' )
-                {
+        }
+
+}
 
-                    snprintf(tmp, sizeof(tmp), "%02d", tm.tm_mday);
-                    tmp[ sizeof(tmp) - 1 ] = '\0';
+/****************************************************************************
+ * Elasticsearch_Index_Day - The day (YYYYMMDD) events are indexed under.
+ * With "index_date: event" this comes from the event's own "timestamp",  so
+ * back filled data lands in the right daily index.  Otherwise it is today,
+ * and localtime() is only called when the day changes.  Only the output's
+ * own worker calls this.
+ ****************************************************************************/
 
-                    for ( a = 0; a < strlen(tmp); a++ )
-                        {
-                            index[pos] = tmp[a];
-                            pos++;
-                        }
+static uint32_t Elasticsearch_Index_Day( struct _Elasticsearch_Output *es, const char *json_string )
+{
+
+    const char *ts = NULL;
+    struct tm tm;
+    time_t t = 0;
+
+    if ( es->index_dated == false )
+        {
+            return(0);
+        }
+
+    /* "timestamp":"2024-01-15T10:22:33.123456+0000".  json-c may put a
+       space after the colon. */
+
+    if ( es->index_event_date == true &&
+            ( ts = strstr(json_string, "\"timestamp\":") ) != NULL )
+        {
+
+            ts += 12;
 
-                    i = i+4;
+            while ( *ts == ' ' )
+                {
+                    ts++;
+                }
 
+            if ( ts[0] == '"' && isdigit(ts[1]) && isdigit(ts[2]) && isdigit(ts[3]) && isdigit(ts[4]) && ts[5] == '-' &&
+                    isdigit(ts[6]) && isdigit(ts[7]) && ts[8] == '-' && isdigit(ts[9]) && isdigit(ts[10]) )
+                {
+                    ts++;
+                    return( ( ts[0] - '0' ) * 10000000 + ( ts[1] - '0' ) * 1000000 + ( ts[2] - '0' ) * 100000 + ( ts[3] - '0' ) * 10000 +
+                            ( ts[5] - '0' ) * 1000 + ( ts[6] - '0' ) * 100 + ( ts[8] - '0' ) * 10 + ( ts[9] - '0' ) );
                 }
 
+        }
+
+    t = time(NULL);
+
+    if ( t < es->index_day_start || t >= es->index_day_end )
+        {
+
+            localtime_r(&t, &tm);
 
-            index[pos]  = MeerOutput->elasticsearch_index[i];
-            pos++;
+            es->index_today = ( tm.tm_year + 1900 ) * 10000 + ( tm.tm_mon + 1 ) * 100 + tm.tm_mday;
+
+            tm.tm_hour = 0;
+            tm.tm_min = 0;
+            tm.tm_sec = 0;
+            tm.tm_isdst = -1;
+
+            es->index_day_start = mktime(&tm);
+
+            tm.tm_mday++;
+            tm.tm_isdst = -1;
+
+            es->index_day_end = mktime(&tm);
 
         }
 
-    snprintf(str, size, "%s", index);
-    str[ size - 1 ] = '\0';
+    return(es->index_today);
 
 }
 
-/*************************************/
-/* Elasticsearch threaded operation! */
-/*************************************/
+/****************************************************************************
+ * Elasticsearch_Index_Lookup - The index name and bulk action line for an
+ * event,  rendered from the compiled template and cached by (event_type,
+ * day).  Output worker only.
+ ****************************************************************************/
 
-void Elasticsearch( void )
+struct _Elasticsearch_Index *Elasticsearch_Index_Lookup( struct _Elasticsearch_Output *es, const char *event_type, const char *json_string )
 {
 
-    char *big_batch_LOCAL = malloc( (MeerConfig->payload_buffer_size)*sizeof(char));
+    struct _Elasticsearch_Index *entry = NULL;
+    struct _Elasticsearch_Index_Part *part = NULL;
+
+    uint32_t day = Elasticsearch_Index_Day( es, json_string );
+    uint32_t hash = 2166136261U;
+    uint8_t i = 0;
+    size_t pos = 0;
+    char tmp[8] = { 0 };
 
-    if ( big_batch_LOCAL == NULL )
+    const char *text = NULL;
+    size_t len = 0;
+
+    for ( text = event_type; *text != '\0'; text++ )
         {
-            fprintf(stderr, "[%s, line %d] Fatal Error:  Can't allocate memory! Abort!\n", __FILE__, __LINE__);
-            exit(-1);
+            hash = ( hash ^ (uint8_t)*text ) * 16777619U;
         }
 
-    struct MemoryStruct chunk;    /* Large JSON returns from Elastic */
+    hash = ( hash ^ day ) * 16777619U;
 
-    CURL *curl_LOCAL;
-    CURLcode res;
+    entry = &es->index_cache[ hash % ELASTICSEARCH_INDEX_CACHE ];
 
-    struct curl_slist *headers = NULL;
-    curl_global_init(CURL_GLOBAL_ALL);
+    if ( entry->generation != 0 && entry->day == day && !strcmp(entry->event_type, event_type) )
+        {
+            return(entry);
+        }
+
+    /* Render it */
+
+    strlcpy(entry->event_type, event_type, sizeof(entry->event_type));
+    entry->day = day;
+    entry->generation = ++es->index_generation;
+
+    for ( i = 0; i < es->index_part_count; i++ )
+        {
+
+            part = &es->index_parts[i];
+
+            switch ( part->type )
+                {
+
+                case ELASTICSEARCH_INDEX_EVENTTYPE:
+                    text = event_type;
+                    len = strlen(event_type);
+                    break;
+
+                case ELASTICSEARCH_INDEX_YEAR:
+                    snprintf(tmp, sizeof(tmp), "%04u", day / 10000);
+                    text = tmp;
+                    len = strlen(tmp);
+                    break;
+
+                case ELASTICSEARCH_INDEX_MONTH:
+                    snprintf(tmp, sizeof(tmp), "%02u", ( day / 100 ) % 100);
+                    text = tmp;
+                    len = strlen(tmp);
+                    break;
+
+                case ELASTICSEARCH_INDEX_DAY:
+                    snprintf(tmp, sizeof(tmp), "%02u", day % 100);
+                    text = tmp;
+                    len = strlen(tmp);
+                    break;
+
+                default:
+                    text = part->literal;
+                    len = part->len;
+                    break;
+                }
+
+            if ( pos + len >= sizeof(entry->name) )
+                {
+                    len = sizeof(entry->name) - pos - 1;
+                }
+
+            memcpy(entry->name + pos, text, len);
+            pos += len;
+
+        }
+
+    entry->name[pos] = '\0';
+
+    entry->action_len = snprintf(entry->action, sizeof(entry->action), "{\"index\":{\"_index\":\"%s\"}}\n", entry->name);
+
+    return(entry);
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Batch_Get - Take an empty batch off the free list,  or make
+ * a new one.  Buffers start small and grow as needed.
+ ****************************************************************************/
+
+static struct _Elasticsearch_Batch *Elasticsearch_Batch_Get( struct _Elasticsearch_Output *es )
+{
+
+    struct _Elasticsearch_Batch *batch = NULL;
 
-    curl_LOCAL = curl_easy_init();
+    pthread_mutex_lock(&es->mutex);
 
-    if ( curl_LOCAL )
+    if ( es->free_batches != NULL )
+        {
+            batch = es->free_batches;
+            es->free_batches = batch->next;
+        }
+
+    pthread_mutex_unlock(&es->mutex);
+
+    if ( batch == NULL )
         {
 
-            curl_LOCAL = curl_easy_init();
+            batch = calloc( 1, sizeof(struct _Elasticsearch_Batch) );
 
-            if ( MeerOutput->elasticsearch_insecure == true )
+            if ( batch == NULL )
                 {
+                    Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for Elasticsearch batch. Abort!", __FILE__, __LINE__);
+                }
+
+            batch->size = ELASTICSEARCH_BATCH_START;
+            batch->data = malloc( batch->size );
 
-                    curl_easy_setopt(curl_LOCAL, CURLOPT_SSL_VERIFYPEER, false);
-                    curl_easy_setopt(curl_LOCAL, CURLOPT_SSL_VERIFYHOST, false);
-                    curl_easy_setopt(curl_LOCAL, CURLOPT_SSL_VERIFYSTATUS, false);
+            batch->segment_size = es->batch * 2;
+            batch->segments = malloc( batch->segment_size * sizeof(struct _Elasticsearch_Segment) );
 
+            if ( batch->data == NULL || batch->segments == NULL )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for Elasticsearch batch. Abort!", __FILE__, __LINE__);
                 }
+        }
+
+    batch->len = 0;
+    batch->body_len = 0;
+    batch->segment_count = 0;
+    memset(batch->action_generation, 0, sizeof(batch->action_generation));
+    batch->count = 0;
+    batch->attempts = 0;
+    batch->failures = 0;
+    batch->retry_at = 0;
+    batch->first_at = 0;
+    batch->next = NULL;
+
+    return(batch);
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Batch_Reserve - Make room for "len" more bytes of data and
+ * one more segment.
+ ****************************************************************************/
+
+static void Elasticsearch_Batch_Reserve( struct _Elasticsearch_Batch *batch, size_t len )
+{
+
+    if ( batch->len + len > batch->size )
+        {
 
-            if ( MeerOutput->elasticsearch_username[0] != '\0' && MeerOutput->elasticsearch_password[0] != '\0' )
+            while ( batch->len + len > batch->size )
                 {
+                    batch->size *= 2;
+                }
 
-                    curl_easy_setopt(curl_LOCAL, CURLOPT_USERNAME, MeerOutput->elasticsearch_username);
-                    curl_easy_setopt(curl_LOCAL, CURLOPT_PASSWORD, MeerOutput->elasticsearch_password);
+            batch->data = realloc( batch->data, batch->size );
 
+            if ( batch->data == NULL )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Failed to reallocate memory for Elasticsearch batch. Abort!", __FILE__, __LINE__);
                 }
+        }
 
-            /* Put libcurl in "debug" it we're in "debug" mode! */
+    if ( batch->segment_count == batch->segment_size )
+        {
+
+            batch->segment_size *= 2;
+            batch->segments = realloc( batch->segments, batch->segment_size * sizeof(struct _Elasticsearch_Segment) );
 
-            if ( MeerOutput->elasticsearch_debug == true )
+            if ( batch->segments == NULL )
                 {
-                    curl_easy_setopt(curl_LOCAL, CURLOPT_VERBOSE, 1);
+                    Meer_Log(ERROR, "[%s, line %d] Failed to reallocate memory for Elasticsearch batch. Abort!", __FILE__, __LINE__);
                 }
+        }
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Batch_Segment - Add "len" bytes at "offset" in the batch
+ * data to the bulk body.
+ ****************************************************************************/
+
+static void Elasticsearch_Batch_Segment( struct _Elasticsearch_Batch *batch, size_t offset, size_t len )
+{
 
-            curl_easy_setopt(curl_LOCAL, CURLOPT_NOSIGNAL, 1);    /* Will send SIGALRM if not set */
+    batch->segments[batch->segment_count].offset = offset;
+    batch->segments[batch->segment_count].len = len;
+    batch->segment_count++;
 
-            headers = curl_slist_append(headers, "Content-Type: application/x-ndjson");
-            headers = curl_slist_append (headers, MEER_USER_AGENT);
+    batch->body_len += len;
 
-            curl_easy_setopt(curl_LOCAL, CURLOPT_HTTPHEADER, headers);
+}
+
+/****************************************************************************
+ * Elasticsearch_Batch_Submit - Queue the current batch for the workers and
+ * start a new one.  Waits when the queue is full.
+ ****************************************************************************/
+
+static void Elasticsearch_Batch_Submit( struct _Elasticsearch_Output *es )
+{
 
-            curl_easy_setopt(curl_LOCAL, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
-            curl_easy_setopt(curl_LOCAL, CURLOPT_WRITEDATA, (void *)&chunk);
+    struct _Elasticsearch_Batch *batch = es->current;
 
-            curl_easy_setopt(curl_LOCAL, CURLOPT_URL, MeerOutput->elasticsearch_url);
+    pthread_mutex_lock(&es->mutex);
 
+    /* Batches waiting to retry count too,  so an outage backs up into the
+       output's own queue rather than growing the retry list */
 
+    while ( es->queued_count + es->retry_count >= es->queue )
+        {
+            pthread_cond_wait(&es->space, &es->mutex);
         }
-    else
+
+    es->queued[ ( es->queued_head + es->queued_count ) % es->queue ] = batch;
+    es->queued_count++;
+
+    __atomic_add_fetch(&elastic_proc_running, 1, __ATOMIC_SEQ_CST);
+
+    pthread_cond_signal(&es->work);
+    pthread_mutex_unlock(&es->mutex);
+
+    es->current = Elasticsearch_Batch_Get( es );
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Flush - Queue the partial batch now.  Called when the output
+ * worker exits,  so its last events aren't left behind.
+ ****************************************************************************/
+
+void Elasticsearch_Flush( struct _Elasticsearch_Output *es )
+{
+
+    pthread_mutex_lock(&es->batch_mutex);
+
+    if ( es->current->count != 0 )
         {
+            Elasticsearch_Batch_Submit( es );
+        }
 
-            Meer_Log(ERROR, "[%s, line %d] Failed to initialize libcurl.", __FILE__, __LINE__ );
+    pthread_mutex_unlock(&es->batch_mutex);
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Backed_Up - Is the cluster failing (batches are waiting to
+ * be retried) and the queue full,  so the next full batch would wait in
+ * Elasticsearch_Batch_Submit()?
+ ****************************************************************************/
+
+bool Elasticsearch_Backed_Up( struct _Elasticsearch_Output *es )
+{
+
+    bool backed_up = false;
+
+    pthread_mutex_lock(&es->mutex);
+    backed_up = ( es->retry_count != 0 && es->queued_count + es->retry_count >= es->queue );
+    pthread_mutex_unlock(&es->mutex);
+
+    return(backed_up);
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Batch_Add - Add one event to the current batch and queue the
+ * batch once it is full.  Output worker only.
+ *
+ * The bulk body is a list of segments.  Events with no "_id" that go to the
+ * same index share one copy of the action line,  and the event is copied
+ * once,  straight from "json_string".  Elasticsearch_Read_Callback() walks
+ * the segments when the batch is posted.
+ ****************************************************************************/
+
+void Elasticsearch_Batch_Add( struct _Elasticsearch_Output *es, struct _Elasticsearch_Index *index, const char *id, const char *json_string )
+{
+
+    struct _Elasticsearch_Batch *batch = NULL;
+
+    size_t len = 0;
+    size_t slot = 0;
+    int ret = 0;
+
+    pthread_mutex_lock(&es->batch_mutex);
+
+    batch = es->current;
+
+    /* Keep the body under "max_body".  An event larger than the budget
+       still goes out,  alone. */
 
+    len = index->action_len + ( id != NULL ? strlen(id) : 0 ) + 10 + strlen(json_string);
+
+    if ( batch->count > 0 && batch->body_len + len > es->max_body )
+        {
+            Elasticsearch_Batch_Submit( es );
+            batch = es->current;
         }
 
+    slot = index - es->index_cache;
 
-    while ( elasticsearch_death == false )
+    if ( id != NULL )
         {
 
-            pthread_mutex_lock(&MeerElasticMutex);
+            /* The cached action line,  less its closing }}\n,  with
+               ,"_id":"..."}}\n spliced on */
 
-            while ( elastic_proc_msgslot == 0 ) pthread_cond_wait(&MeerElasticWork, &MeerElasticMutex);
+            ret = strlen(id);
+            len = index->action_len + ret + 9;
 
-            /* Copy the latest batch! */
+            Elasticsearch_Batch_Reserve( batch, len );
 
-            elastic_proc_msgslot--;
-            strlcpy(big_batch_LOCAL, big_batch_THREAD, ( MeerConfig->payload_buffer_size * MeerOutput->elasticsearch_batch ) );
+            memcpy( batch->data + batch->len, index->action, index->action_len - 3 );
+            memcpy( batch->data + batch->len + index->action_len - 3, ",\"_id\":\"", 8 );
+            memcpy( batch->data + batch->len + index->action_len + 5, id, ret );
+            memcpy( batch->data + batch->len + index->action_len + 5 + ret, "\"}}\n", 4 );
 
-            pthread_mutex_unlock(&MeerElasticMutex);
+            Elasticsearch_Batch_Segment( batch, batch->len, len );
+            batch->len += len;
 
-            struct json_object *json_obj = NULL;
-            struct json_object *json_tmp = NULL;
+        }
 
-            chunk.memory = malloc(1);   /* will be grown as needed by the realloc above */
-            chunk.size = 0;             /* no data at this point */
+    else if ( batch->action_generation[slot] != index->generation )
+        {
 
-            curl_easy_setopt(curl_LOCAL, CURLOPT_POSTFIELDS, big_batch_LOCAL);
+            /* First event for this index in the batch.  Later ones share
+               this copy of the action line. */
 
-            res = curl_easy_perform(curl_LOCAL);
+            Elasticsearch_Batch_Reserve( batch, index->action_len );
 
-            while (res != CURLE_OK && res != CURLE_WRITE_ERROR )
-                {
+            memcpy( batch->data + batch->len, index->action, index->action_len );
 
-                    Meer_Log(WARN, "[%s, line %d] Couldn't connect to the Elasticsearch server [%s]. Sleeping for 5 seconds.....", __FILE__, __LINE__, curl_easy_strerror(res));
+            batch->action_generation[slot] = index->generation;
+            batch->action_offset[slot] = batch->len;
 
-                    sleep(5);
-                    res = curl_easy_perform(curl_LOCAL);
+            Elasticsearch_Batch_Segment( batch, batch->len, index->action_len );
+            batch->len += index->action_len;
 
-                }
+        }
 
-            /* If we got data back from Elasticsearch,  let's parse if for errors */
+    else
+        {
 
-            if ( chunk.memory != NULL )
-                {
+            Elasticsearch_Batch_Reserve( batch, 0 );
+            Elasticsearch_Batch_Segment( batch, batch->action_offset[slot], index->action_len );
 
-                    if ( MeerOutput->elasticsearch_debug == true )
-                        {
-                            Meer_Log(DEBUG, "[%s, line %d] Response from Elasticsearch: %s", __FILE__, __LINE__, chunk.memory);
-                        }
+        }
 
-                    json_obj = json_tokener_parse(chunk.memory);
+    /* The event and its newline */
 
-                    if (json_object_object_get_ex(json_obj, "errors", &json_tmp))
-                        {
+    len = strlen(json_string);
 
-                            if ( strcmp((char *)json_object_get_string(json_tmp), "false" ) )
-                                {
+    Elasticsearch_Batch_Reserve( batch, len + 1 );
 
-                                    Meer_Log(WARN, "[%s, line %d] Failure inserting into Elasticsearch! Result codes: %s", __FILE__, __LINE__, chunk.memory);
+    memcpy( batch->data + batch->len, json_string, len );
+    batch->data[batch->len + len] = '\n';
 
-                                }
+    Elasticsearch_Batch_Segment( batch, batch->len, len + 1 );
+    batch->len += len + 1;
 
-                        }
+    if ( batch->count == 0 )
+        {
+            batch->first_at = Current_Epoch_Ms();
+        }
 
-                }
-            else
+    batch->count++;
+
+    /* Send once either the event count or the byte budget is reached */
+
+    if ( batch->count >= es->batch ||
+            batch->body_len >= es->max_body )
+        {
+            Elasticsearch_Batch_Submit( es );
+        }
+
+    pthread_mutex_unlock(&es->batch_mutex);
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Flush_Thread - Send the current batch once its oldest event
+ * has waited "flush_interval" ms,  so a quiet sensor's alerts don't sit
+ * until the batch fills.
+ ****************************************************************************/
+
+static void *Elasticsearch_Flush_Thread( void *arg )
+{
+
+    struct _Elasticsearch_Output *es = (struct _Elasticsearch_Output *)arg;
+
+    uint64_t now = 0;
+    uint64_t due = 0;
+
+    while ( elasticsearch_death == false )
+        {
+
+            pthread_mutex_lock(&es->batch_mutex);
+
+            now = Current_Epoch_Ms();
+            due = now + es->flush_interval;
+
+            if ( es->current->count != 0 )
                 {
 
-                    Meer_Log(WARN, "[%s, line %d] Got NULL back from Elasticsearch.  Failed to insert batch.", __FILE__, __LINE__, chunk.memory);
+                    due = es->current->first_at + es->flush_interval;
+
+                    if ( due <= now )
+                        {
+                            Elasticsearch_Batch_Submit( es );
+                            due = now + es->flush_interval;
+                        }
 
                 }
 
+            pthread_mutex_unlock(&es->batch_mutex);
 
-            json_object_put(json_obj);
-            free(chunk.memory);
+            /* Check for a shutdown at least once a second */
+
+            if ( due - now > 1000 )
+                {
+                    due = now + 1000;
+                }
 
-            __atomic_sub_fetch(&elastic_proc_running, 1, __ATOMIC_SEQ_CST);
+            usleep( ( due - now ) * 1000 );
 
         }
 
-    /* Clean up thread! */
-
-    curl_easy_cleanup(curl_LOCAL);
-    free(big_batch_LOCAL);
     pthread_exit(NULL);
 
 }
 
-#endif
+/****************************************************************************
+ * Elasticsearch_Batch_Release - A batch is finished with.  Hand the buffer
+ * back for reuse.
+ ****************************************************************************/
 
+static void Elasticsearch_Batch_Release( struct _Elasticsearch_Output *es, struct _Elasticsearch_Batch *batch )
+{
+
+    pthread_mutex_lock(&es->mutex);
+    batch->next = es->free_batches;
+    es->free_batches = batch;
+    pthread_mutex_unlock(&es->mutex);
+
+    __atomic_sub_fetch(&elastic_proc_running, 1, __ATOMIC_SEQ_CST);
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Dead_Letter - Event "i" of a batch can't be indexed.  The
+ * EVE line goes to the "dead_letter" file so it can be fed back through
+ * Meer later.
+ ****************************************************************************/
+
+static void Elasticsearch_Dead_Letter( struct _Elasticsearch_Output *es, struct _Elasticsearch_Batch *batch, uint16_t i )
+{
+
+    struct _Elasticsearch_Segment *segment = &batch->segments[ i * 2 + 1 ];
+
+    if ( es->dead_letter_fd == NULL )
+        {
+            __atomic_add_fetch(&MeerCounters->ElasticsearchDropCount, 1, __ATOMIC_SEQ_CST);
+            return;
+        }
+
+    fwrite( batch->data + segment->offset, 1, segment->len, es->dead_letter_fd );
+
+    __atomic_add_fetch(&MeerCounters->ElasticsearchDeadLetterCount, 1, __ATOMIC_SEQ_CST);
+
+}
 
+/****************************************************************************
+ * Elasticsearch_Batch_Fail - Every event in the batch failed for good.
+ ****************************************************************************/
 
+static void Elasticsearch_Batch_Fail( struct _Elasticsearch_Output *es, struct _Elasticsearch_Batch *batch )
+{
+
+    uint16_t i = 0;
+
+    for ( i = 0; i < batch->count; i++ )
+        {
+            Elasticsearch_Dead_Letter( es, batch, i );
+        }
+
+    if ( es->dead_letter_fd != NULL )
+        {
+            fflush( es->dead_letter_fd );
+        }
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Batch_Spill - Meer is stopping and the batch wasn't
+ * delivered.  Put its events back in the output's spill,  with the "_id"
+ * they were sent with,  so they are indexed on the next start.  Returns
+ * false if the output has no spill.  An event with no "event_type" to
+ * route it by goes to the dead letter file instead.
+ ****************************************************************************/
+
+static bool Elasticsearch_Batch_Spill( struct _Elasticsearch_Output *es, struct _Elasticsearch_Batch *batch )
+{
+
+    struct _Elasticsearch_Segment *action = NULL;
+    struct _Elasticsearch_Segment *source = NULL;
+    struct _Output_Event *event = NULL;
+
+    struct json_object *json_obj = NULL;
+    struct json_object *json_event_type = NULL;
+
+    char *action_line = NULL;
+    char *json_string = NULL;
+    char *id = NULL;
+    char *end = NULL;
+
+    uint16_t i = 0;
+
+    if ( es->worker.spill[0] == '\0' )
+        {
+            return(false);
+        }
+
+    for ( i = 0; i < batch->count; i++ )
+        {
+
+            action = &batch->segments[ i * 2 ];
+            source = &batch->segments[ i * 2 + 1 ];
+
+            action_line = strndup( batch->data + action->offset, action->len );
+            json_string = strndup( batch->data + source->offset, source->len - 1 );	/* Less its newline */
+
+            if ( action_line == NULL || json_string == NULL )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for an Elasticsearch event. Abort!", __FILE__, __LINE__);
+                }
+
+            id = NULL;
+
+            if ( ( id = strstr( action_line, "\"_id\":\"" ) ) != NULL )
+                {
+
+                    id += 7;
+
+                    if ( ( end = strchr( id, '"' ) ) != NULL )
+                        {
+                            *end = '\0';
+                        }
+                }
+
+            json_obj = json_tokener_parse( json_string );
+
+            if ( json_obj != NULL && json_object_object_get_ex(json_obj, "event_type", &json_event_type) )
+                {
+
+                    event = Output_Event_New( json_string, json_object_get_string(json_event_type), NULL, id, NULL );
+
+                    Output_Queue_Spill( es->output_queue, event );
+                    Output_Event_Release( event );
+
+                }
+            else
+                {
+                    Elasticsearch_Dead_Letter( es, batch, i );
+                }
+
+            json_object_put(json_obj);
+
+            free(action_line);
+            free(json_string);
+
+        }
+
+    if ( es->dead_letter_fd != NULL )
+        {
+            fflush( es->dead_letter_fd );
+        }
+
+    return(true);
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Batch_Retry - Put a batch on the retry list.  The wait
+ * doubles with each failure up to ELASTICSEARCH_RETRY_MAX_MS,  and half of
+ * it is random so workers don't retry in lock step.  Only errors from the
+ * cluster ("answered") use up "retries".  A cluster that can't be reached
+ * loses nothing,  it just backs up.  Once "retries" is used up the events
+ * are failed instead.  When Meer is shutting down they go to the output's
+ * spill,  or are failed if it has none.
+ ****************************************************************************/
+
+static void Elasticsearch_Batch_Retry( struct _Elasticsearch_Output *es, struct _Elasticsearch_Batch *batch, unsigned int *seed, bool answered )
+{
+
+    uint64_t delay = ELASTICSEARCH_RETRY_BASE_MS;
+    uint16_t i = 0;
+
+    batch->failures++;
+
+    if ( answered == true )
+        {
+            batch->attempts++;
+        }
+
+    if ( elasticsearch_death == true && ( es->retries == 0 || batch->attempts <= es->retries ) &&
+            Elasticsearch_Batch_Spill( es, batch ) == true )
+        {
+
+            Meer_Log(NORMAL, "Shutting down.  %d undelivered Elasticsearch events for '%s' were spilled.", batch->count, es->name);
+
+            Elasticsearch_Batch_Release( es, batch );
+            return;
+
+        }
+
+    if ( elasticsearch_death == true ||
+            ( es->retries != 0 && batch->attempts > es->retries ) )
+        {
+
+            Meer_Log(WARN, "[%s, line %d] Giving up on %d Elasticsearch events after %d attempts.", __FILE__, __LINE__, batch->count, batch->attempts);
+
+            Elasticsearch_Batch_Fail( es, batch );
+            Elasticsearch_Batch_Release( es, batch );
+            return;
+
+        }
+
+    for ( i = 1; i < batch->failures && delay < ELASTICSEARCH_RETRY_MAX_MS; i++ )
+        {
+            delay *= 2;
+        }
+
+    if ( delay > ELASTICSEARCH_RETRY_MAX_MS )
+        {
+            delay = ELASTICSEARCH_RETRY_MAX_MS;
+        }
+
+    delay = delay / 2 + rand_r(seed) % ( delay / 2 + 1 );
+
+    batch->retry_at = Current_Epoch_Ms() + delay;
+
+    pthread_mutex_lock(&es->mutex);
+
+    batch->next = es->retry_batches;
+    es->retry_batches = batch;
+    es->retry_count++;
+
+    pthread_cond_signal(&es->work);
+    pthread_mutex_unlock(&es->mutex);
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Retry_Next - Take the retry that has been due the longest.
+ * If none are due,  "next" is set to when the soonest one will be (0 if the
+ * list is empty).  es->mutex must be held.
+ ****************************************************************************/
+
+static struct _Elasticsearch_Batch *Elasticsearch_Retry_Next( struct _Elasticsearch_Output *es, uint64_t *next )
+{
+
+    struct _Elasticsearch_Batch **walk = NULL;
+    struct _Elasticsearch_Batch **best = NULL;
+    struct _Elasticsearch_Batch *batch = NULL;
+
+    uint64_t now = Current_Epoch_Ms();
+
+    *next = 0;
+
+    for ( walk = &es->retry_batches; *walk != NULL; walk = &(*walk)->next )
+        {
+
+            if ( best == NULL || (*walk)->retry_at < (*best)->retry_at )
+                {
+                    best = walk;
+                }
+
+        }
+
+    if ( best == NULL )
+        {
+            return(NULL);
+        }
+
+    /* On shutdown,  everything gets one last try */
+
+    if ( (*best)->retry_at > now && elasticsearch_death == false )
+        {
+            *next = (*best)->retry_at;
+            return(NULL);
+        }
+
+    batch = *best;
+    *best = batch->next;
+    batch->next = NULL;
+
+    es->retry_count--;
+    pthread_cond_signal(&es->space);
+
+    return(batch);
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Batch_Copy - Copy event "i" (action line and source) of
+ * "src" onto the end of "dst".
+ ****************************************************************************/
+
+static void Elasticsearch_Batch_Copy( struct _Elasticsearch_Batch *dst, struct _Elasticsearch_Batch *src, uint16_t i )
+{
+
+    uint8_t j = 0;
+    struct _Elasticsearch_Segment *segment = NULL;
+
+    for ( j = 0; j < 2; j++ )
+        {
+
+            segment = &src->segments[ i * 2 + j ];
+
+            Elasticsearch_Batch_Reserve( dst, segment->len );
+
+            memcpy( dst->data + dst->len, src->data + segment->offset, segment->len );
+
+            Elasticsearch_Batch_Segment( dst, dst->len, segment->len );
+            dst->len += segment->len;
+
+        }
+
+    dst->count++;
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Bulk_Response - Go through the bulk "items",  which are in
+ * the same order as the events in the batch.  Events rejected with 429 or a
+ * 5xx are retried in a new,  smaller batch.  Any other error is permanent
+ * (mapping errors and the like) and goes to the dead letter file.
+ ****************************************************************************/
+
+static void Elasticsearch_Bulk_Response( struct _Elasticsearch_Output *es, struct _Elasticsearch_Batch *batch, const char *response, unsigned int *seed )
+{
+
+    struct json_object *json_obj = NULL;
+    struct json_object *json_errors = NULL;
+    struct json_object *json_items = NULL;
+    struct json_object *json_op = NULL;
+    struct json_object *json_status = NULL;
+    struct json_object *json_error = NULL;
+
+    struct _Elasticsearch_Batch *retry = NULL;
+
+    uint16_t i = 0;
+    uint16_t items = 0;
+    uint16_t failed = 0;
+    int status = 0;
+
+    if ( response != NULL )
+        {
+            json_obj = json_tokener_parse(response);
+        }
+
+    if ( json_obj == NULL || !json_object_object_get_ex(json_obj, "errors", &json_errors) )
+        {
+
+            Meer_Log(WARN, "[%s, line %d] Can't understand the Elasticsearch response.  Will retry.", __FILE__, __LINE__);
+
+            json_object_put(json_obj);
+
+            __atomic_add_fetch(&MeerCounters->ElasticsearchRetryCount, batch->count, __ATOMIC_SEQ_CST);
+            Elasticsearch_Batch_Retry( es, batch, seed, true );
+            return;
+
+        }
+
+    if ( json_object_get_boolean(json_errors) == false )
+        {
+
+            __atomic_add_fetch(&MeerCounters->ElasticsearchIndexedCount, batch->count, __ATOMIC_SEQ_CST);
+
+            json_object_put(json_obj);
+            Elasticsearch_Batch_Release( es, batch );
+            return;
+
+        }
+
+    if ( json_object_object_get_ex(json_obj, "items", &json_items) &&
+            json_object_get_type(json_items) == json_type_array )
+        {
+            items = json_object_array_length(json_items);
+        }
+
+    for ( i = 0; i < batch->count; i++ )
+        {
+
+            status = 0;
+            json_error = NULL;
+
+            /* Each item is { "index": { "status": ..., "error": ... } } */
+
+            if ( i < items &&
+                    json_object_object_get_ex(json_object_array_get_idx(json_items, i), "index", &json_op) )
+                {
+
+                    if ( json_object_object_get_ex(json_op, "status", &json_status) )
+                        {
+                            status = json_object_get_int(json_status);
+                        }
+
+                    json_object_object_get_ex(json_op, "error", &json_error);
+
+                }
+
+            if ( status >= 200 && status < 300 )
+                {
+                    __atomic_add_fetch(&MeerCounters->ElasticsearchIndexedCount, 1, __ATOMIC_SEQ_CST);
+                }
+
+            /* No status means the item is missing.  Try it again. */
+
+            else if ( status == 0 || status == 429 || status >= 500 )
+                {
+
+                    if ( retry == NULL )
+                        {
+                            retry = Elasticsearch_Batch_Get( es );
+                            retry->attempts = batch->attempts;
+                            retry->failures = batch->failures;
+                        }
+
+                    Elasticsearch_Batch_Copy( retry, batch, i );
+
+                    __atomic_add_fetch(&MeerCounters->ElasticsearchRetryCount, 1, __ATOMIC_SEQ_CST);
+
+                }
+
+            else
+                {
+
+                    /* Log the first one so the reason can be seen */
+
+                    if ( failed == 0 )
+                        {
+                            Meer_Log(WARN, "[%s, line %d] Elasticsearch rejected an event (status %d): %s", __FILE__, __LINE__, status, json_error != NULL ? json_object_to_json_string(json_error) : "unknown");
+                        }
+
+                    Elasticsearch_Dead_Letter( es, batch, i );
+                    failed++;
+
+                }
+
+        }
+
+    if ( failed != 0 )
+        {
+
+            Meer_Log(WARN, "[%s, line %d] %d of %d events in the batch were rejected by Elasticsearch.", __FILE__, __LINE__, failed, batch->count);
+
+            if ( es->dead_letter_fd != NULL )
+                {
+                    fflush( es->dead_letter_fd );
+                }
+
+        }
+
+    json_object_put(json_obj);
+
+    /* The retry takes the original's place */
+
+    if ( retry != NULL )
+        {
+            __atomic_add_fetch(&elastic_proc_running, 1, __ATOMIC_SEQ_CST);
+            Elasticsearch_Batch_Retry( es, retry, seed, true );
+        }
+
+    Elasticsearch_Batch_Release( es, batch );
+
+}
+
+#ifdef HAVE_LIBZ
+
+/****************************************************************************
+ * Elasticsearch_Gzip - Compress a batch's bulk body into "out",  feeding
+ * zlib one segment at a time.  Runs on the worker thread.
+ ****************************************************************************/
+
+static bool Elasticsearch_Gzip( z_stream *strm, struct _Elasticsearch_Batch *batch, struct MemoryStruct *out )
+{
+
+    uint32_t i = 0;
+    int ret = 0;
+    size_t bound = 0;
+
+    deflateReset( strm );
+
+    bound = deflateBound( strm, batch->body_len );
+
+    if ( bound > out->size )
+        {
+
+            out->memory = realloc( out->memory, bound );
+
+            if ( out->memory == NULL )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Failed to reallocate memory for gzip buffer. Abort!", __FILE__, __LINE__);
+                }
+
+            out->size = bound;
+        }
+
+    strm->next_out = (Bytef *)out->memory;
+    strm->avail_out = out->size;
+
+    for ( i = 0; i < batch->segment_count; i++ )
+        {
+
+            strm->next_in = (Bytef *)( batch->data + batch->segments[i].offset );
+            strm->avail_in = batch->segments[i].len;
+
+            if ( deflate( strm, Z_NO_FLUSH ) != Z_OK || strm->avail_in != 0 )
+                {
+                    return(false);
+                }
+
+        }
+
+    ret = deflate( strm, Z_FINISH );
+
+    if ( ret != Z_STREAM_END )
+        {
+            return(false);
+        }
+
+    return(true);
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Gzip_Init - Each sending thread has its own deflate stream.
+ ****************************************************************************/
+
+static void Elasticsearch_Gzip_Init( struct _Elasticsearch_Output *es, z_stream *strm )
+{
+
+    memset(strm, 0, sizeof(z_stream));
+
+    /* windowBits 15 + 16 writes a gzip header rather than zlib's */
+
+    if ( es->gzip == true &&
+            deflateInit2( strm, es->gzip_level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY ) != Z_OK )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to initialize zlib. Abort!", __FILE__, __LINE__);
+        }
+
+}
+
+#endif
+
+/****************************************************************************
+ * Elasticsearch_Node_Parse - Split the comma separated "url" list into
+ * nodes.
+ ****************************************************************************/
+
+static void Elasticsearch_Node_Parse( struct _Elasticsearch_Output *es )
+{
+
+    struct _Elasticsearch_Node *node = NULL;
+
+    char tmp[sizeof(es->url)] = { 0 };
+    char *ptr1 = NULL;
+    char *tok = NULL;
+    char *path = NULL;
+
+    strlcpy(tmp, es->url, sizeof(tmp));
+    Remove_Spaces(tmp);
+
+    ptr1 = strtok_r(tmp, ",", &tok);
+
+    while ( ptr1 != NULL )
+        {
+
+            if ( es->node_count >= ELASTICSEARCH_MAX_NODES )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Too many Elasticsearch 'url' entries.  The maximum is %d.  Abort!", __FILE__, __LINE__, ELASTICSEARCH_MAX_NODES);
+                }
+
+            node = &es->nodes[es->node_count];
+
+            strlcpy(node->url, ptr1, sizeof(node->url));
+
+            /* The probe goes to the root of the node (http://host:port/),
+               which answers a HEAD with 200 when it is up. */
+
+            strlcpy(node->probe_url, ptr1, sizeof(node->probe_url));
+
+            path = strstr(node->probe_url, "://");
+            path = strchr( path != NULL ? path + 3 : node->probe_url, '/' );
+
+            if ( path != NULL )
+                {
+                    path[1] = '\0';
+                }
+
+            es->node_count++;
+
+            ptr1 = strtok_r(NULL, ",", &tok);
+
+        }
+
+    if ( es->node_count == 0 )
+        {
+            Meer_Log(ERROR, "[%s, line %d] No Elasticsearch 'url' given.  Abort!", __FILE__, __LINE__);
+        }
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Node_Get - Pick a node for a request.  The healthy node with
+ * the fewest requests in flight wins,  ties going round robin.  If every
+ * node is ejected,  they are all tried rather than holding events back.
+ ****************************************************************************/
+
+static struct _Elasticsearch_Node *Elasticsearch_Node_Get( struct _Elasticsearch_Output *es )
+{
+
+    struct _Elasticsearch_Node *node = NULL;
+    struct _Elasticsearch_Node *best = NULL;
+    struct _Elasticsearch_Node *fallback = NULL;
+
+    uint8_t i = 0;
+    uint8_t n = 0;
+
+    pthread_mutex_lock(&es->node_mutex);
+
+    for ( i = 0; i < es->node_count; i++ )
+        {
+
+            n = ( es->node_next + i ) % es->node_count;
+            node = &es->nodes[n];
+
+            if ( fallback == NULL || node->outstanding < fallback->outstanding )
+                {
+                    fallback = node;
+                }
+
+            if ( node->ejected == false && ( best == NULL || node->outstanding < best->outstanding ) )
+                {
+                    best = node;
+                }
+
+        }
+
+    if ( best == NULL )
+        {
+            best = fallback;
+        }
+
+    best->outstanding++;
+    es->node_next = ( best - es->nodes + 1 ) % es->node_count;
+
+    pthread_mutex_unlock(&es->node_mutex);
+
+    return(best);
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Node_Done - A request to "node" finished.  A node that
+ * couldn't be reached or answered with a server error is ejected.
+ ****************************************************************************/
+
+static void Elasticsearch_Node_Done( struct _Elasticsearch_Output *es, struct _Elasticsearch_Node *node, bool failed )
+{
+
+    pthread_mutex_lock(&es->node_mutex);
+
+    node->outstanding--;
+
+    /* A lone node has nowhere else to send,  so isn't ejected */
+
+    if ( failed == true && node->ejected == false && es->node_count > 1 )
+        {
+
+            node->ejected = true;
+            node->probe_at = Current_Epoch_Ms() + ELASTICSEARCH_PROBE_MS;
+
+            Meer_Log(WARN, "Elasticsearch node %s ejected.  It will be probed every %d seconds.", node->url, ELASTICSEARCH_PROBE_MS / 1000);
+
+        }
+
+    pthread_mutex_unlock(&es->node_mutex);
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Node_Probe - Is an ejected node answering again?
+ ****************************************************************************/
+
+static bool Elasticsearch_Node_Probe( CURL *curl, struct _Elasticsearch_Node *node )
+{
+
+    CURLcode res;
+    long http_code = 0;
+
+    curl_easy_setopt(curl, CURLOPT_URL, node->probe_url);
+
+    res = curl_easy_perform(curl);
+
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+    return( res == CURLE_OK && http_code >= 200 && http_code < 300 );
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Probe_Thread - Check ejected nodes in the background and
+ * put them back in rotation once they answer.
+ ****************************************************************************/
+
+static void *Elasticsearch_Probe_Thread( void *arg )
+{
+
+    struct _Elasticsearch_Output *es = (struct _Elasticsearch_Output *)arg;
+    struct _Elasticsearch_Node *node = NULL;
+    CURL *curl = NULL;
+
+    uint64_t now = 0;
+    uint8_t i = 0;
+    bool due = false;
+    bool up = false;
+
+    curl = curl_easy_init();
+
+    if ( curl == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to initialize libcurl.", __FILE__, __LINE__ );
+        }
+
+    if ( es->insecure == true )
+        {
+
+            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, false);
+            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, false);
+            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYSTATUS, false);
+
+        }
+
+    if ( es->username[0] != '\0' && es->password[0] != '\0' )
+        {
+
+            curl_easy_setopt(curl, CURLOPT_USERNAME, es->username);
+            curl_easy_setopt(curl, CURLOPT_PASSWORD, es->password);
+
+        }
+
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1);
+    curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);		/* HEAD */
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, ELASTICSEARCH_PROBE_TIMEOUT);
+
+    while ( elasticsearch_death == false )
+        {
+
+            for ( i = 0; i < es->node_count; i++ )
+                {
+
+                    node = &es->nodes[i];
+                    now = Current_Epoch_Ms();
+
+                    /* The probe runs without the lock held */
+
+                    pthread_mutex_lock(&es->node_mutex);
+
+                    due = node->ejected == true && node->probe_at <= now;
+
+                    pthread_mutex_unlock(&es->node_mutex);
+
+                    if ( due == false )
+                        {
+                            continue;
+                        }
+
+                    up = Elasticsearch_Node_Probe( curl, node );
+
+                    pthread_mutex_lock(&es->node_mutex);
+
+                    if ( up == true )
+                        {
+                            node->ejected = false;
+                        }
+                    else
+                        {
+                            node->probe_at = Current_Epoch_Ms() + ELASTICSEARCH_PROBE_MS;
+                        }
+
+                    pthread_mutex_unlock(&es->node_mutex);
+
+                    if ( up == true )
+                        {
+                            Meer_Log(NORMAL, "Elasticsearch node %s is answering again.  Back in rotation.", node->url);
+                        }
+
+                }
+
+            sleep(1);
+
+        }
+
+    curl_easy_cleanup(curl);
+
+    pthread_exit(NULL);
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Output_Defaults - Settings for a new "elasticsearch" block
+ * before meer.yaml is applied.
+ ****************************************************************************/
+
+void Elasticsearch_Output_Defaults( struct _Elasticsearch_Output *es )
+{
+
+    memset(es, 0, sizeof(struct _Elasticsearch_Output));
+
+    es->batch = 10;
+    es->threads = 5;
+    es->max_body = ELASTICSEARCH_MAX_BODY_DEFAULT;
+    es->gzip_level = ELASTICSEARCH_GZIP_LEVEL_DEFAULT;
+    es->retries = ELASTICSEARCH_RETRIES_DEFAULT;
+    es->flush_interval = FLUSH_INTERVAL_DEFAULT;
+    es->concurrency = ELASTICSEARCH_CONCURRENCY_DEFAULT;
+
+    Output_Queue_Defaults( &es->worker );
+
+    pthread_cond_init(&es->work, NULL);
+    pthread_cond_init(&es->space, NULL);
+    pthread_mutex_init(&es->mutex, NULL);
+    pthread_mutex_init(&es->batch_mutex, NULL);
+    pthread_mutex_init(&es->node_mutex, NULL);
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Output_Init - Start one output's writers.
+ ****************************************************************************/
+
+static void Elasticsearch_Output_Init( struct _Elasticsearch_Output *es )
+{
+
+    uint8_t i=0;
+    int rc=0;
+
+    pthread_t elasticsearch_id[es->threads];
+    pthread_attr_t thread_elasticsearch_attr;
+    pthread_attr_init(&thread_elasticsearch_attr);
+    pthread_attr_setdetachstate(&thread_elasticsearch_attr,  PTHREAD_CREATE_DETACHED);
+
+    es->queued = calloc( es->queue, sizeof(struct _Elasticsearch_Batch *) );
+
+    if ( es->queued == NULL )
+        {
+            fprintf(stderr, "[%s, line %d] Fatal Error:  Can't allocate memory! Abort!\n", __FILE__, __LINE__);
+            exit(-1);
+        }
+
+    es->current = Elasticsearch_Batch_Get( es );
+
+    Elasticsearch_Index_Compile( es );
+    Elasticsearch_Node_Parse( es );
+
+    if ( es->dead_letter[0] != '\0' )
+        {
+
+            if (( es->dead_letter_fd = fopen(es->dead_letter, "a" )) == NULL )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Cannot open Elasticsearch dead letter file '%s' [%s]. Abort!", __FILE__, __LINE__, es->dead_letter, strerror(errno) );
+                }
+
+        }
+
+    Meer_Log(NORMAL, "");
+
+    if ( es->multi == true )
+        {
+
+            Meer_Log(NORMAL, "Spawning the '%s' multi thread.  Concurrent requests: %d.", es->name, es->concurrency);
+
+            rc = pthread_create ( &elasticsearch_id[0], &thread_elasticsearch_attr, (void *)Elasticsearch_Multi, es );
+
+            if ( rc != 0 )
+                {
+
+                    Remove_Lock_File();
+                    Meer_Log(ERROR, "Could not pthread_create() for I/O processors [error: %d]", rc);
+                }
+
+        }
+    else
+        {
+
+            Meer_Log(NORMAL, "Spawning %d '%s' threads.", es->threads, es->name);
+        }
+
+    for (i = 0; i < es->threads && es->multi == false; i++)
+        {
+
+            rc = pthread_create ( &elasticsearch_id[i], &thread_elasticsearch_attr, (void *)Elasticsearch, es );
+
+            if ( rc != 0 )
+                {
+
+                    Remove_Lock_File();
+                    Meer_Log(ERROR, "Could not pthread_create() for I/O processors [error: %d]", rc);
+                }
+        }
+
+    if ( es->flush_interval != 0 )
+        {
+
+            pthread_t elasticsearch_flush_id;
+
+            rc = pthread_create ( &elasticsearch_flush_id, &thread_elasticsearch_attr, Elasticsearch_Flush_Thread, es );
+
+            if ( rc != 0 )
+                {
+                    Remove_Lock_File();
+                    Meer_Log(ERROR, "Could not pthread_create() for the Elasticsearch flush timer [error: %d]", rc);
+                }
+
+        }
+
+    if ( es->node_count > 1 )
+        {
+
+            pthread_t elasticsearch_probe_id;
+
+            Meer_Log(NORMAL, "Balancing '%s' requests across %d nodes.", es->name, es->node_count);
+
+            rc = pthread_create ( &elasticsearch_probe_id, &thread_elasticsearch_attr, Elasticsearch_Probe_Thread, es );
+
+            if ( rc != 0 )
+                {
+                    Remove_Lock_File();
+                    Meer_Log(ERROR, "Could not pthread_create() for the Elasticsearch node probe [error: %d]", rc);
+                }
+
+        }
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Init - Start every enabled "elasticsearch" output.
+ ****************************************************************************/
+
+void Elasticsearch_Init( void )
+{
+
+    uint8_t i = 0;
+
+    /* Not thread safe,  so done once here rather than by each thread */
+
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    for ( i = 0; i < MeerOutput->elasticsearch_count; i++ )
+        {
+            Elasticsearch_Output_Init( MeerOutput->elasticsearch[i] );
+        }
+
+}
+
+/* One bulk request.  The threads engine has one per worker thread,  the
+   multi engine has "concurrency" of them on one thread.  Each has its own
+   response and compressed body buffers because they are in use until the
+   request completes. */
+
+struct _Elasticsearch_Transfer
+{
+    struct _Elasticsearch_Output *es;
+    CURL *curl;
+    struct _Elasticsearch_Batch *batch;		/* NULL == idle */
+    struct _Elasticsearch_Node *node;		/* Where "batch" was sent */
+    struct MemoryStruct chunk;			/* Large JSON returns from Elastic */
+#ifdef HAVE_LIBZ
+    struct MemoryStruct gzip;			/* Compressed bulk body */
+#endif
+};
+
+/****************************************************************************
+ * Elasticsearch_Headers - HTTP headers for every bulk request.  A list can
+ * be shared by all the handles on a thread.
+ ****************************************************************************/
+
+static struct curl_slist *Elasticsearch_Headers( struct _Elasticsearch_Output *es )
+{
+
+    struct curl_slist *headers = NULL;
+
+    headers = curl_slist_append(headers, "Content-Type: application/x-ndjson");
+    headers = curl_slist_append (headers, MEER_USER_AGENT);
+    headers = curl_slist_append(headers, "Expect:");
+
+    if ( es->gzip == true )
+        {
+            headers = curl_slist_append(headers, "Content-Encoding: gzip");
+        }
+
+    return(headers);
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Transfer_Init - Set up a libcurl handle for bulk requests.
+ * The handle is kept for the life of the thread,  so its connection is
+ * kept alive and reused.
+ ****************************************************************************/
+
+static void Elasticsearch_Transfer_Init( struct _Elasticsearch_Output *es, struct _Elasticsearch_Transfer *t, struct curl_slist *headers )
+{
+
+    memset(t, 0, sizeof(struct _Elasticsearch_Transfer));
+
+    t->es = es;
+
+    t->curl = curl_easy_init();
+
+    if ( t->curl == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to initialize libcurl.", __FILE__, __LINE__ );
+        }
+
+    if ( es->insecure == true )
+        {
+
+            curl_easy_setopt(t->curl, CURLOPT_SSL_VERIFYPEER, false);
+            curl_easy_setopt(t->curl, CURLOPT_SSL_VERIFYHOST, false);
+            curl_easy_setopt(t->curl, CURLOPT_SSL_VERIFYSTATUS, false);
+
+        }
+
+    if ( es->username[0] != '\0' && es->password[0] != '\0' )
+        {
+
+            curl_easy_setopt(t->curl, CURLOPT_USERNAME, es->username);
+            curl_easy_setopt(t->curl, CURLOPT_PASSWORD, es->password);
+
+        }
+
+    /* Put libcurl in "debug" it we're in "debug" mode! */
+
+    if ( es->debug == true )
+        {
+            curl_easy_setopt(t->curl, CURLOPT_VERBOSE, 1);
+        }
+
+    curl_easy_setopt(t->curl, CURLOPT_NOSIGNAL, 1);    /* Will send SIGALRM if not set */
+    curl_easy_setopt(t->curl, CURLOPT_TCP_KEEPALIVE, 1L);
+
+    /* HTTP/2 when the cluster offers it over TLS.  Requests from the multi
+       engine then share one connection rather than opening more. */
+
+    curl_easy_setopt(t->curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(t->curl, CURLOPT_PIPEWAIT, 1L);
+
+    curl_easy_setopt(t->curl, CURLOPT_HTTPHEADER, headers);
+
+    /* The bulk body is streamed from the batch segments */
+
+    curl_easy_setopt(t->curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(t->curl, CURLOPT_READFUNCTION, Elasticsearch_Read_Callback);
+    curl_easy_setopt(t->curl, CURLOPT_SEEKFUNCTION, Elasticsearch_Seek_Callback);
+
+    curl_easy_setopt(t->curl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
+    curl_easy_setopt(t->curl, CURLOPT_WRITEDATA, (void *)&t->chunk);
+
+    curl_easy_setopt(t->curl, CURLOPT_PRIVATE, (void *)t);
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Transfer_Start - Point a handle at a batch.
+ ****************************************************************************/
+
+#ifdef HAVE_LIBZ
+static void Elasticsearch_Transfer_Start( struct _Elasticsearch_Transfer *t, struct _Elasticsearch_Batch *batch, z_stream *strm )
+#else
+static void Elasticsearch_Transfer_Start( struct _Elasticsearch_Transfer *t, struct _Elasticsearch_Batch *batch )
+#endif
+{
+
+    struct _Elasticsearch_Output *es = t->es;
+
+    t->batch = batch;
+    t->node = Elasticsearch_Node_Get( es );
+
+    curl_easy_setopt(t->curl, CURLOPT_URL, t->node->url);
+
+    t->chunk.memory = malloc(1);   /* will be grown as needed by the realloc above */
+    t->chunk.size = 0;             /* no data at this point */
+    t->chunk.memory[0] = '\0';
+
+#ifdef HAVE_LIBZ
+
+    if ( es->gzip == true )
+        {
+
+            if ( Elasticsearch_Gzip( strm, batch, &t->gzip ) == false )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Failed to gzip Elasticsearch batch. Abort!", __FILE__, __LINE__);
+                }
+
+            curl_easy_setopt(t->curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)strm->total_out);
+            curl_easy_setopt(t->curl, CURLOPT_POSTFIELDS, t->gzip.memory);
+
+            __atomic_add_fetch(&MeerCounters->ElasticsearchWireBytes, strm->total_out, __ATOMIC_SEQ_CST);
+
+        }
+    else
+        {
+#endif
+
+            curl_easy_setopt(t->curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)batch->body_len);
+
+            __atomic_add_fetch(&MeerCounters->ElasticsearchWireBytes, batch->body_len, __ATOMIC_SEQ_CST);
+
+#ifdef HAVE_LIBZ
+        }
+#endif
+
+    __atomic_add_fetch(&MeerCounters->ElasticsearchRawBytes, batch->body_len, __ATOMIC_SEQ_CST);
+
+    curl_easy_setopt(t->curl, CURLOPT_READDATA, (void *)batch);
+    curl_easy_setopt(t->curl, CURLOPT_SEEKDATA, (void *)batch);
+
+    batch->read_segment = 0;
+    batch->read_offset = 0;
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Transfer_Done - A bulk request finished.  Decide what
+ * happens to its events.
+ ****************************************************************************/
+
+static void Elasticsearch_Transfer_Done( struct _Elasticsearch_Transfer *t, CURLcode res, unsigned int *seed )
+{
+
+    struct _Elasticsearch_Output *es = t->es;
+    struct _Elasticsearch_Batch *batch = t->batch;
+    struct _Elasticsearch_Node *node = t->node;
+    long http_code = 0;
+
+    curl_easy_getinfo(t->curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+    if ( es->debug == true && t->chunk.memory != NULL )
+        {
+            Meer_Log(DEBUG, "[%s, line %d] Response from Elasticsearch: %s", __FILE__, __LINE__, t->chunk.memory);
+        }
+
+    /* A 429 is the cluster pushing back,  not a sick node */
+
+    Elasticsearch_Node_Done( es, node, res != CURLE_OK || http_code >= 500 );
+
+    /* Can't connect,  overloaded (429) or a server side error.  The whole
+       batch goes back for another try. */
+
+    if ( res != CURLE_OK || http_code == 429 || http_code >= 500 )
+        {
+
+            if ( res != CURLE_OK )
+                {
+                    Meer_Log(WARN, "[%s, line %d] Couldn't connect to the Elasticsearch server %s [%s]. Will retry.", __FILE__, __LINE__, node->url, curl_easy_strerror(res));
+                }
+            else
+                {
+                    Meer_Log(WARN, "[%s, line %d] Elasticsearch returned HTTP %ld. Will retry.", __FILE__, __LINE__, http_code);
+                }
+
+            __atomic_add_fetch(&MeerCounters->ElasticsearchRetryCount, batch->count, __ATOMIC_SEQ_CST);
+            Elasticsearch_Batch_Retry( es, batch, seed, res == CURLE_OK );
+
+        }
+
+    /* Anything else that isn't a 2xx won't get better by sending it again
+       (bad request,  authentication,  body too large). */
+
+    else if ( http_code < 200 || http_code >= 300 )
+        {
+
+            Meer_Log(WARN, "[%s, line %d] Elasticsearch rejected the batch with HTTP %ld: %s", __FILE__, __LINE__, http_code, t->chunk.memory != NULL ? t->chunk.memory : "");
+
+            Elasticsearch_Batch_Fail( es, batch );
+            Elasticsearch_Batch_Release( es, batch );
+
+        }
+
+    else
+        {
+            Elasticsearch_Bulk_Response( es, batch, t->chunk.memory, seed );
+        }
+
+    free(t->chunk.memory);
+    t->chunk.memory = NULL;
+
+    t->batch = NULL;
+    t->node = NULL;
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Transfer_Free - Release a handle and its buffers.
+ ****************************************************************************/
+
+static void Elasticsearch_Transfer_Free( struct _Elasticsearch_Transfer *t )
+{
+
+    curl_easy_cleanup(t->curl);
+
+#ifdef HAVE_LIBZ
+    free(t->gzip.memory);
+#endif
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Batch_Next - Take the next batch to send.  Batches due for
+ * a retry go first.  With "wait",  block until there is one and return NULL
+ * only once Meer is shutting down and nothing is left.  Without "wait",
+ * return NULL when nothing is ready.
+ ****************************************************************************/
+
+static struct _Elasticsearch_Batch *Elasticsearch_Batch_Next( struct _Elasticsearch_Output *es, bool wait )
+{
+
+    struct _Elasticsearch_Batch *batch = NULL;
+    struct timespec wait_time;
+
+    uint64_t now = 0;
+    uint64_t retry_at = 0;
+
+    pthread_mutex_lock(&es->mutex);
+
+    /* Wake at least once a second to notice a shutdown.  Anything already
+       queued is still posted. */
+
+    while ( ( batch = Elasticsearch_Retry_Next( es, &retry_at ) ) == NULL &&
+            es->queued_count == 0 && wait == true &&
+            ( elasticsearch_death == false || es->retry_batches != NULL ) )
+        {
+
+            now = Current_Epoch_Ms();
+
+            if ( retry_at == 0 || retry_at > now + 1000 )
+                {
+                    retry_at = now + 1000;
+                }
+
+            wait_time.tv_sec = retry_at / 1000;
+            wait_time.tv_nsec = ( retry_at % 1000 ) * 1000000;
+
+            pthread_cond_timedwait(&es->work, &es->mutex, &wait_time);
+        }
+
+    if ( batch == NULL && es->queued_count != 0 )
+        {
+
+            batch = es->queued[es->queued_head];
+            es->queued_head = ( es->queued_head + 1 ) % es->queue;
+            es->queued_count--;
+
+            pthread_cond_signal(&es->space);
+
+        }
+
+    pthread_mutex_unlock(&es->mutex);
+
+    return(batch);
+
+}
+
+/*************************************/
+/* Elasticsearch threaded operation! */
+/*************************************/
+
+void Elasticsearch( struct _Elasticsearch_Output *es )
+{
+
+    struct _Elasticsearch_Batch *batch = NULL;
+    struct _Elasticsearch_Transfer t;
+    struct curl_slist *headers = Elasticsearch_Headers( es );
+
+    CURLcode res;
+
+    unsigned int seed = (unsigned int)time(NULL) ^ (unsigned int)(uintptr_t)&seed;    /* Backoff jitter */
+
+#ifdef HAVE_LIBZ
+
+    z_stream strm;
+
+    Elasticsearch_Gzip_Init( es, &strm );
+
+#endif
+
+    Elasticsearch_Transfer_Init( es, &t, headers );
+
+    while ( ( batch = Elasticsearch_Batch_Next( es, true ) ) != NULL )
+        {
+
+#ifdef HAVE_LIBZ
+            Elasticsearch_Transfer_Start( &t, batch, &strm );
+#else
+            Elasticsearch_Transfer_Start( &t, batch );
+#endif
+
+            res = curl_easy_perform(t.curl);
+
+            Elasticsearch_Transfer_Done( &t, res, &seed );
+
+        }
+
+    /* Clean up thread! */
+
+    Elasticsearch_Transfer_Free( &t );
+    curl_slist_free_all( headers );
+
+#ifdef HAVE_LIBZ
+
+    if ( es->gzip == true )
+        {
+            deflateEnd( &strm );
+        }
+
+#endif
+
+    pthread_exit(NULL);
+
+}
+
+/****************************************************************************
+ * Elasticsearch_Multi - The "multi" engine.  One thread runs up to
+ * "concurrency" bulk requests at once with libcurl's multi interface.
+ * Handles share libcurl's connection cache,  so connections are kept alive
+ * and,  over HTTP/2,  requests are multiplexed on one connection.
+ ****************************************************************************/
+
+void Elasticsearch_Multi( struct _Elasticsearch_Output *es )
+{
+
+    struct _Elasticsearch_Batch *batch = NULL;
+    struct _Elasticsearch_Transfer *transfers = NULL;
+    struct _Elasticsearch_Transfer *t = NULL;
+    struct curl_slist *headers = Elasticsearch_Headers( es );
+
+    CURLM *multi = NULL;
+    CURLMsg *msg = NULL;
+
+    uint16_t i = 0;
+    uint16_t active = 0;
+    int running = 0;
+    int left = 0;
+
+    unsigned int seed = (unsigned int)time(NULL) ^ (unsigned int)(uintptr_t)&seed;    /* Backoff jitter */
+
+#ifdef HAVE_LIBZ
+
+    z_stream strm;
+
+    Elasticsearch_Gzip_Init( es, &strm );
+
+#endif
+
+    multi = curl_multi_init();
+
+    if ( multi == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to initialize libcurl multi.", __FILE__, __LINE__ );
+        }
+
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+    transfers = malloc( es->concurrency * sizeof(struct _Elasticsearch_Transfer) );
+
+    if ( transfers == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for Elasticsearch transfers. Abort!", __FILE__, __LINE__);
+        }
+
+    for ( i = 0; i < es->concurrency; i++ )
+        {
+            Elasticsearch_Transfer_Init( es, &transfers[i], headers );
+        }
+
+    while ( true )
+        {
+
+            /* Fill idle handles.  Only block for work when nothing is in
+               flight. */
+
+            for ( i = 0; i < es->concurrency; i++ )
+                {
+
+                    if ( transfers[i].batch != NULL )
+                        {
+                            continue;
+                        }
+
+                    if ( ( batch = Elasticsearch_Batch_Next( es, active == 0 ) ) == NULL )
+                        {
+                            break;
+                        }
+
+#ifdef HAVE_LIBZ
+                    Elasticsearch_Transfer_Start( &transfers[i], batch, &strm );
+#else
+                    Elasticsearch_Transfer_Start( &transfers[i], batch );
+#endif
+
+                    curl_multi_add_handle(multi, transfers[i].curl);
+                    active++;
+
+                }
+
+            /* Shutting down and nothing left */
+
+            if ( active == 0 )
+                {
+                    break;
+                }
+
+            curl_multi_perform(multi, &running);
+
+            while ( ( msg = curl_multi_info_read(multi, &left) ) != NULL )
+                {
+
+                    if ( msg->msg != CURLMSG_DONE )
+                        {
+                            continue;
+                        }
+
+                    curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&t);
+
+                    curl_multi_remove_handle(multi, t->curl);
+
+                    Elasticsearch_Transfer_Done( t, msg->data.result, &seed );
+                    active--;
+
+                }
+
+            /* A short timeout so new batches are picked up while requests
+               are in flight */
+
+            if ( active != 0 )
+                {
+                    curl_multi_wait(multi, NULL, 0, ELASTICSEARCH_MULTI_WAIT_MS, NULL);
+                }
+
+        }
+
+    /* Clean up thread! */
+
+    for ( i = 0; i < es->concurrency; i++ )
+        {
+            Elasticsearch_Transfer_Free( &transfers[i] );
+        }
+
+    free( transfers );
+    curl_multi_cleanup( multi );
+    curl_slist_free_all( headers );
+
+#ifdef HAVE_LIBZ
+
+    if ( es->gzip == true )
+        {
+            deflateEnd( &strm );
+        }
+
+#endif
+
+    pthread_exit(NULL);
+
+}
+
+#endif
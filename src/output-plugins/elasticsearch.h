@@ -18,6 +18,7 @@
 ** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
+#include <pthread.h>
 
 #define MEER_AUTO_AUTH		0
 #define	MEER_BASIC_AUTH		1
@@ -31,6 +32,161 @@ struct MemoryStruct
     size_t size;
 };
 
+struct _Elasticsearch_Index_Part
+{
+    uint8_t type;			/* ELASTICSEARCH_INDEX_LITERAL, etc */
+    const char *literal;		/* Into the output's "index" */
+    size_t len;
+};
+
+struct _Elasticsearch_Index
+{
+    char event_type[64];
+    uint32_t day;			/* YYYYMMDD,  0 if the template has no date */
+    uint32_t generation;		/* Changes each time the slot is reused */
+    char name[512];
+    char action[600];			/* {"index":{"_index":"name"}}\n */
+    size_t action_len;
+};
+
+struct _Elasticsearch_Node
+{
+    char url[1024];			/* Bulk endpoint */
+    char probe_url[1024];		/* Root of the node,  for health checks */
+    uint16_t outstanding;		/* Requests in flight */
+    bool ejected;			/* Failed,  waiting on a probe */
+    uint64_t probe_at;			/* ms,  next health check when ejected */
+};
+
+struct _Elasticsearch_Segment
+{
+    size_t offset;			/* Into _Elasticsearch_Batch "data" */
+    size_t len;
+};
+
+struct _Elasticsearch_Batch
+{
+    char *data;				/* Action lines and events */
+    size_t len;
+    size_t size;
+
+    struct _Elasticsearch_Segment *segments;	/* Bulk body,  in order */
+    uint32_t segment_count;
+    uint32_t segment_size;
+    size_t body_len;
+
+    uint32_t action_generation[ELASTICSEARCH_INDEX_CACHE];	/* Action lines already in "data", */
+    size_t action_offset[ELASTICSEARCH_INDEX_CACHE];	/* by index cache slot */
+
+    uint32_t read_segment;		/* Where libcurl is in the body */
+    size_t read_offset;
+
+    uint16_t count;			/* Events in the batch */
+    uint16_t attempts;			/* Times the cluster answered with an error */
+    uint16_t failures;			/* Times sent and failed,  for the back off */
+    uint64_t retry_at;			/* ms,  when on the retry list */
+    uint64_t first_at;			/* ms,  when the first event was added */
+    struct _Elasticsearch_Batch *next;	/* Free list */
+};
+
+/* One "elasticsearch" block from meer.yaml.  Each has its own cluster,
+   routing,  batches and writer threads. */
+
+struct _Elasticsearch_Output
+{
+    char name[64];			/* "elasticsearch",  "elasticsearch-archive",  etc */
+
+    bool enabled;
+    bool debug;
+    bool insecure;
+    char url[8192];
+    char index[512];
+    char username[64];
+    char password[128];
+    uint16_t batch;
+    uint8_t threads;
+    uint16_t queue;			/* Batches waiting for a worker */
+    uint64_t max_body;			/* Bytes per bulk POST */
+    bool gzip;
+    uint8_t gzip_level;
+    uint16_t retries;			/* 0 == retry forever */
+    char dead_letter[256];
+    uint32_t flush_interval;		/* ms,  0 == only full batches */
+    bool multi;				/* "multi" engine rather than "threads" */
+    bool index_event_date;		/* Index date from the event "timestamp" */
+    bool document_id;			/* _id from a hash of the event */
+    uint16_t concurrency;		/* Requests in flight,  multi engine */
+    struct _Output_Queue_Config worker;	/* In front of the batches */
+
+    bool alert;
+    bool files;
+    bool flow;
+    bool dns;
+    bool http;
+    bool tls;
+    bool ssh;
+    bool smtp;
+    bool email;
+    bool fileinfo;
+    bool dhcp;
+    bool stats;
+    bool rdp;
+    bool sip;
+    bool ftp;
+    bool ikev2;
+    bool nfs;
+    bool tftp;
+    bool smb;
+    bool mqtt;
+    bool dcerpc;
+    bool netflow;
+    bool metadata;
+    bool dnp3;
+    bool anomaly;
+    bool fingerprint;
+    bool ndp;
+
+    /* Run time,  owned by elasticsearch.c */
+
+    struct _Output_Queue *output_queue;		/* Feeds Output_Elasticsearch_Write() */
+    struct _Elasticsearch_Batch *current;	/* Being filled by the output worker */
+
+    struct _Elasticsearch_Batch **queued;	/* Ring of "queue" full batches */
+    uint16_t queued_head;
+    uint16_t queued_count;
+
+    struct _Elasticsearch_Batch *free_batches;
+    struct _Elasticsearch_Batch *retry_batches;	/* Waiting to be sent again */
+    uint16_t retry_count;			/* Counts against "queue" too */
+
+    FILE *dead_letter_fd;
+
+    struct _Elasticsearch_Index_Part index_parts[ELASTICSEARCH_INDEX_PARTS];	/* Compiled "index" */
+    uint8_t index_part_count;
+    bool index_dated;			/* Has $YEAR,  $MONTH or $DAY */
+    time_t index_day_start;		/* Today,  per output since each has */
+    time_t index_day_end;		/* its own worker */
+    uint32_t index_today;
+
+    struct _Elasticsearch_Index index_cache[ELASTICSEARCH_INDEX_CACHE];
+    uint32_t index_generation;
+
+    struct _Elasticsearch_Node nodes[ELASTICSEARCH_MAX_NODES];
+    uint8_t node_count;
+    uint8_t node_next;			/* Round robin between ties */
+
+    pthread_cond_t work;		/* A batch was queued */
+    pthread_cond_t space;		/* A batch was taken off the queue */
+    pthread_mutex_t mutex;		/* Queue,  free and retry lists */
+    pthread_mutex_t batch_mutex;	/* "current" */
+    pthread_mutex_t node_mutex;
+};
+
 void Elasticsearch_Init( void );
-void Elasticsearch_Get_Index ( char *str, size_t size, const char *event_type );
-void Elasticsearch( void );
+void Elasticsearch_Output_Defaults( struct _Elasticsearch_Output *es );
+void Elasticsearch_Flush( struct _Elasticsearch_Output *es );
+bool Elasticsearch_Backed_Up( struct _Elasticsearch_Output *es );
+void Elasticsearch_Batch_Add( struct _Elasticsearch_Output *es, struct _Elasticsearch_Index *index, const char *id, const char *json_string );
+struct _Elasticsearch_Index *Elasticsearch_Index_Lookup( struct _Elasticsearch_Output *es, const char *event_type, const char *json_string );
+void Elasticsearch( struct _Elasticsearch_Output *es );
+void Elasticsearch_Multi( struct _Elasticsearch_Output *es );
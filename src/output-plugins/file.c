@@ -27,19 +27,38 @@
 #include <string.h>
 #include <errno.h>
 
-#include "output-plugins/file.h"
-
 #include "meer.h"
 #include "meer-def.h"
 #include "util.h"
+#include "output-queue.h"
+
+#include "output-plugins/file.h"
 
-extern struct _MeerOutput *MeerOutput;
+/****************************************************************************
+ * File_Output_Defaults - Settings for a new "file" block before meer.yaml
+ * is applied.
+ ****************************************************************************/
 
-bool Output_Do_File ( const char *json_string )
+void File_Output_Defaults( struct _File_Output *file )
 {
-    fprintf(MeerOutput->file_fd, "%s\n", json_string);
-    fflush(MeerOutput->file_fd);
-    return(true);
+
+    memset(file, 0, sizeof(struct _File_Output));
+
+    Output_Queue_Defaults( &file->worker );
+
 }
 
+/* The file output's worker flushes once its queue drains */
+
+bool Output_Do_File ( struct _File_Output *file, const char *json_string )
+{
+
+    if ( fprintf(file->fd, "%s\n", json_string) < 0 )
+        {
+            Meer_Log(WARN, "Could not write to '%s'. Error: %s", file->location, strerror(errno));
+            Output_Queue_Failed();
+            return(false);
+        }
 
+    return(true);
+}
@@ -18,5 +18,45 @@
 ** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
+/* One "file" block from meer.yaml.  Each has its own file,  routing and
+   worker. */
 
-bool Output_Do_File ( const char *json_string );
+struct _File_Output
+{
+    char name[64];			/* "file",  "file-archive",  etc */
+
+    bool enabled;
+    char location[256];
+    FILE *fd;
+    struct _Output_Queue_Config worker;
+
+    bool alert;
+    bool files;
+    bool flow;
+    bool dns;
+    bool http;
+    bool tls;
+    bool ssh;
+    bool smtp;
+    bool email;
+    bool fileinfo;
+    bool dhcp;
+    bool stats;
+    bool rdp;
+    bool sip;
+    bool ftp;
+    bool ikev2;
+    bool nfs;
+    bool tftp;
+    bool smb;
+    bool mqtt;
+    bool dcerpc;
+    bool netflow;
+    bool metadata;
+    bool dnp3;
+    bool anomaly;
+    bool fingerprint;
+};
+
+void File_Output_Defaults( struct _File_Output *file );
+bool Output_Do_File ( struct _File_Output *file, const char *json_string );
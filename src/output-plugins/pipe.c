@@ -33,34 +33,55 @@
 
 #include "meer.h"
 #include "meer-def.h"
+#include "output-queue.h"
 #include "pipe.h"
 
-extern struct _MeerOutput *MeerOutput;
 extern struct _MeerCounters *MeerCounters;
 
-void Pipe_Write ( const char *json_string )
+/****************************************************************************
+ * Pipe_Output_Defaults - Settings for a new "pipe" block before meer.yaml
+ * is applied.
+ ****************************************************************************/
+
+void Pipe_Output_Defaults( struct _Pipe_Output *pipe_out )
+{
+
+    memset(pipe_out, 0, sizeof(struct _Pipe_Output));
+
+    pipe_out->size = DEFAULT_PIPE_SIZE;
+    pipe_out->fd = -1;
+
+    Output_Queue_Defaults( &pipe_out->worker );
+
+}
+
+/* Each pipe output has its own worker,  so the counters are shared */
+
+void Pipe_Write ( struct _Pipe_Output *pipe_out, const char *json_string )
 {
-    uint32_t ret = 0;
+    ssize_t ret = 0;
 
-    ret = write(MeerOutput->pipe_fd, json_string, strlen(json_string));
+    ret = write(pipe_out->fd, json_string, strlen(json_string));
 
     if ( ret < 0 )
         {
-            Meer_Log(WARN, "Could not write pipe. Error: %s", strerror(errno));
+            Meer_Log(WARN, "Could not write pipe '%s'. Error: %s", pipe_out->location, strerror(errno));
+            Output_Queue_Failed();
             return;
         }
 
     /* Tack on newline */
 
-    ret = write(MeerOutput->pipe_fd, "\n", 1);
+    ret = write(pipe_out->fd, "\n", 1);
 
     if ( ret < 0 )
         {
-            Meer_Log(WARN, "Could not write pipe. Error: %s", strerror(errno));
+            Meer_Log(WARN, "Could not write pipe '%s'. Error: %s", pipe_out->location, strerror(errno));
+            Output_Queue_Failed();
             return;
         }
 
 
-    MeerCounters->JSONPipeWrites++;
+    __atomic_add_fetch(&MeerCounters->JSONPipeWrites, 1, __ATOMIC_SEQ_CST);
 
 }
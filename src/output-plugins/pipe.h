@@ -18,5 +18,47 @@
 ** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
-void Pipe_Write( const char *json_string );
+/* One "pipe" block from meer.yaml.  Each has its own FIFO,  routing and
+   worker. */
+
+struct _Pipe_Output
+{
+    char name[64];			/* "pipe",  "pipe-archive",  etc */
+
+    bool enabled;
+    char location[256];
+    uint32_t size;
+    int fd;
+    struct _Output_Queue_Config worker;
+
+    bool alert;
+    bool files;
+    bool flow;
+    bool dns;
+    bool http;
+    bool tls;
+    bool ssh;
+    bool smtp;
+    bool email;
+    bool fileinfo;
+    bool dhcp;
+    bool stats;
+    bool rdp;
+    bool sip;
+    bool ftp;
+    bool ikev2;
+    bool nfs;
+    bool tftp;
+    bool smb;
+    bool mqtt;
+    bool dcerpc;
+    bool netflow;
+    bool metadata;
+    bool dnp3;
+    bool anomaly;
+    bool fingerprint;
+};
+
+void Pipe_Output_Defaults( struct _Pipe_Output *pipe_out );
+void Pipe_Write( struct _Pipe_Output *pipe_out, const char *json_string );
 
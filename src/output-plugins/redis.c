@@ -30,6 +30,9 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
 #include <unistd.h>
 #include <hiredis/hiredis.h>
 
@@ -38,6 +41,10 @@
 #include "lockfile.h"
 #include "config-yaml.h"
 #include "decode-output-json-client-stats.h"
+#include "util.h"
+#include "output-queue.h"
+
+#include "output-plugins/redis.h"
 
 #define MAX_REDIS_KEY_SIZE 128
 
@@ -47,44 +54,179 @@ extern struct _MeerWaldo *MeerWaldo;
 extern struct _MeerCounters *MeerCounters;
 extern struct _MeerHealth *MeerHealth;
 
-uint16_t redis_batch_count = 0;
+uint16_t redis_pipeline_count[REDIS_ROLES] = { 0 };
+
+/* Each "redis" / "redis-<name>" output batches its events packed back to
+   back as "key\0flow_id\0json\0event_type\0" in one buffer that grows
+   with what is actually queued.  batch_offset[] holds where each event's
+   key starts.  The event_type and batch_position[] are only kept so events
+   still held at shutdown can be spilled as they came in.
 
-char **redis_batch;
-char **redis_batch_key;
+   Events are spread over one or more plain Redis servers (shards) with a
+   consistent hash ring,  so adding or removing a server only moves the
+   events that hashed to it.  Each shard has its own connection.  The batch
+   and the shards belong to the output and are only touched by its worker
+   (see output-queue.c).
 
-void Redis_Close( void )
+   A shard that can't be reached is tried once per send,  and after a
+   failed attempt not again until "retry_at".  Its events stay at the front
+   of the batch and go out with a later send.  The other shards are
+   written as usual. */
+
+struct _Redis_Shard
+{
+    char server[255];
+    uint16_t port;
+    redisContext *c;
+    uint32_t pending;		/* Events in the current send */
+    uint32_t written;		/* Of those,  how many Redis replied to */
+    uint64_t retry_at;		/* ms,  when a down shard is tried again */
+    uint32_t backoff;		/* ms,  doubles while it stays down */
+};
+
+struct _Redis_Ring_Point
 {
+    uint32_t hash;
+    uint8_t shard;
+};
 
-    uint8_t i = 0;
+static void Redis_Shards_Init( struct _Redis_Output *redis );
+static void Redis_Shards_Disconnect( struct _Redis_Output *redis );
+static void Redis_Batch_Send( struct _Redis_Output *redis );
+
+/****************************************************************************
+ * Redis_Flush - Send a partial batch.  Called when the output's queue has
+ * drained,  so a quiet sensor's events aren't held back waiting for a full
+ * batch.
+ ****************************************************************************/
+
+void Redis_Flush( struct _Redis_Output *redis )
+{
 
-    for (i = 0;  i < MAX_REDIS_BATCH; i++ )
+    if ( redis->batch_count != 0 )
         {
-            free(redis_batch[i]);
-            free(redis_batch_key[i]);
+            Redis_Batch_Send( redis );
+        }
+
+}
+
+/****************************************************************************
+ * Redis_Close - Send what is batched and close the output's connections.
+ * Called by the output's worker as it exits.
+ ****************************************************************************/
+
+void Redis_Close( struct _Redis_Output *redis )
+{
+
+    struct _Output_Event *event = NULL;
+
+    char *key = NULL;
+    char *flow_id = NULL;
+    char *json_string = NULL;
+    char *event_type = NULL;
+
+    uint16_t i = 0;
+    bool spilled = false;
+
+    Redis_Flush( redis );
+
+    /* Events held for shards that are still down go to the output's spill
+       and are written on the next start */
+
+    for ( i = 0; i < redis->batch_count; i++ )
+        {
+
+            key = redis->batch_data + redis->batch_offset[i];
+            flow_id = key + strlen(key) + 1;
+            json_string = flow_id + strlen(flow_id) + 1;
+            event_type = json_string + strlen(json_string) + 1;
+
+            event = Output_Event_New( json_string, event_type, flow_id[0] != '\0' ? flow_id : NULL, NULL, NULL );
+            event->position = redis->batch_position[i];
+
+            spilled = Output_Queue_Spill( redis->output_queue, event );
+
+            Output_Event_Release( event );
+
+            if ( spilled == false )
+                {
+                    break;
+                }
         }
 
+    if ( redis->batch_count != 0 )
+        {
 
-    free(redis_batch);
-    free(redis_batch_key);
+            if ( spilled == true )
+                {
+                    Meer_Log(NORMAL, "Redis output '%s' shards still down at shutdown.  %" PRIu16 " events were spilled.", redis->name, redis->batch_count);
+                }
+            else
+                {
+                    Meer_Log(WARN, "Redis output '%s' shards still down at shutdown.  %" PRIu16 " events were not written.", redis->name, redis->batch_count);
+                }
+        }
+
+    Redis_Shards_Disconnect( redis );
+
+    free(redis->batch_data);
+    free(redis->shards);
+    free(redis->ring);
+    free(redis->item_shard);
+    free(redis->batch_offset);
+    free(redis->batch_position);
+    free(redis->batch_item);
+
+    redis->batch_data = NULL;
+    redis->batch_offset = NULL;
+    redis->batch_position = NULL;
+    redis->batch_item = NULL;
+    redis->batch_count = 0;
+    redis->shards = NULL;
+    redis->ring = NULL;
+    redis->item_shard = NULL;
 
 }
 
-void Redis_Init ( void )
+/****************************************************************************
+ * Redis_Output_Defaults - Settings for a "redis" / "redis-<name>" block
+ * before its options are read.
+ ****************************************************************************/
+
+void Redis_Output_Defaults( struct _Redis_Output *redis )
 {
 
-    uint8_t i = 0;
+    memset(redis, 0, sizeof(struct _Redis_Output));
+
+    strlcpy(redis->server, "127.0.0.1", sizeof(redis->server));
+    strlcpy(redis->command, "set", sizeof(redis->command));
 
-    redis_batch = malloc(sizeof(char*) * MAX_REDIS_BATCH);
-    redis_batch_key = malloc(sizeof(char*) * MAX_REDIS_BATCH);
+    redis->port = 6379;
+    redis->batch = 1;
+    redis->stream_maxlen = REDIS_STREAM_MAXLEN_DEFAULT;
 
-    memset(redis_batch, 0, (sizeof(char*) * MAX_REDIS_BATCH));
-    memset(redis_batch_key, 0, (sizeof(char*) * MAX_REDIS_BATCH));
+    Output_Queue_Defaults( &redis->worker );
 
-    for (i = 0;  i < MAX_REDIS_BATCH; i++ )
+}
+
+void Redis_Init ( struct _Redis_Output *redis )
+{
+
+    redis->batch_size = MeerConfig->payload_buffer_size;
+    redis->batch_len = 0;
+
+    redis->batch_data = malloc( redis->batch_size );
+    redis->batch_offset = malloc( sizeof(size_t) * redis->batch );
+    redis->batch_position = malloc( sizeof(uint64_t) * redis->batch );
+    redis->batch_item = malloc( sizeof(char *) * redis->batch );
+
+    if ( redis->batch_data == NULL || redis->batch_offset == NULL || redis->batch_position == NULL || redis->batch_item == NULL )
         {
-            redis_batch[i] = malloc( (MeerConfig->payload_buffer_size)*sizeof(char));
-            redis_batch_key[i] = malloc( (MAX_REDIS_KEY_SIZE)*sizeof(char));
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for Redis output '%s' batch. Abort!", __FILE__, __LINE__, redis->name);
         }
+
+    Redis_Shards_Init( redis );
+
 }
 
 void Redis_Auth ( void )
@@ -93,49 +235,52 @@ void Redis_Auth ( void )
 
 }
 
-void Redis_Connect( void )
+/****************************************************************************
+ * Redis_Connect_Try - One attempt to open and authenticate a connection to
+ * the given server.  Returns NULL if it can't be reached.  "name" is only
+ * used for logging.
+ ****************************************************************************/
+
+static redisContext *Redis_Connect_Try( const char *name, const char *server, uint16_t port, const char *password )
 {
 
     redisReply *reply = NULL;
-    MeerOutput->c_redis = NULL;
+    redisContext *c = NULL;
 
-    while ( MeerOutput->c_redis == NULL || MeerOutput->c_redis->err )
-        {
-
-            struct timeval timeout = { 1, 500000 }; // 5.5 seconds
-            MeerOutput->c_redis = redisConnectWithTimeout(MeerOutput->redis_server, MeerOutput->redis_port, timeout);
+    struct timeval timeout = { 1, 500000 }; // 1.5 seconds
 
-            if (MeerOutput->c_redis == NULL || MeerOutput->c_redis->err)
-                {
+    c = redisConnectWithTimeout(server, port, timeout);
 
-                    if (MeerOutput->c_redis)
-                        {
-                            Meer_Log(WARN, "[%s, line %d] Redis 'reader' connection error! Sleeping for 2 seconds!", __FILE__, __LINE__);
+    if (c == NULL || c->err)
+        {
 
-                        }
-                    else
-                        {
-                            Meer_Log(WARN, "[%s, line %d] Redis 'reader' connection error - Can't allocate Redis context", __FILE__, __LINE__);
-                        }
-                    sleep(2);
+            if (c)
+                {
+                    Meer_Log(WARN, "[%s, line %d] Redis '%s' connection error to %s:%d: %s", __FILE__, __LINE__, name, server, port, c->errstr);
+                    redisFree(c);
+                }
+            else
+                {
+                    Meer_Log(WARN, "[%s, line %d] Redis '%s' connection error to %s:%d - Can't allocate Redis context", __FILE__, __LINE__, name, server, port);
                 }
-        }
 
+            return(NULL);
+        }
 
     /* Log into Redis (if needed) */
 
-    if ( MeerOutput->redis_password[0] != '\0' )
+    if ( password[0] != '\0' )
         {
 
-            reply = redisCommand(MeerOutput->c_redis, "AUTH %s", MeerOutput->redis_password);
+            reply = redisCommand(c, "AUTH %s", password);
 
-            if (!strcmp(reply->str, "OK"))
+            if ( reply != NULL && reply->str != NULL && !strcmp(reply->str, "OK"))
                 {
 
                     if ( MeerOutput->redis_debug )
                         {
 
-                            Meer_Log( DEBUG, "Authentication success for 'reader' to Redis server at %s:%d.", MeerOutput->redis_server, MeerOutput->redis_port );
+                            Meer_Log( DEBUG, "Authentication success for '%s' to Redis server at %s:%d.", name, server, port );
 
                         }
 
@@ -146,16 +291,66 @@ void Redis_Connect( void )
                     Remove_Lock_File();
                     freeReplyObject(reply);
 
-                    Meer_Log(ERROR, "Authentication failure for 'reader' to to Redis server at %s:%d. Abort!", MeerOutput->redis_server, MeerOutput->redis_port );
+                    Meer_Log(ERROR, "Authentication failure for '%s' to to Redis server at %s:%d. Abort!", name, server, port );
 
                 }
         }
 
-    Meer_Log(NORMAL, "Successfully connected to Redis server at %s:%d.", MeerOutput->redis_server, MeerOutput->redis_port );
+    Meer_Log(NORMAL, "Successfully connected '%s' to Redis server at %s:%d.", name, server, port );
 
-    MeerOutput->redis_error = false;
     freeReplyObject(reply);
 
+    return(c);
+
+}
+
+/****************************************************************************
+ * Redis_Connect_Context - Open and authenticate a new connection to the
+ * given server.  Retries every 2 seconds until it succeeds.
+ ****************************************************************************/
+
+redisContext *Redis_Connect_Context( const char *name, const char *server, uint16_t port, const char *password )
+{
+
+    redisContext *c = NULL;
+
+    while ( ( c = Redis_Connect_Try( name, server, port, password ) ) == NULL )
+        {
+            Meer_Log(WARN, "[%s, line %d] Sleeping for 2 seconds!", __FILE__, __LINE__);
+            sleep(2);
+        }
+
+    return(c);
+
+}
+
+/****************************************************************************
+ * Redis_Connect - (Re)connect one of the decode thread's connections.  The
+ * REDIS_READER connection does fingerprint lookups and can point at a
+ * replica with "reader_server".  The REDIS_WRITER connection does
+ * fingerprint and client_stats writes.  Output has its own connections
+ * (see Redis_Output_Send()).
+ ****************************************************************************/
+
+void Redis_Connect( uint8_t role )
+{
+
+    if ( MeerOutput->c_redis[role] != NULL )
+        {
+            redisFree(MeerOutput->c_redis[role]);
+        }
+
+    if ( role == REDIS_READER && MeerOutput->redis_reader_server[0] != '\0' )
+        {
+            MeerOutput->c_redis[role] = Redis_Connect_Context( "reader", MeerOutput->redis_reader_server, MeerOutput->redis_reader_port, MeerOutput->redis_password );
+        }
+    else
+        {
+            MeerOutput->c_redis[role] = Redis_Connect_Context( role == REDIS_READER ? "reader" : "writer", MeerOutput->redis_server, MeerOutput->redis_port, MeerOutput->redis_password );
+        }
+
+    MeerOutput->redis_error[role] = false;
+
 }
 
 void Redis_Reader ( char *redis_command, char *str, size_t size )
@@ -163,12 +358,12 @@ void Redis_Reader ( char *redis_command, char *str, size_t size )
 
     redisReply *reply;
 
-    while ( MeerOutput->redis_error == true )
+    while ( MeerOutput->redis_error[REDIS_READER] == true )
         {
-            Redis_Connect();
+            Redis_Connect( REDIS_READER );
         }
 
-    reply = redisCommand(MeerOutput->c_redis, redis_command);
+    reply = redisCommand(MeerOutput->c_redis[REDIS_READER], redis_command);
 
     /* Get results */
 
@@ -201,7 +396,9 @@ void Redis_Reader ( char *redis_command, char *str, size_t size )
         }
     else
         {
-            strlcpy(str, reply->element[0]->str, size);
+            Meer_Log(WARN, "[%s, line %d] Redis error on \"%s\".", __FILE__, __LINE__, redis_command);
+            MeerOutput->redis_error[REDIS_READER] = true;
+            str[0] = '\0';
         }
 
     /* Got good response, free here.  If we don't get a good response
@@ -211,14 +408,19 @@ void Redis_Reader ( char *redis_command, char *str, size_t size )
 
 }
 
-bool Redis_Writer ( char *command, char *key, char *value, int expire )
+bool Redis_Writer ( const char *command, const char *key, const char *value, int expire )
 {
 
     redisReply *reply;
 
+    while ( MeerOutput->redis_error[REDIS_WRITER] == true )
+        {
+            Redis_Connect( REDIS_WRITER );
+        }
+
     if ( expire == 0 )
         {
-            reply = redisCommand(MeerOutput->c_redis, "%s %s %s", command, key, value);
+            reply = redisCommand(MeerOutput->c_redis[REDIS_WRITER], "%s %s %s", command, key, value);
 
             if ( MeerOutput->redis_debug )
                 {
@@ -227,7 +429,7 @@ bool Redis_Writer ( char *command, char *key, char *value, int expire )
         }
     else
         {
-            reply = redisCommand(MeerOutput->c_redis, "%s %s %s EX %d", command, key, value, expire);
+            reply = redisCommand(MeerOutput->c_redis[REDIS_WRITER], "%s %s %s EX %d", command, key, value, expire);
 
             if ( MeerOutput->redis_debug )
                 {
@@ -235,6 +437,13 @@ bool Redis_Writer ( char *command, char *key, char *value, int expire )
                 }
         }
 
+    if ( reply == NULL )
+        {
+            Meer_Log(WARN, "[%s, line %d] Redis error writing '%s'.", __FILE__, __LINE__, key);
+            MeerOutput->redis_error[REDIS_WRITER] = true;
+            return(false);
+        }
+
     if ( reply->str != NULL )
         {
 
@@ -259,60 +468,631 @@ bool Redis_Writer ( char *command, char *key, char *value, int expire )
     return(true);
 }
 
+/****************************************************************************
+ * Redis_Pipeline_Append - Queue a command on the "role" connection without
+ * waiting for the reply.  Replies come back in order via
+ * Redis_Pipeline_Reply() or are drained by Redis_Pipeline_Flush().
+ * Nothing else may use that connection while replies are pending.
+ ****************************************************************************/
 
-void JSON_To_Redis ( const char *json_string, const char *key )
+bool Redis_Pipeline_Append( uint8_t role, const char *format, ... )
 {
 
-    uint16_t i = 0;
+    va_list ap;
+    int rc = 0;
 
-    /* Write request to Redis queue */
+    if ( redis_pipeline_count[role] == 0 )
+        {
+            while ( MeerOutput->redis_error[role] == true )
+                {
+                    Redis_Connect( role );
+                }
+        }
 
-    strlcpy(redis_batch[redis_batch_count], json_string, MeerConfig->payload_buffer_size);
-    strlcpy(redis_batch_key[redis_batch_count], key, MAX_REDIS_KEY_SIZE);
+    va_start(ap, format);
+    rc = redisvAppendCommand(MeerOutput->c_redis[role], format, ap);
+    va_end(ap);
 
-    redis_batch_count++;
+    if ( rc != REDIS_OK )
+        {
+            Meer_Log(WARN, "[%s, line %d] Unable to queue Redis command: %s", __FILE__, __LINE__, MeerOutput->c_redis[role]->errstr);
+            MeerOutput->redis_error[role] = true;
+            return(false);
+        }
 
-    /* See if Redis queue needs to be written */
+    if ( MeerOutput->redis_debug )
+        {
+            Meer_Log(DEBUG, "Queued to Redis: %s", format);
+        }
+
+    redis_pipeline_count[role]++;
+
+    return(true);
+
+}
+
+/****************************************************************************
+ * Redis_Pipeline_Reply - Read the next pending reply.  The caller frees it.
+ * Returns NULL if nothing is pending or the connection failed.
+ ****************************************************************************/
+
+redisReply *Redis_Pipeline_Reply( uint8_t role )
+{
+
+    void *reply = NULL;
+
+    if ( redis_pipeline_count[role] == 0 )
+        {
+            return(NULL);
+        }
+
+    if ( redisGetReply(MeerOutput->c_redis[role], &reply) != REDIS_OK || reply == NULL )
+        {
+            Meer_Log(WARN, "[%s, line %d] Redis error reading pipelined reply: %s", __FILE__, __LINE__, MeerOutput->c_redis[role]->errstr);
+
+            /* The rest of the replies are lost with the connection */
+
+            MeerOutput->redis_error[role] = true;
+            redis_pipeline_count[role] = 0;
+            return(NULL);
+        }
+
+    redis_pipeline_count[role]--;
+
+    if ( ((redisReply *)reply)->type == REDIS_REPLY_ERROR )
+        {
+            Meer_Log(WARN, "[%s, line %d] Redis returned an error: %s", __FILE__, __LINE__, ((redisReply *)reply)->str);
+        }
+
+    return( (redisReply *)reply );
+
+}
+
+/****************************************************************************
+ * Redis_Pipeline_Flush - Read and discard every pending reply
+ ****************************************************************************/
+
+void Redis_Pipeline_Flush( uint8_t role )
+{
+
+    redisReply *reply = NULL;
+
+    while ( redis_pipeline_count[role] != 0 )
+        {
+
+            reply = Redis_Pipeline_Reply( role );
+
+            if ( reply == NULL )
+                {
+                    break;
+                }
+
+            freeReplyObject(reply);
+        }
+
+}
+
+/****************************************************************************
+ * Redis_Output_Append - Queue the write of one output event on "c".  In
+ * "stream" mode this is an XADD of a single "event" field,  trimmed to
+ * roughly "stream_maxlen" entries.  The "~" lets Redis trim whole macro
+ * nodes,  which is far cheaper than an exact MAXLEN.
+ ****************************************************************************/
+
+static int Redis_Output_Append( struct _Redis_Output *redis, redisContext *c, const char *key, const char *json_string )
+{
+
+    if ( redis->stream == false )
+        {
+            return( redisAppendCommand(c, "%s %s %s", redis->command, key, json_string) );
+        }
+
+    if ( redis->stream_maxlen == 0 )
+        {
+            return( redisAppendCommand(c, "XADD %s * %s %s", key, REDIS_STREAM_FIELD, json_string) );
+        }
+
+    return( redisAppendCommand(c, "XADD %s MAXLEN ~ %" PRIu32 " * %s %s", key, redis->stream_maxlen, REDIS_STREAM_FIELD, json_string) );
+
+}
+
+/****************************************************************************
+ * Redis_Hash - FNV-1a with a final avalanche so that similar strings (flow
+ * IDs,  "host:port#N") spread evenly around the ring.
+ ****************************************************************************/
+
+static uint32_t Redis_Hash( const char *str )
+{
+
+    uint32_t hash = 2166136261U;
+
+    while ( *str != '\0' )
+        {
+            hash = ( hash ^ (unsigned char)*str++ ) * 16777619U;
+        }
+
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bU;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35U;
+    hash ^= hash >> 16;
+
+    return(hash);
+
+}
+
+static int Redis_Ring_Compare( const void *a, const void *b )
+{
+
+    const struct _Redis_Ring_Point *pa = a;
+    const struct _Redis_Ring_Point *pb = b;
+
+    if ( pa->hash < pb->hash )
+        {
+            return(-1);
+        }
+
+    return( pa->hash > pb->hash );
+
+}
+
+/****************************************************************************
+ * Redis_Shards_Init - Set up the shard list and hash ring.  Without
+ * "shards",  the one "server" is the only shard.
+ ****************************************************************************/
+
+static void Redis_Shards_Init( struct _Redis_Output *redis )
+{
+
+    char point[300] = { 0 };
+
+    uint32_t i = 0;
+    uint8_t s = 0;
+
+    redis->shards_count = redis->shard_count != 0 ? redis->shard_count : 1;
+
+    redis->shards = calloc( redis->shards_count, sizeof(struct _Redis_Shard) );
+    redis->ring = malloc( sizeof(struct _Redis_Ring_Point) * redis->shards_count * REDIS_SHARD_POINTS );
+    redis->item_shard = malloc( redis->batch );
+
+    if ( redis->shards == NULL || redis->ring == NULL || redis->item_shard == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for Redis output '%s' shards. Abort!", __FILE__, __LINE__, redis->name);
+        }
+
+    if ( redis->shard_count == 0 )
+        {
+            strlcpy(redis->shards[0].server, redis->server, sizeof(redis->shards[0].server));
+            redis->shards[0].port = redis->port;
+        }
+
+    for ( s = 0; s < redis->shard_count; s++ )
+        {
+            strlcpy(redis->shards[s].server, redis->shard_server[s], sizeof(redis->shards[s].server));
+            redis->shards[s].port = redis->shard_port[s];
+        }
+
+    redis->ring_count = 0;
+
+    for ( s = 0; s < redis->shards_count; s++ )
+        {
+
+            for ( i = 0; i < REDIS_SHARD_POINTS; i++ )
+                {
 
-    if ( redis_batch_count == MeerOutput->redis_batch )
+                    snprintf(point, sizeof(point), "%s:%d#%" PRIu32 "", redis->shards[s].server, redis->shards[s].port, i);
+                    point[ sizeof(point) - 1 ] = '\0';
+
+                    redis->ring[redis->ring_count].hash = Redis_Hash( point );
+                    redis->ring[redis->ring_count].shard = s;
+                    redis->ring_count++;
+
+                }
+
+            if ( redis->shards_count > 1 )
+                {
+                    Meer_Log(NORMAL, "Redis output '%s' shard %d: %s:%d", redis->name, s, redis->shards[s].server, redis->shards[s].port);
+                }
+        }
+
+    qsort( redis->ring, redis->ring_count, sizeof(struct _Redis_Ring_Point), Redis_Ring_Compare );
+
+}
+
+static void Redis_Shards_Disconnect( struct _Redis_Output *redis )
+{
+
+    uint8_t s = 0;
+
+    for ( s = 0; s < redis->shards_count; s++ )
+        {
+            if ( redis->shards[s].c != NULL )
+                {
+                    redisFree( redis->shards[s].c );
+                    redis->shards[s].c = NULL;
+                }
+        }
+
+}
+
+/****************************************************************************
+ * Redis_Shard_Select - Walk clockwise from the event's hash to the next
+ * point on the ring.  Events are placed by "flow_id" so a flow stays on one
+ * server,  unless "shard_by" is "key" or the event has no flow_id.
+ ****************************************************************************/
+
+static uint8_t Redis_Shard_Select( struct _Redis_Output *redis, const char *key, const char *flow_id )
+{
+
+    uint32_t hash = 0;
+    uint32_t low = 0;
+    uint32_t high = redis->ring_count;
+    uint32_t mid = 0;
+
+    if ( redis->shards_count == 1 )
+        {
+            return(0);
+        }
+
+    hash = Redis_Hash( redis->shard_by_key == false && flow_id[0] != '\0' ? flow_id : key );
+
+    while ( low < high )
         {
 
-            for ( i = 0; i < MeerOutput->redis_batch; i++ )
+            mid = low + ( high - low ) / 2;
+
+            if ( redis->ring[mid].hash < hash )
                 {
+                    low = mid + 1;
+                }
+            else
+                {
+                    high = mid;
+                }
+        }
 
-                    char tk1[128] = { 0 };
-                    char tk2[131] = { 0 };
+    return( redis->ring[ low == redis->ring_count ? 0 : low ].shard );
 
-                    if ( MeerOutput->redis_key[0] != '\0' )
+}
+
+/****************************************************************************
+ * Redis_Output_Send - Write "count" events ("key\0flow_id\0json\0...") to
+ * their shards.  Every shard's commands are queued and pushed out before
+ * any replies are read,  so the shards work on the batch in parallel.
+ *
+ * Events that didn't make it,  because their shard is down or its
+ * connection failed part way,  are moved to the front of "items" in order
+ * and their count is returned.  Replies are counted,  so after a failure
+ * only the events Redis didn't answer are sent again.  The one in flight
+ * when the connection dropped may be written twice.
+ ****************************************************************************/
+
+static uint32_t Redis_Output_Send( struct _Redis_Output *redis, char **items, uint32_t count )
+{
+
+    void *reply = NULL;
+
+    char *key = NULL;
+    char *flow_id = NULL;
+    char *json_string = NULL;
+
+    uint64_t now = Current_Epoch_Ms();
+
+    uint32_t i = 0;
+    uint32_t n = 0;
+    uint32_t held = 0;
+    uint8_t s = 0;
+
+    int done = 0;
+
+    for ( i = 0; i < count; i++ )
+        {
+            key = items[i];
+            flow_id = key + strlen(key) + 1;
+
+            redis->item_shard[i] = Redis_Shard_Select( redis, key, flow_id );
+            redis->shards[ redis->item_shard[i] ].pending++;
+        }
+
+    /* One connection attempt per down shard,  once its wait is up */
+
+    for ( s = 0; s < redis->shards_count; s++ )
+        {
+
+            redis->shards[s].written = 0;
+
+            if ( redis->shards[s].pending == 0 || redis->shards[s].c != NULL || now < redis->shards[s].retry_at )
+                {
+                    continue;
+                }
+
+            redis->shards[s].c = Redis_Connect_Try( redis->name, redis->shards[s].server, redis->shards[s].port, redis->password );
+
+            if ( redis->shards[s].c == NULL )
+                {
+
+                    redis->shards[s].backoff = ( redis->shards[s].backoff == 0 ? REDIS_SHARD_RETRY_MIN : redis->shards[s].backoff * 2 );
+
+                    if ( redis->shards[s].backoff > REDIS_SHARD_RETRY_MAX )
                         {
-                            strlcpy(tk1, MeerOutput->redis_key, MAX_REDIS_KEY_SIZE);
+                            redis->shards[s].backoff = REDIS_SHARD_RETRY_MAX;
                         }
-                    else
+
+                    redis->shards[s].retry_at = now + redis->shards[s].backoff;
+
+                    Meer_Log(WARN, "[%s, line %d] Redis output '%s' shard %s:%d is down.  Holding its %" PRIu32 " events and trying again in %" PRIu32 " ms.", __FILE__, __LINE__, redis->name, redis->shards[s].server, redis->shards[s].port, redis->shards[s].pending, redis->shards[s].backoff);
+
+                }
+            else
+                {
+                    redis->shards[s].backoff = 0;
+                }
+        }
+
+    /* Queue each event on its shard's connection */
+
+    for ( i = 0; i < count; i++ )
+        {
+
+            s = redis->item_shard[i];
+
+            if ( redis->shards[s].c == NULL )
+                {
+                    continue;
+                }
+
+            key = items[i];
+            flow_id = key + strlen(key) + 1;
+            json_string = flow_id + strlen(flow_id) + 1;
+
+            Redis_Output_Append( redis, redis->shards[s].c, key, json_string );
+
+        }
+
+    /* Push it all out */
+
+    for ( s = 0; s < redis->shards_count; s++ )
+        {
+
+            done = 0;
+
+            while ( redis->shards[s].pending != 0 && redis->shards[s].c != NULL && done == 0 )
+                {
+                    if ( redisBufferWrite( redis->shards[s].c, &done ) != REDIS_OK )
                         {
-                            strlcpy(tk1, redis_batch_key[i], MAX_REDIS_KEY_SIZE);
+                            break;	/* Caught when reading replies */
                         }
+                }
+        }
+
+    /* Read back the replies.  A shard's replies come in the order its
+       events were queued. */
 
-                    strlcpy(tk2, tk1, sizeof(tk2));
+    for ( s = 0; s < redis->shards_count; s++ )
+        {
+
+            if ( redis->shards[s].c == NULL )
+                {
+                    continue;
+                }
+
+            for ( n = 0; n < redis->shards[s].pending; n++ )
+                {
 
-                    if ( MeerOutput->redis_append_id == true )
+                    if ( redisGetReply( redis->shards[s].c, &reply ) != REDIS_OK || reply == NULL )
                         {
+                            Meer_Log(WARN, "[%s, line %d] Redis error writing to %s:%d: %s", __FILE__, __LINE__, redis->shards[s].server, redis->shards[s].port, redis->shards[s].c->errstr);
 
-                            snprintf(tk2, sizeof(tk2), "%s|%s|%s|%" PRIu64 "", tk1, MeerConfig->hostname, MeerConfig->interface, MeerWaldo->position);
-                            tk2[ sizeof(tk2) - 1 ] = '\0';
+                            /* Reconnected on the next send */
 
+                            redisFree( redis->shards[s].c );
+                            redis->shards[s].c = NULL;
+                            redis->shards[s].retry_at = 0;
+
+                            break;
+                        }
+
+                    if ( ((redisReply *)reply)->type == REDIS_REPLY_ERROR )
+                        {
+                            Meer_Log(WARN, "[%s, line %d] Redis returned an error: %s", __FILE__, __LINE__, ((redisReply *)reply)->str);
                         }
 
-                    Redis_Writer ( MeerOutput->redis_command, tk2, redis_batch[i], 0 );
+                    freeReplyObject(reply);
+
+                    redis->shards[s].written++;
 
                 }
+        }
 
-            redis_batch_count = 0;
+    /* Keep what wasn't answered,  in order */
 
-            if ( MeerOutput->redis_debug )
+    for ( i = 0; i < count; i++ )
+        {
+
+            s = redis->item_shard[i];
+
+            if ( redis->shards[s].written != 0 )
+                {
+                    redis->shards[s].written--;
+                    continue;
+                }
+
+            items[held++] = items[i];
+
+        }
+
+    for ( s = 0; s < redis->shards_count; s++ )
+        {
+            redis->shards[s].pending = 0;
+        }
+
+    if ( redis->debug )
+        {
+            Meer_Log(DEBUG, "[%s, line %d] Wrote %" PRIu32 " events to Redis output '%s',  %" PRIu32 " held.", __FILE__, __LINE__, count - held, redis->name, held);
+        }
+
+    return(held);
+
+}
+
+/****************************************************************************
+ * Redis_Batch_Send - Write out the batch.  Events that weren't written are
+ * packed back down to the start of the batch,  still in order.
+ ****************************************************************************/
+
+static void Redis_Batch_Send( struct _Redis_Output *redis )
+{
+
+    uint16_t i = 0;
+    uint16_t j = 0;
+    uint32_t held = 0;
+    size_t len = 0;
+    char *item = NULL;
+
+    /* The buffer may have moved while growing,  so turn offsets into
+       pointers only now */
+
+    for ( i = 0; i < redis->batch_count; i++ )
+        {
+            redis->batch_item[i] = redis->batch_data + redis->batch_offset[i];
+        }
+
+    held = Redis_Output_Send( redis, redis->batch_item, redis->batch_count );
+
+    /* The held events are in buffer order,  so each moves down (or stays) */
+
+    redis->batch_len = 0;
+
+    for ( i = 0; i < held; i++ )
+        {
+
+            item = redis->batch_item[i];
+
+            while ( redis->batch_data + redis->batch_offset[j] != item )
+                {
+                    j++;
+                }
+
+            len = strlen(item) + 1;
+            len += strlen(item + len) + 1;
+            len += strlen(item + len) + 1;
+            len += strlen(item + len) + 1;
+
+            memmove(redis->batch_data + redis->batch_len, item, len);
+
+            redis->batch_offset[i] = redis->batch_len;
+            redis->batch_position[i] = redis->batch_position[j++];
+            redis->batch_len += len;
+
+        }
+
+    redis->batch_count = held;
+
+    if ( redis->debug )
+        {
+            Meer_Log(WARN, "[%s, line %d] Wrote out Redis batch!", __FILE__, __LINE__);
+        }
+
+}
+
+void JSON_To_Redis ( struct _Redis_Output *redis, const char *json_string, const char *key, const char *flow_id, uint64_t position )
+{
+
+    char tk1[128] = { 0 };
+    char tk2[131] = { 0 };
+
+    size_t key_len = 0;
+    size_t flow_id_len = strlen(flow_id) + 1;
+    size_t json_len = strlen(json_string) + 1;
+    size_t event_type_len = strlen(key) + 1;
+
+    if ( redis->key[0] != '\0' )
+        {
+            strlcpy(tk1, redis->key, MAX_REDIS_KEY_SIZE);
+        }
+    else
+        {
+            strlcpy(tk1, key, MAX_REDIS_KEY_SIZE);
+        }
+
+    strlcpy(tk2, tk1, sizeof(tk2));
+
+    if ( redis->append_id == true )
+        {
+
+            snprintf(tk2, sizeof(tk2), "%s|%s|%s|%" PRIu64 "", tk1, MeerConfig->hostname, MeerConfig->interface, position);
+            tk2[ sizeof(tk2) - 1 ] = '\0';
+
+        }
+
+    key_len = strlen(tk2) + 1;
+
+    /* The batch is full of events held for down shards.  With a breaker,
+       fail the write so the breaker opens and the spill holds the events
+       until the shards are back.  Without one,  waiting is all there is. */
+
+    while ( redis->batch_count == redis->batch )
+        {
+
+            Redis_Batch_Send( redis );
+
+            if ( redis->batch_count != redis->batch )
+                {
+                    break;
+                }
+
+            if ( redis->worker.breaker_failures != 0 )
                 {
-                    Meer_Log(WARN, "[%s, line %d] Wrote out Redis batch!", __FILE__, __LINE__);
+                    Output_Queue_Failed();
+                    return;
                 }
 
+            sleep(1);
+
+        }
+
+    /* Grow the batch buffer if needed */
+
+    if ( redis->batch_len + key_len + flow_id_len + json_len + event_type_len > redis->batch_size )
+        {
+
+            while ( redis->batch_len + key_len + flow_id_len + json_len + event_type_len > redis->batch_size )
+                {
+                    redis->batch_size *= 2;
+                }
+
+            redis->batch_data = realloc( redis->batch_data, redis->batch_size );
+
+            if ( redis->batch_data == NULL )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Failed to reallocate memory for Redis output '%s' batch. Abort!", __FILE__, __LINE__, redis->name);
+                }
+        }
+
+    /* Write request to Redis queue */
+
+    redis->batch_offset[redis->batch_count] = redis->batch_len;
+    redis->batch_position[redis->batch_count] = position;
+
+    memcpy(redis->batch_data + redis->batch_len, tk2, key_len);
+    redis->batch_len += key_len;
+
+    memcpy(redis->batch_data + redis->batch_len, flow_id, flow_id_len);
+    redis->batch_len += flow_id_len;
+
+    memcpy(redis->batch_data + redis->batch_len, json_string, json_len);
+    redis->batch_len += json_len;
+
+    memcpy(redis->batch_data + redis->batch_len, key, event_type_len);
+    redis->batch_len += event_type_len;
+
+    redis->batch_count++;
+
+    /* See if Redis queue needs to be written */
+
+    if ( redis->batch_count == redis->batch )
+        {
+            Redis_Batch_Send( redis );
         }
 
 }
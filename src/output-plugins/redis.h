@@ -19,10 +19,89 @@
 
 #define		REDIS_PUBSUB	1
 
-void Redis_Init ( void );
-void Redis_Close ( void );
-void Redis_Connect( void );
+/* One "redis" block from meer.yaml.  Each has its own servers,  routing,
+   batch and worker.  The plain "redis" block also holds the connection
+   fingerprinting and client_stats use (see Redis_Connect()). */
+
+struct _Redis_Output
+{
+    char name[64];			/* "redis",  "redis-archive",  etc */
+
+    bool enabled;
+    bool debug;
+    char server[255];
+    uint16_t port;
+    char password[255];
+    char key[128];
+    char command[16];
+    bool append_id;
+    bool stream;				/* XADD rather than "command" */
+    uint32_t stream_maxlen;			/* 0 == don't trim */
+    uint16_t batch;
+
+    char shard_server[REDIS_MAX_SHARDS][255];
+    uint16_t shard_port[REDIS_MAX_SHARDS];
+    uint8_t shard_count;			/* 0 == only "server" */
+    bool shard_by_key;				/* Default is by flow_id */
+
+    struct _Output_Queue_Config worker;
+
+    bool alert;
+    bool files;
+    bool flow;
+    bool dns;
+    bool http;
+    bool tls;
+    bool ssh;
+    bool smtp;
+    bool email;
+    bool fileinfo;
+    bool dhcp;
+    bool stats;
+    bool rdp;
+    bool sip;
+    bool ftp;
+    bool ikev2;
+    bool nfs;
+    bool tftp;
+    bool smb;
+    bool mqtt;
+    bool dcerpc;
+    bool netflow;
+    bool metadata;
+    bool dnp3;
+    bool anomaly;
+    bool fingerprint;
+    bool client_stats;
+
+    /* Run time,  owned by the output's worker (see redis.c) */
+
+    struct _Output_Queue *output_queue;
+
+    char *batch_data;			/* "key\0flow_id\0json\0event_type\0" ... */
+    size_t batch_size;
+    size_t batch_len;
+    uint16_t batch_count;
+    size_t *batch_offset;
+    uint64_t *batch_position;
+    char **batch_item;
+
+    struct _Redis_Shard *shards;
+    uint8_t shards_count;
+    struct _Redis_Ring_Point *ring;
+    uint32_t ring_count;
+    uint8_t *item_shard;		/* Shard for each event being sent */
+};
+
+void Redis_Output_Defaults( struct _Redis_Output *redis );
+void Redis_Init ( struct _Redis_Output *redis );
+void Redis_Close ( struct _Redis_Output *redis );
+void Redis_Flush ( struct _Redis_Output *redis );
+void Redis_Connect( uint8_t role );
+redisContext *Redis_Connect_Context( const char *name, const char *server, uint16_t port, const char *password );
 void Redis_Reader ( char *redis_command, char *str, size_t size );
 bool Redis_Writer ( const char *command, const char *key, const char *value, int expire );
-void JSON_To_Redis ( const char *json_string, const char *key );
-
+bool Redis_Pipeline_Append( uint8_t role, const char *format, ... );
+redisReply *Redis_Pipeline_Reply( uint8_t role );
+void Redis_Pipeline_Flush( uint8_t role );
+void JSON_To_Redis ( struct _Redis_Output *redis, const char *json_string, const char *key, const char *flow_id, uint64_t position );
@@ -0,0 +1,1350 @@
+/*
+** Copyright (C) 2018-2023 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2023 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* Each output gets its own bounded queue and worker thread,  so a slow or
+   failed output (Elasticsearch down,  a stalled pipe reader) only backs up
+   its own queue.  The decode thread makes one copy of an event and puts it
+   on every queue.
+
+   Each queue has a circuit breaker.  "breaker_failures" failed writes in a
+   row,  or one write stuck for longer than "breaker_timeout" ms,  open it.
+   While open,  events for that output are shed rather than queued.  After
+   "breaker_cooldown" ms the next write is a trial.  If it works,  the
+   breaker closes.
+
+   With a "spill_directory",  events aren't shed or dropped.  When the
+   breaker is open,  or the queue has been full for "spill_deadline" ms,
+   the queue and everything after it are appended to segment files in that
+   directory instead.  The decode thread never waits on the output.  Once
+   the output is working again the worker replays the segments in order,
+   deleting each one as it finishes,  before it goes back to the queue.
+   Segments left when Meer stops are replayed on the next start. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "meer-def.h"
+#include "meer.h"
+#include "util.h"
+#include "lockfile.h"
+#include "output-queue.h"
+
+extern struct _MeerWaldo *MeerWaldo;
+
+static struct _Output_Queue **output_queues = NULL;
+static uint8_t output_queue_count = 0;
+
+static bool output_queue_stop = false;
+static uint_fast16_t output_queue_running = 0;		/* Workers still going */
+
+static bool output_queue_keep_raw = false;			/* Set by Output_Queue_Keep_Raw() */
+static __thread bool output_queue_write_failed = false;	/* Set by Output_Queue_Failed() */
+
+/****************************************************************************
+ * Output_Queue_Defaults - Queue and breaker settings before meer.yaml is
+ * applied.
+ ****************************************************************************/
+
+void Output_Queue_Defaults( struct _Output_Queue_Config *config )
+{
+
+    config->size = OUTPUT_QUEUE_DEFAULT;
+    config->full = OUTPUT_QUEUE_BLOCK;
+    config->breaker_failures = OUTPUT_BREAKER_FAILURES_DEFAULT;
+    config->breaker_timeout = OUTPUT_BREAKER_TIMEOUT_DEFAULT;
+    config->breaker_cooldown = OUTPUT_BREAKER_COOLDOWN_DEFAULT;
+
+    config->spill[0] = '\0';
+    config->spill_max = OUTPUT_SPILL_MAX_DEFAULT;
+    config->spill_segment = OUTPUT_SPILL_SEGMENT_DEFAULT;
+    config->spill_deadline = OUTPUT_SPILL_DEADLINE_DEFAULT;
+
+}
+
+/****************************************************************************
+ * Output_Event_New - Copy an event for the output queues.  The strings are
+ * in the same allocation.  "raw" is the line before enrichment,  NULL if it
+ * is the same as "json_string" or isn't needed.
+ ****************************************************************************/
+
+struct _Output_Event *Output_Event_New( const char *json_string, const char *event_type, const char *flow_id, const char *id, const char *raw )
+{
+
+    struct _Output_Event *event = NULL;
+    char *ptr = NULL;
+
+    size_t json_len = strlen(json_string) + 1;
+    size_t type_len = strlen(event_type) + 1;
+    size_t flow_id_len = ( flow_id != NULL ? strlen(flow_id) + 1 : 0 );
+    size_t id_len = ( id != NULL ? strlen(id) + 1 : 0 );
+    size_t raw_len = ( raw != NULL ? strlen(raw) + 1 : 0 );
+
+    event = malloc( sizeof(struct _Output_Event) + json_len + type_len + flow_id_len + id_len + raw_len );
+
+    if ( event == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for an output event. Abort!", __FILE__, __LINE__);
+        }
+
+    event->refs = 1;
+    event->position = 0;
+
+    ptr = event->data;
+
+    memcpy(ptr, json_string, json_len);
+    event->json_string = ptr;
+    ptr += json_len;
+
+    memcpy(ptr, event_type, type_len);
+    event->event_type = ptr;
+    ptr += type_len;
+
+    event->flow_id = NULL;
+
+    if ( flow_id != NULL )
+        {
+            memcpy(ptr, flow_id, flow_id_len);
+            event->flow_id = ptr;
+            ptr += flow_id_len;
+        }
+
+    event->id = NULL;
+
+    if ( id != NULL )
+        {
+            memcpy(ptr, id, id_len);
+            event->id = ptr;
+            ptr += id_len;
+        }
+
+    event->raw = NULL;
+
+    if ( raw != NULL )
+        {
+            memcpy(ptr, raw, raw_len);
+            event->raw = ptr;
+        }
+
+    return(event);
+
+}
+
+/****************************************************************************
+ * Output_Event_Release - Drop a reference.  The last one frees the event.
+ ****************************************************************************/
+
+void Output_Event_Release( struct _Output_Event *event )
+{
+
+    if ( __atomic_sub_fetch(&event->refs, 1, __ATOMIC_ACQ_REL) == 0 )
+        {
+            free(event);
+        }
+
+}
+
+/****************************************************************************
+ * Output_Queue_Trip - Open a queue's breaker.  queue->mutex must be held.
+ ****************************************************************************/
+
+static void Output_Queue_Trip( struct _Output_Queue *queue, const char *reason )
+{
+
+    queue->state = OUTPUT_BREAKER_OPEN;
+    queue->open_until = Current_Epoch_Ms() + queue->config->breaker_cooldown;
+    queue->trips++;
+
+    Meer_Log(WARN, "Output '%s' circuit breaker open (%s).  Its events are %s for %" PRIu32 " ms.", queue->name, reason,
+             queue->config->spill[0] != '\0' ? "spilled" : "shed", queue->config->breaker_cooldown);
+
+}
+
+/****************************************************************************
+ * Output_Queue_Result - Account for one write.  queue->mutex must be held.
+ ****************************************************************************/
+
+static void Output_Queue_Result( struct _Output_Queue *queue, bool routed, bool failed )
+{
+
+    if ( failed == true )
+        {
+
+            queue->failed++;
+            queue->failures++;
+
+            if ( queue->config->breaker_failures != 0 && queue->state != OUTPUT_BREAKER_OPEN &&
+                    ( queue->state == OUTPUT_BREAKER_HALF_OPEN || queue->failures >= queue->config->breaker_failures ) )
+                {
+                    Output_Queue_Trip( queue, "writes failing" );
+                }
+
+            return;
+
+        }
+
+    /* An event the output doesn't route says nothing about its health */
+
+    if ( routed == false )
+        {
+            return;
+        }
+
+    queue->written++;
+    queue->failures = 0;
+
+    if ( queue->state != OUTPUT_BREAKER_CLOSED )
+        {
+            queue->state = OUTPUT_BREAKER_CLOSED;
+            Meer_Log(NORMAL, "Output '%s' circuit breaker closed.  Writes are working again.", queue->name);
+        }
+
+}
+
+/****************************************************************************
+ * Output_Spill_Path - The file name of one of a queue's spill segments.
+ ****************************************************************************/
+
+static void Output_Spill_Path( struct _Output_Queue *queue, uint32_t seq, char *path, size_t size )
+{
+    snprintf(path, size, "%s/%s.%010" PRIu32 ".spill", queue->config->spill, queue->name, seq);
+}
+
+/****************************************************************************
+ * Output_Spill_Init - Check the spill directory and pick up segments a
+ * previous run didn't get to replay.  They go out before anything new.
+ ****************************************************************************/
+
+static void Output_Spill_Init( struct _Output_Queue *queue )
+{
+
+    DIR *dir = NULL;
+    struct dirent *entry = NULL;
+    struct stat st;
+
+    char path[512] = { 0 };
+    char *end = NULL;
+
+    size_t name_len = strlen(queue->name);
+    size_t len = 0;
+    uint32_t seq = 0;
+    uint32_t first = UINT32_MAX;
+    uint32_t last = 0;
+
+    if ( access(queue->config->spill, W_OK) != 0 )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Output '%s' cannot write to its spill directory '%s'. %s", __FILE__, __LINE__, queue->name, queue->config->spill, strerror(errno));
+        }
+
+    if ( ( dir = opendir(queue->config->spill) ) == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Cannot open spill directory '%s'. %s", __FILE__, __LINE__, queue->config->spill, strerror(errno));
+        }
+
+    /* "<name>.<seq>.spill" */
+
+    while ( ( entry = readdir(dir) ) != NULL )
+        {
+
+            len = strlen(entry->d_name);
+
+            if ( len != name_len + 17 || strncmp(entry->d_name, queue->name, name_len) ||
+                    entry->d_name[name_len] != '.' || strcmp(entry->d_name + name_len + 11, ".spill") )
+                {
+                    continue;
+                }
+
+            seq = strtoul(entry->d_name + name_len + 1, &end, 10);
+
+            if ( end != entry->d_name + name_len + 11 )
+                {
+                    continue;
+                }
+
+            snprintf(path, sizeof(path), "%s/%s", queue->config->spill, entry->d_name);
+
+            if ( stat(path, &st) != 0 )
+                {
+                    continue;
+                }
+
+            queue->spill_bytes += st.st_size;
+            queue->spill_segments++;
+
+            first = ( seq < first ? seq : first );
+            last = ( seq > last ? seq : last );
+
+        }
+
+    closedir(dir);
+
+    queue->spill_read_seq = 1;
+    queue->spill_write_seq = 1;
+
+    if ( queue->spill_segments != 0 )
+        {
+
+            queue->spill_read_seq = first;
+            queue->spill_write_seq = last + 1;
+            queue->spilling = true;
+
+            Meer_Log(NORMAL, "Output '%s' has %" PRIu64 " bytes in %" PRIu32 " spill segments to replay.", queue->name, queue->spill_bytes, queue->spill_segments);
+
+        }
+
+}
+
+/****************************************************************************
+ * Output_Spill_Append - Write one event to the end of the spill.  Once
+ * anything is spilled,  new events follow it to disk until it has all been
+ * replayed,  so the output still sees them in order.  queue->mutex must be
+ * held.
+ ****************************************************************************/
+
+static void Output_Spill_Append( struct _Output_Queue *queue, struct _Output_Event *event )
+{
+
+    struct _Output_Spill_Record record;
+    char path[512] = { 0 };
+    size_t size = 0;
+
+    queue->spilling = true;
+
+    memset(&record, 0, sizeof(record));
+
+    record.position = event->position;
+    record.json_len = strlen(event->json_string);
+    record.event_type_len = strlen(event->event_type);
+    record.flow_id_len = ( event->flow_id != NULL ? strlen(event->flow_id) : 0 );
+    record.id_len = ( event->id != NULL ? strlen(event->id) : 0 );
+    record.raw_len = ( event->raw != NULL ? strlen(event->raw) : 0 );
+
+    size = sizeof(record) + record.json_len + record.event_type_len + record.flow_id_len + record.id_len + record.raw_len;
+
+    if ( queue->spill_bytes + size > queue->config->spill_max )
+        {
+
+            queue->spill_dropped++;
+
+            if ( queue->spill_full_logged == false )
+                {
+                    Meer_Log(WARN, "Output '%s' spill is full (%" PRIu64 " bytes).  New events are dropped until it is replayed.", queue->name, queue->spill_bytes);
+                    queue->spill_full_logged = true;
+                }
+
+            return;
+        }
+
+    /* Start a new segment once this one is big enough.  Finished segments
+       are deleted as soon as they are replayed. */
+
+    if ( queue->spill_write != NULL && queue->spill_write_size + size > queue->config->spill_segment )
+        {
+            fclose(queue->spill_write);
+            queue->spill_write = NULL;
+            queue->spill_write_seq++;
+        }
+
+    if ( queue->spill_write == NULL )
+        {
+
+            Output_Spill_Path( queue, queue->spill_write_seq, path, sizeof(path) );
+
+            if ( ( queue->spill_write = fopen(path, "w") ) == NULL )
+                {
+                    Meer_Log(WARN, "Output '%s' cannot open spill segment '%s'. %s", queue->name, path, strerror(errno));
+                    queue->spill_dropped++;
+                    return;
+                }
+
+            queue->spill_write_size = 0;
+            queue->spill_segments++;
+
+        }
+
+    if ( fwrite(&record, sizeof(record), 1, queue->spill_write) != 1 ||
+            fwrite(event->json_string, record.json_len, 1, queue->spill_write) != 1 ||
+            fwrite(event->event_type, record.event_type_len, 1, queue->spill_write) != 1 ||
+            ( record.flow_id_len != 0 && fwrite(event->flow_id, record.flow_id_len, 1, queue->spill_write) != 1 ) ||
+            ( record.id_len != 0 && fwrite(event->id, record.id_len, 1, queue->spill_write) != 1 ) ||
+            ( record.raw_len != 0 && fwrite(event->raw, record.raw_len, 1, queue->spill_write) != 1 ) )
+        {
+
+            Meer_Log(WARN, "Output '%s' could not write its spill segment. %s", queue->name, strerror(errno));
+            queue->spill_dropped++;
+
+            /* Cut the segment back to its last whole record and start a new
+               one with the next event */
+
+            Output_Spill_Path( queue, queue->spill_write_seq, path, sizeof(path) );
+
+            fclose(queue->spill_write);
+            queue->spill_write = NULL;
+
+            if ( truncate(path, queue->spill_write_size) != 0 )
+                {
+                    Meer_Log(WARN, "Output '%s' could not truncate '%s'. %s", queue->name, path, strerror(errno));
+                }
+
+            queue->spill_write_seq++;
+            return;
+        }
+
+    queue->spill_write_size += size;
+    queue->spill_bytes += size;
+    queue->spilled++;
+
+}
+
+/****************************************************************************
+ * Output_Spill_Queue - Move what is queued in memory to the spill.  Those
+ * events are older than anything pushed after them,  so they go first.
+ * queue->mutex must be held.
+ ****************************************************************************/
+
+static void Output_Spill_Queue( struct _Output_Queue *queue )
+{
+
+    while ( queue->count != 0 )
+        {
+
+            Output_Spill_Append( queue, queue->events[queue->head] );
+            Output_Event_Release( queue->events[queue->head] );
+
+            queue->head = ( queue->head + 1 ) % queue->config->size;
+            queue->count--;
+
+        }
+
+    pthread_cond_broadcast(&queue->space);
+
+}
+
+/****************************************************************************
+ * Output_Spill_Read - One event from a spill segment,  or NULL if a whole
+ * record isn't there before "limit".
+ ****************************************************************************/
+
+static struct _Output_Event *Output_Spill_Read( FILE *fd, uint64_t *offset, uint64_t limit )
+{
+
+    struct _Output_Spill_Record record;
+    struct _Output_Event *event = NULL;
+    char *ptr = NULL;
+    size_t size = 0;
+
+    if ( *offset + sizeof(record) > limit || fread(&record, sizeof(record), 1, fd) != 1 )
+        {
+            return(NULL);
+        }
+
+    size = record.json_len + record.event_type_len + record.flow_id_len + record.id_len + record.raw_len;
+
+    if ( *offset + sizeof(record) + size > limit )
+        {
+            return(NULL);
+        }
+
+    event = malloc( sizeof(struct _Output_Event) + size + 5 );
+
+    if ( event == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for an output event. Abort!", __FILE__, __LINE__);
+        }
+
+    event->refs = 1;
+    event->position = record.position;
+    event->flow_id = NULL;
+    event->id = NULL;
+    event->raw = NULL;
+
+    ptr = event->data;
+
+    if ( fread(ptr, size, 1, fd) != 1 )
+        {
+            free(event);
+            return(NULL);
+        }
+
+    /* Move the strings apart to make room for their NULs,  last first */
+
+    memmove(ptr + record.json_len + record.event_type_len + record.flow_id_len + record.id_len + 4, ptr + record.json_len + record.event_type_len + record.flow_id_len + record.id_len, record.raw_len);
+    memmove(ptr + record.json_len + record.event_type_len + record.flow_id_len + 3, ptr + record.json_len + record.event_type_len + record.flow_id_len, record.id_len);
+    memmove(ptr + record.json_len + record.event_type_len + 2, ptr + record.json_len + record.event_type_len, record.flow_id_len);
+    memmove(ptr + record.json_len + 1, ptr + record.json_len, record.event_type_len);
+
+    event->json_string = ptr;
+    ptr[record.json_len] = '\0';
+    ptr += record.json_len + 1;
+
+    event->event_type = ptr;
+    ptr[record.event_type_len] = '\0';
+    ptr += record.event_type_len + 1;
+
+    if ( record.flow_id_len != 0 )
+        {
+            event->flow_id = ptr;
+        }
+
+    ptr[record.flow_id_len] = '\0';
+    ptr += record.flow_id_len + 1;
+
+    if ( record.id_len != 0 )
+        {
+            event->id = ptr;
+        }
+
+    ptr[record.id_len] = '\0';
+    ptr += record.id_len + 1;
+
+    if ( record.raw_len != 0 )
+        {
+            event->raw = ptr;
+        }
+
+    ptr[record.raw_len] = '\0';
+
+    *offset += sizeof(record) + size;
+
+    return(event);
+
+}
+
+/****************************************************************************
+ * Output_Spill_Next - The oldest spilled event,  or NULL once the spill is
+ * empty.  Worker only.
+ ****************************************************************************/
+
+static struct _Output_Event *Output_Spill_Next( struct _Output_Queue *queue )
+{
+
+    struct _Output_Event *event = NULL;
+    struct stat st;
+
+    char path[512] = { 0 };
+    uint64_t limit = 0;
+    bool finished = false;
+
+    while ( true )
+        {
+
+            pthread_mutex_lock(&queue->mutex);
+
+            /* The segment being written can only be read as far as it has
+               been flushed */
+
+            finished = ( queue->spill_read_seq != queue->spill_write_seq );
+
+            if ( finished == false )
+                {
+
+                    if ( queue->spill_write == NULL )
+                        {
+                            queue->spilling = false;		/* Nothing was written */
+                            pthread_mutex_unlock(&queue->mutex);
+                            return(NULL);
+                        }
+
+                    fflush(queue->spill_write);
+                    limit = queue->spill_write_size;
+
+                }
+
+            pthread_mutex_unlock(&queue->mutex);
+
+            Output_Spill_Path( queue, queue->spill_read_seq, path, sizeof(path) );
+
+            if ( queue->spill_read == NULL )
+                {
+
+                    queue->spill_read = fopen(path, "r");
+                    queue->spill_read_offset = 0;
+                    queue->spill_read_size = 0;
+
+                    if ( queue->spill_read != NULL && fstat(fileno(queue->spill_read), &st) == 0 )
+                        {
+                            queue->spill_read_size = st.st_size;
+                        }
+
+                }
+
+            if ( finished == true )
+                {
+                    limit = queue->spill_read_size;
+                }
+
+            if ( queue->spill_read != NULL )
+                {
+
+                    clearerr(queue->spill_read);
+
+                    queue->spill_read_start = queue->spill_read_offset;
+                    event = Output_Spill_Read( queue->spill_read, &queue->spill_read_offset, limit );
+
+                    if ( event != NULL )
+                        {
+                            return(event);
+                        }
+
+                }
+
+            /* Nothing more in the segment being written.  Check again with
+               the lock held.  If it is still caught up,  the spill is empty
+               and new events can use the queue again. */
+
+            if ( finished == false )
+                {
+
+                    pthread_mutex_lock(&queue->mutex);
+
+                    fflush(queue->spill_write);
+
+                    if ( queue->spill_read_seq != queue->spill_write_seq || queue->spill_write_size != queue->spill_read_offset )
+                        {
+                            pthread_mutex_unlock(&queue->mutex);
+                            continue;
+                        }
+
+                    fclose(queue->spill_write);
+                    queue->spill_write = NULL;
+
+                    if ( queue->spill_read != NULL )
+                        {
+                            fclose(queue->spill_read);
+                            queue->spill_read = NULL;
+                        }
+
+                    unlink(path);
+
+                    queue->spill_write_seq++;
+                    queue->spill_read_seq = queue->spill_write_seq;
+                    queue->spill_bytes = 0;
+                    queue->spill_segments = 0;
+                    queue->spilling = false;
+                    queue->spill_full_logged = false;
+
+                    pthread_mutex_unlock(&queue->mutex);
+
+                    Meer_Log(NORMAL, "Output '%s' spill replayed.", queue->name);
+
+                    return(NULL);
+
+                }
+
+            /* A finished segment is done.  Anything left over is a record
+               cut short when Meer stopped. */
+
+            if ( queue->spill_read_offset < queue->spill_read_size )
+                {
+                    Meer_Log(WARN, "Output '%s' spill segment '%s' ends in a partial record.  It was skipped.", queue->name, path);
+                }
+
+            if ( queue->spill_read != NULL )
+                {
+                    fclose(queue->spill_read);
+                    queue->spill_read = NULL;
+                }
+
+            unlink(path);
+
+            pthread_mutex_lock(&queue->mutex);
+
+            queue->spill_bytes -= ( queue->spill_read_size < queue->spill_bytes ? queue->spill_read_size : queue->spill_bytes );
+
+            if ( queue->spill_segments != 0 )
+                {
+                    queue->spill_segments--;
+                }
+
+            queue->spill_read_seq++;
+
+            pthread_mutex_unlock(&queue->mutex);
+
+        }
+
+}
+
+/****************************************************************************
+ * Output_Spill_Rewind - Put the event Output_Spill_Next() just returned
+ * back,  so it is read again.  Used when writing it failed.
+ ****************************************************************************/
+
+static void Output_Spill_Rewind( struct _Output_Queue *queue )
+{
+
+    if ( queue->spill_read == NULL || fseeko(queue->spill_read, (off_t)queue->spill_read_start, SEEK_SET) != 0 )
+        {
+            Meer_Log(WARN, "Output '%s' could not rewind its spill.  An event that failed to write was lost.", queue->name);
+            return;
+        }
+
+    queue->spill_read_offset = queue->spill_read_start;
+
+}
+
+/****************************************************************************
+ * Output_Queue_Worker - Feed one output from its queue.
+ ****************************************************************************/
+
+static void *Output_Queue_Worker( void *arg )
+{
+
+    struct _Output_Queue *queue = (struct _Output_Queue *)arg;
+    struct _Output_Event *event = NULL;
+    struct _Output_Event *retry = NULL;		/* Failed,  goes again first */
+    struct timespec wait_time;
+
+    uint64_t now = 0;
+    uint64_t due = 0;
+    uint64_t started = 0;
+    bool routed = false;
+    bool failed = false;
+    bool idle = false;
+    bool spill = ( queue->config->spill[0] != '\0' );
+    bool from_spill = false;
+
+    while ( true )
+        {
+
+            pthread_mutex_lock(&queue->mutex);
+
+            /* Wake at least once a second to notice a shutdown.  What is
+               already queued is still written.  The spill is left on disk
+               for the next start. */
+
+            while ( __atomic_load_n(&output_queue_stop, __ATOMIC_SEQ_CST) == false )
+                {
+
+                    now = Current_Epoch_Ms();
+                    due = now + 1000;
+
+                    if ( queue->count != 0 && retry == NULL )
+                        {
+                            break;
+                        }
+
+                    /* Spilled and failed events wait for the breaker's
+                       cool down */
+
+                    if ( queue->spilling == true || retry != NULL )
+                        {
+
+                            if ( queue->state != OUTPUT_BREAKER_OPEN || now >= queue->open_until )
+                                {
+                                    break;
+                                }
+
+                            due = ( queue->open_until < due ? queue->open_until : due );
+
+                        }
+
+                    wait_time.tv_sec = due / 1000;
+                    wait_time.tv_nsec = ( due % 1000 ) * 1000000;
+
+                    pthread_cond_timedwait(&queue->work, &queue->mutex, &wait_time);
+                }
+
+            if ( retry == NULL && queue->count == 0 && ( queue->spilling == false || __atomic_load_n(&output_queue_stop, __ATOMIC_SEQ_CST) == true ) )
+                {
+                    pthread_mutex_unlock(&queue->mutex);
+                    break;		/* Shutting down and nothing left */
+                }
+
+            from_spill = ( retry == NULL && queue->count == 0 );
+
+            if ( retry != NULL )
+                {
+                    event = retry;
+                    retry = NULL;
+                }
+
+            else if ( from_spill == false )
+                {
+
+                    event = queue->events[queue->head];
+                    queue->head = ( queue->head + 1 ) % queue->config->size;
+                    queue->count--;
+
+                    pthread_cond_signal(&queue->space);
+
+                }
+
+            else
+                {
+
+                    pthread_mutex_unlock(&queue->mutex);
+
+                    if ( ( event = Output_Spill_Next( queue ) ) == NULL )
+                        {
+                            continue;		/* Replayed,  back to the queue */
+                        }
+
+                    pthread_mutex_lock(&queue->mutex);
+
+                }
+
+            /* While the breaker is open,  don't feed a sink that is failing */
+
+            started = Current_Epoch_Ms();
+
+            if ( queue->state == OUTPUT_BREAKER_OPEN )
+                {
+
+                    if ( started < queue->open_until && from_spill == false )
+                        {
+
+                            /* Nothing has been spilled while there was a
+                               queue,  so this event and the queue go first */
+
+                            if ( spill == true )
+                                {
+                                    Output_Spill_Append( queue, event );
+                                    Output_Spill_Queue( queue );
+                                }
+
+                            else
+                                {
+                                    queue->shed++;
+                                }
+
+                            pthread_mutex_unlock(&queue->mutex);
+
+                            Output_Event_Release( event );
+                            continue;
+                        }
+
+                    queue->state = OUTPUT_BREAKER_HALF_OPEN;
+
+                }
+
+            queue->write_started = started;
+
+            pthread_mutex_unlock(&queue->mutex);
+
+            output_queue_write_failed = false;
+
+            routed = queue->ops->write( queue->ctx, event );
+
+            now = Current_Epoch_Ms();
+
+            failed = ( output_queue_write_failed == true ||
+                       ( queue->config->breaker_timeout != 0 && now - started >= queue->config->breaker_timeout ) );
+
+            pthread_mutex_lock(&queue->mutex);
+
+            queue->write_started = 0;
+            Output_Queue_Result( queue, routed, failed );
+
+            /* Keep an event that failed.  It is written again,  ahead of
+               anything newer,  once the breaker allows.  Without a breaker
+               nothing would stop it being retried forever,  so it is let
+               go as before. */
+
+            if ( failed == true && queue->config->breaker_failures != 0 )
+                {
+
+                    if ( from_spill == true )
+                        {
+                            Output_Spill_Rewind( queue );
+                            Output_Event_Release( event );
+                        }
+
+                    else if ( __atomic_load_n(&output_queue_stop, __ATOMIC_SEQ_CST) == false )
+                        {
+                            retry = event;
+                        }
+
+                    /* Shutting down.  The spill is the only place left
+                       for it. */
+
+                    else
+                        {
+
+                            if ( spill == true )
+                                {
+                                    Output_Spill_Append( queue, event );
+                                }
+
+                            else
+                                {
+                                    queue->shed++;
+                                }
+
+                            Output_Event_Release( event );
+
+                        }
+
+                }
+
+            else
+                {
+
+                    if ( from_spill == true && failed == false )
+                        {
+                            queue->replayed++;
+                        }
+
+                    Output_Event_Release( event );
+
+                }
+
+            idle = ( queue->count == 0 && queue->spilling == false && retry == NULL );
+
+            pthread_mutex_unlock(&queue->mutex);
+
+            if ( idle == true && queue->ops->flush != NULL )
+                {
+                    queue->ops->flush( queue->ctx );
+                }
+
+        }
+
+    if ( queue->ops->flush != NULL )
+        {
+            queue->ops->flush( queue->ctx );
+        }
+
+    if ( queue->ops->shutdown != NULL )
+        {
+            queue->ops->shutdown( queue->ctx );
+        }
+
+    if ( spill == true )
+        {
+
+            pthread_mutex_lock(&queue->mutex);
+
+            /* Anything spilled after this,  by an output still finishing
+               its batches,  goes in a new segment */
+
+            if ( queue->spill_write != NULL )
+                {
+                    fclose(queue->spill_write);
+                    queue->spill_write = NULL;
+                    queue->spill_write_seq++;
+                }
+
+            if ( queue->spill_bytes != 0 )
+                {
+                    Meer_Log(NORMAL, "Output '%s' left %" PRIu64 " bytes in %" PRIu32 " spill segments.  They are replayed on the next start.", queue->name, queue->spill_bytes, queue->spill_segments);
+                }
+
+            pthread_mutex_unlock(&queue->mutex);
+
+        }
+
+    __atomic_sub_fetch(&output_queue_running, 1, __ATOMIC_SEQ_CST);
+
+    pthread_exit(NULL);
+
+}
+
+/****************************************************************************
+ * Output_Queue_Register - Give an output its queue and start its worker.
+ ****************************************************************************/
+
+struct _Output_Queue *Output_Queue_Register( const char *name, const struct _Output_Ops *ops, void *ctx, struct _Output_Queue_Config *config )
+{
+
+    struct _Output_Queue *queue = NULL;
+
+    pthread_t output_queue_id;
+    pthread_attr_t thread_output_queue_attr;
+    int rc = 0;
+
+    queue = calloc( 1, sizeof(struct _Output_Queue) );
+    output_queues = realloc( output_queues, ( output_queue_count + 1 ) * sizeof(struct _Output_Queue *) );
+
+    if ( queue == NULL || output_queues == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for an output queue. Abort!", __FILE__, __LINE__);
+        }
+
+    queue->events = calloc( config->size, sizeof(struct _Output_Event *) );
+
+    if ( queue->events == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for an output queue. Abort!", __FILE__, __LINE__);
+        }
+
+    strlcpy(queue->name, name, sizeof(queue->name));
+    queue->ops = ops;
+    queue->ctx = ctx;
+    queue->config = config;
+
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->work, NULL);
+    pthread_cond_init(&queue->space, NULL);
+
+    output_queues[output_queue_count++] = queue;
+
+    if ( config->spill[0] != '\0' )
+        {
+            Output_Spill_Init( queue );
+        }
+
+    if ( ops->init != NULL )
+        {
+            ops->init( ctx );
+        }
+
+    pthread_attr_init(&thread_output_queue_attr);
+    pthread_attr_setdetachstate(&thread_output_queue_attr,  PTHREAD_CREATE_DETACHED);
+
+    __atomic_add_fetch(&output_queue_running, 1, __ATOMIC_SEQ_CST);
+
+    rc = pthread_create ( &output_queue_id, &thread_output_queue_attr, Output_Queue_Worker, queue );
+
+    if ( rc != 0 )
+        {
+            Remove_Lock_File();
+            Meer_Log(ERROR, "Could not pthread_create() for the '%s' output worker [error: %d]", name, rc);
+        }
+
+    Meer_Log(NORMAL, "Output '%s' worker started.  Queue size: %" PRIu32 ".", name, config->size);
+
+    return(queue);
+
+}
+
+/****************************************************************************
+ * Output_Queue_Push - Put an event on one output's queue.  Called from the
+ * decode thread.
+ ****************************************************************************/
+
+void Output_Queue_Push( struct _Output_Queue *queue, struct _Output_Event *event )
+{
+
+    struct timespec wait_time;
+    uint64_t now = 0;
+    uint64_t due = 0;
+    uint64_t deadline = 0;
+
+    bool spill = ( queue->config->spill[0] != '\0' );
+
+    if ( __atomic_load_n(&output_queue_stop, __ATOMIC_SEQ_CST) == true )
+        {
+            return;
+        }
+
+    pthread_mutex_lock(&queue->mutex);
+
+    now = Current_Epoch_Ms();
+    deadline = now + queue->config->spill_deadline;
+
+    if ( queue->state == OUTPUT_BREAKER_OPEN && now >= queue->open_until )
+        {
+            queue->state = OUTPUT_BREAKER_HALF_OPEN;
+        }
+
+    /* Once spilling,  everything goes to disk until the worker has caught
+       up,  so events stay in order */
+
+    if ( spill == true && ( queue->spilling == true || queue->state == OUTPUT_BREAKER_OPEN ) )
+        {
+            Output_Spill_Queue( queue );
+            Output_Spill_Append( queue, event );
+
+            pthread_mutex_unlock(&queue->mutex);
+            return;
+        }
+
+    while ( queue->count == queue->config->size && queue->state != OUTPUT_BREAKER_OPEN )
+        {
+
+            if ( queue->config->full == OUTPUT_QUEUE_DROP_OLDEST && spill == false )
+                {
+
+                    Output_Event_Release( queue->events[queue->head] );
+                    queue->head = ( queue->head + 1 ) % queue->config->size;
+                    queue->count--;
+
+                    queue->dropped++;
+                    break;
+
+                }
+
+            /* Shutting down.  Nothing is woken for this,  so it is noticed
+               on the next pass. */
+
+            if ( __atomic_load_n(&output_queue_stop, __ATOMIC_SEQ_CST) == true )
+                {
+                    pthread_mutex_unlock(&queue->mutex);
+                    return;
+                }
+
+            now = Current_Epoch_Ms();
+            due = now + 1000;
+
+            /* Full for too long.  Stop waiting on the output. */
+
+            if ( spill == true )
+                {
+
+                    if ( now >= deadline )
+                        {
+                            Output_Spill_Queue( queue );
+                            Output_Spill_Append( queue, event );
+
+                            pthread_mutex_unlock(&queue->mutex);
+                            return;
+                        }
+
+                    due = ( deadline < due ? deadline : due );
+
+                }
+
+            /* "block".  If the worker is stuck in a write,  open the breaker
+               rather than hold up every other output. */
+
+            if ( queue->config->breaker_failures != 0 && queue->config->breaker_timeout != 0 && queue->write_started != 0 )
+                {
+
+                    if ( now - queue->write_started >= queue->config->breaker_timeout )
+                        {
+                            Output_Queue_Trip( queue, "write stuck" );
+                            break;
+                        }
+
+                    if ( queue->write_started + queue->config->breaker_timeout < due )
+                        {
+                            due = queue->write_started + queue->config->breaker_timeout;
+                        }
+
+                }
+
+            wait_time.tv_sec = due / 1000;
+            wait_time.tv_nsec = ( due % 1000 ) * 1000000;
+
+            pthread_cond_timedwait(&queue->space, &queue->mutex, &wait_time);
+
+        }
+
+    if ( queue->state == OUTPUT_BREAKER_OPEN )
+        {
+
+            if ( spill == true )
+                {
+                    Output_Spill_Queue( queue );
+                    Output_Spill_Append( queue, event );
+                }
+
+            else
+                {
+                    queue->shed++;
+                }
+
+            pthread_mutex_unlock(&queue->mutex);
+            return;
+        }
+
+    __atomic_add_fetch(&event->refs, 1, __ATOMIC_ACQ_REL);
+
+    queue->events[ ( queue->head + queue->count ) % queue->config->size ] = event;
+    queue->count++;
+    queue->queued++;
+
+    if ( queue->count > queue->high_water )
+        {
+            queue->high_water = queue->count;
+        }
+
+    if ( queue->count == 1 )
+        {
+            pthread_cond_signal(&queue->work);
+        }
+
+    pthread_mutex_unlock(&queue->mutex);
+
+}
+
+/****************************************************************************
+ * Output_Queue_Keep_Raw - An output needs the line as it was read (see
+ * "raw" in Output_Event_New()).  Called before the first event.
+ ****************************************************************************/
+
+void Output_Queue_Keep_Raw( void )
+{
+    output_queue_keep_raw = true;
+}
+
+/****************************************************************************
+ * Output_Queue_Event - Hand a decoded event to every output.  "raw" is the
+ * line before enrichment.
+ ****************************************************************************/
+
+void Output_Queue_Event( const char *json_string, const char *event_type, const char *flow_id, const char *raw )
+{
+
+    struct _Output_Event *event = NULL;
+    uint8_t i = 0;
+
+    if ( output_queue_count == 0 )
+        {
+            return;
+        }
+
+    if ( output_queue_keep_raw == false || raw == json_string )
+        {
+            raw = NULL;
+        }
+
+    event = Output_Event_New( json_string, event_type, flow_id, NULL, raw );
+    event->position = MeerWaldo->position;
+
+    for ( i = 0; i < output_queue_count; i++ )
+        {
+            Output_Queue_Push( output_queues[i], event );
+        }
+
+    Output_Event_Release( event );
+
+}
+
+/****************************************************************************
+ * Output_Queue_Spill - Put an event the output took,  but couldn't deliver,
+ * in its queue's spill.  For events an output still holds in a batch when
+ * Meer stops.  They are replayed on the next start.  Safe to call after
+ * the worker has exited.  Returns false if the queue has no spill.
+ ****************************************************************************/
+
+bool Output_Queue_Spill( struct _Output_Queue *queue, struct _Output_Event *event )
+{
+
+    if ( queue == NULL || queue->config->spill[0] == '\0' )
+        {
+            return(false);
+        }
+
+    pthread_mutex_lock(&queue->mutex);
+
+    Output_Spill_Append( queue, event );
+
+    if ( queue->spill_write != NULL )
+        {
+            fflush(queue->spill_write);
+        }
+
+    pthread_mutex_unlock(&queue->mutex);
+
+    return(true);
+
+}
+
+/****************************************************************************
+ * Output_Queue_Failed - Called by an output's write() when the write didn't
+ * make it.  Counts towards opening the breaker.
+ ****************************************************************************/
+
+void Output_Queue_Failed( void )
+{
+    output_queue_write_failed = true;
+}
+
+/****************************************************************************
+ * Output_Queue_Shutdown - Let the workers write what is queued and stop.
+ * Gives up after 15 seconds.  Called from Signal_Handler(),  so no queue
+ * locks are taken here.  The thread that got the signal may be holding
+ * one.  The workers and Output_Queue_Push() wake at least once a second
+ * and see "output_queue_stop" on their own.
+ ****************************************************************************/
+
+void Output_Queue_Shutdown( void )
+{
+
+    uint_fast16_t running = 0;
+    uint8_t wait = 0;
+
+    if ( output_queue_count == 0 )
+        {
+            return;
+        }
+
+    __atomic_store_n(&output_queue_stop, true, __ATOMIC_SEQ_CST);
+
+    while ( ( running = __atomic_load_n(&output_queue_running, __ATOMIC_SEQ_CST) ) != 0 )
+        {
+
+            Meer_Log(NORMAL, "Waiting on %d output workers to finish.", (int)running);
+            sleep(1);
+
+            if ( ++wait == 15 )
+                {
+                    Meer_Log(WARN, "Timemout reached!  Some queued output events were not written.");
+                    break;
+                }
+
+        }
+
+}
+
+/****************************************************************************
+ * Output_Queue_Statistics - Per output queue and breaker counters.
+ ****************************************************************************/
+
+void Output_Queue_Statistics( void )
+{
+
+    struct _Output_Queue *queue = NULL;
+    uint8_t i = 0;
+
+    const char *state[] = { "closed", "open", "half open" };
+
+    for ( i = 0; i < output_queue_count; i++ )
+        {
+
+            queue = output_queues[i];
+
+            Meer_Log(NORMAL, " - Output '%s' Statistics:", queue->name);
+            Meer_Log(NORMAL, "");
+            Meer_Log(NORMAL, " Breaker        : %s (tripped %" PRIu64 " times)", state[queue->state], queue->trips);
+            Meer_Log(NORMAL, " Queue depth    : %" PRIu32 " of %" PRIu32 " (high water %" PRIu32 ")", queue->count, queue->config->size, queue->high_water);
+            Meer_Log(NORMAL, " Queued         : %" PRIu64 "", queue->queued);
+            Meer_Log(NORMAL, " Written        : %" PRIu64 "", queue->written);
+            Meer_Log(NORMAL, " Failed writes  : %" PRIu64 "", queue->failed);
+            Meer_Log(NORMAL, " Dropped (full) : %" PRIu64 "", queue->dropped);
+            Meer_Log(NORMAL, " Shed (breaker) : %" PRIu64 "", queue->shed);
+
+            if ( queue->config->spill[0] != '\0' )
+                {
+                    Meer_Log(NORMAL, " Spilled        : %" PRIu64 "", queue->spilled);
+                    Meer_Log(NORMAL, " Replayed       : %" PRIu64 "", queue->replayed);
+                    Meer_Log(NORMAL, " Spill on disk  : %" PRIu64 " bytes in %" PRIu32 " segments", queue->spill_bytes, queue->spill_segments);
+                    Meer_Log(NORMAL, " Spill dropped  : %" PRIu64 "", queue->spill_dropped);
+                }
+
+            Meer_Log(NORMAL, "");
+
+        }
+
+}
@@ -0,0 +1,123 @@
+/*
+** Copyright (C) 2018-2023 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2023 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include <stdio.h>
+#include <pthread.h>
+
+/* An event as handed to the outputs.  One copy is shared by every output
+   queue it is on and freed when the last one is done with it. */
+
+struct _Output_Event
+{
+    uint32_t refs;			/* Queues holding it,  plus the maker */
+    uint64_t position;			/* Waldo position when decoded */
+    const char *json_string;
+    const char *event_type;
+    const char *flow_id;		/* NULL if none */
+    const char *id;			/* Elasticsearch _id,  NULL if none */
+    const char *raw;			/* The line as read,  NULL if not kept */
+    char data[];			/* The strings above */
+};
+
+/* What an output plugs into the framework.  Any of these but "write" can
+   be NULL.  "write" returns false if the output's routing doesn't take the
+   event.  A write that fails calls Output_Queue_Failed(). */
+
+struct _Output_Ops
+{
+    void (*init)( void *ctx );				/* Before the worker starts */
+    bool (*write)( void *ctx, struct _Output_Event *event );
+    void (*flush)( void *ctx );				/* The queue has drained */
+    void (*shutdown)( void *ctx );			/* The worker is exiting */
+};
+
+struct _Output_Queue
+{
+    char name[64];
+    const struct _Output_Ops *ops;
+    void *ctx;
+    struct _Output_Queue_Config *config;
+
+    struct _Output_Event **events;	/* Ring of config->size */
+    uint32_t head;
+    uint32_t count;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t work;
+    pthread_cond_t space;
+
+    uint8_t state;			/* OUTPUT_BREAKER_CLOSED, etc */
+    uint16_t failures;			/* Failed writes in a row */
+    uint64_t open_until;		/* ms,  when an open breaker is tried again */
+    uint64_t write_started;		/* ms,  0 when not in write() */
+
+    uint64_t queued;
+    uint64_t written;
+    uint64_t failed;
+    uint64_t dropped;			/* Queue full,  "drop" */
+    uint64_t shed;			/* Breaker open */
+    uint64_t trips;
+    uint32_t high_water;		/* Deepest the queue has been */
+
+    /* Spill to disk.  The write side is under "mutex",  the read side
+       belongs to the worker. */
+
+    bool spilling;			/* New events go to disk until it is replayed */
+    bool spill_full_logged;
+    FILE *spill_write;
+    uint32_t spill_write_seq;		/* Segment being written */
+    uint64_t spill_write_size;
+    FILE *spill_read;
+    uint32_t spill_read_seq;		/* Segment being replayed */
+    uint64_t spill_read_offset;
+    uint64_t spill_read_start;		/* Of the last event read */
+    uint64_t spill_read_size;		/* Of a finished segment */
+    uint64_t spill_bytes;		/* On disk */
+    uint32_t spill_segments;
+
+    uint64_t spilled;
+    uint64_t replayed;
+    uint64_t spill_dropped;		/* "spill_max" reached or write errors */
+};
+
+/* One event in a spill segment.  The strings follow,  without their NULs. */
+
+struct _Output_Spill_Record
+{
+    uint64_t position;
+    uint32_t json_len;
+    uint32_t raw_len;
+    uint16_t event_type_len;
+    uint16_t flow_id_len;
+    uint16_t id_len;
+    uint16_t pad;
+};
+
+void Output_Queue_Defaults( struct _Output_Queue_Config *config );
+struct _Output_Queue *Output_Queue_Register( const char *name, const struct _Output_Ops *ops, void *ctx, struct _Output_Queue_Config *config );
+struct _Output_Event *Output_Event_New( const char *json_string, const char *event_type, const char *flow_id, const char *id, const char *raw );
+void Output_Event_Release( struct _Output_Event *event );
+void Output_Queue_Push( struct _Output_Queue *queue, struct _Output_Event *event );
+void Output_Queue_Event( const char *json_string, const char *event_type, const char *flow_id, const char *raw );
+void Output_Queue_Keep_Raw( void );
+void Output_Queue_Failed( void );
+bool Output_Queue_Spill( struct _Output_Queue *queue, struct _Output_Event *event );
+void Output_Queue_Shutdown( void );
+void Output_Queue_Statistics( void );
@@ -41,10 +41,11 @@
 #include "meer-def.h"
 #include "util.h"
 #include "util-dns.h"
+#include "util-hash.h"
 #include "output.h"
+#include "output-queue.h"
 #include "config-yaml.h"
 
-#include "output-plugins/pipe.h"
 #include "output-plugins/external.h"
 #include "output-plugins/pipe.h"
 #include "output-plugins/file.h"
@@ -67,28 +68,159 @@
 #include "output-plugins/bluedot.h"
 #endif
 
-#ifdef WITH_ELASTICSEARCH
+extern struct _MeerOutput *MeerOutput;
+extern struct _MeerInput *MeerInput;
+extern struct _MeerConfig *MeerConfig;
+extern struct _MeerCounters *MeerCounters;
+extern struct _MeerHealth *MeerHealth;
+extern struct _Classifications *MeerClass;
+
+/****************************************************************************
+ * Output queue adapters.  Each runs on its output's own worker (see
+ * output-queue.c),  so a stalled sink only holds up itself.
+ ****************************************************************************/
+
+static bool Output_Pipe_Write( void *ctx, struct _Output_Event *event )
+{
+    return( Output_Pipe( (struct _Pipe_Output *)ctx, event->json_string, event->event_type ) );
+}
+
+static void Output_Pipe_Shutdown( void *ctx )
+{
+    close( ((struct _Pipe_Output *)ctx)->fd );
+}
+
+static const struct _Output_Ops Output_Pipe_Ops = { NULL, Output_Pipe_Write, NULL, Output_Pipe_Shutdown };
+
+/* The external program and Bluedot look inside the event,  so the worker
+   parses its own copy rather than share the decode thread's */
 
-#include <pthread.h>
-pthread_cond_t MeerElasticWork=PTHREAD_COND_INITIALIZER;
-pthread_mutex_t MeerElasticMutex=PTHREAD_MUTEX_INITIALIZER;
+static bool Output_External_Write( void *ctx, struct _Output_Event *event )
+{
+
+    struct json_object *json_obj = NULL;
+    bool ret = false;
 
-uint_fast16_t elastic_proc_msgslot = 0;
-uint_fast16_t elastic_proc_running = 0;
+    json_obj = json_tokener_parse( event->json_string );
 
-extern char *big_batch;
-extern char *big_batch_THREAD;
+    if ( json_obj == NULL )
+        {
+            Output_Queue_Failed();
+            return(false);
+        }
 
-extern uint16_t elasticsearch_batch_count;
+    ret = Output_External( event->json_string, json_obj, event->event_type );
+
+    json_object_put(json_obj);
+
+    return(ret);
+}
+
+static const struct _Output_Ops Output_External_Ops = { NULL, Output_External_Write, NULL, NULL };
+
+/* Lines are flushed when the queue drains rather than once per event */
+
+static bool Output_File_Write( void *ctx, struct _Output_Event *event )
+{
+    return( Output_File( (struct _File_Output *)ctx, event->json_string, event->event_type ) );
+}
+
+static void Output_File_Flush( void *ctx )
+{
+    fflush( ((struct _File_Output *)ctx)->fd );
+}
+
+static void Output_File_Shutdown( void *ctx )
+{
+    fflush( ((struct _File_Output *)ctx)->fd );
+    fclose( ((struct _File_Output *)ctx)->fd );
+}
+
+static const struct _Output_Ops Output_File_Ops = { NULL, Output_File_Write, Output_File_Flush, Output_File_Shutdown };
+
+#ifdef HAVE_LIBHIREDIS
+
+/* Events are batched and the batch is sent when full or when the queue
+   drains.  Only the worker uses the output's shard connections. */
+
+static bool Output_Redis_Write( void *ctx, struct _Output_Event *event )
+{
+    return( Output_Redis( (struct _Redis_Output *)ctx, event->json_string, event->event_type, event->flow_id != NULL ? event->flow_id : "", event->position ) );
+}
+
+static void Output_Redis_Flush( void *ctx )
+{
+    Redis_Flush( (struct _Redis_Output *)ctx );
+}
+
+static void Output_Redis_Shutdown( void *ctx )
+{
+    Redis_Close( (struct _Redis_Output *)ctx );
+}
+
+static const struct _Output_Ops Output_Redis_Ops = { NULL, Output_Redis_Write, Output_Redis_Flush, Output_Redis_Shutdown };
 
 #endif
 
-extern struct _MeerOutput *MeerOutput;
-extern struct _MeerInput *MeerInput;
-extern struct _MeerConfig *MeerConfig;
-extern struct _MeerCounters *MeerCounters;
-extern struct _MeerHealth *MeerHealth;
-extern struct _Classifications *MeerClass;
+#ifdef WITH_SYSLOG
+
+static bool Output_Syslog_Write( void *ctx, struct _Output_Event *event )
+{
+    return( Output_Syslog( event->json_string, event->event_type ) );
+}
+
+static const struct _Output_Ops Output_Syslog_Ops = { NULL, Output_Syslog_Write, NULL, NULL };
+
+#endif
+
+#ifdef WITH_BLUEDOT
+
+static bool Output_Bluedot_Write( void *ctx, struct _Output_Event *event )
+{
+
+    struct json_object *json_obj = NULL;
+
+    if ( strcmp(event->event_type, "alert") )
+        {
+            return(false);
+        }
+
+    json_obj = json_tokener_parse( event->json_string );
+
+    if ( json_obj == NULL )
+        {
+            Output_Queue_Failed();
+            return(false);
+        }
+
+    Output_Bluedot( json_obj );
+
+    json_object_put(json_obj);
+
+    return(true);
+}
+
+static const struct _Output_Ops Output_Bluedot_Ops = { NULL, Output_Bluedot_Write, NULL, NULL };
+
+#endif
+
+#ifdef WITH_ELASTICSEARCH
+
+static bool Output_Elasticsearch_Write( void *ctx, struct _Output_Event *event )
+{
+    return( Output_Elasticsearch_Route( (struct _Elasticsearch_Output *)ctx, event->json_string, event->event_type, event->id, event->raw ) );
+}
+
+/* Send what is left in the partial batch before the senders stop */
+
+static void Output_Elasticsearch_Shutdown( void *ctx )
+{
+    Elasticsearch_Flush( (struct _Elasticsearch_Output *)ctx );
+}
+
+static const struct _Output_Ops Output_Elasticsearch_Ops = { NULL, Output_Elasticsearch_Write, NULL, Output_Elasticsearch_Shutdown };
+
+#endif
 
 /****************************************************************************
  * Init_Output - Init output pluggins (if needed)
@@ -97,6 +229,23 @@ extern struct _Classifications *MeerClass;
 void Init_Output( void )
 {
 
+    struct _File_Output *file = NULL;
+    struct _Pipe_Output *pipe_out = NULL;
+
+#ifdef HAVE_LIBHIREDIS
+
+    struct _Redis_Output *redis = NULL;
+
+#endif
+
+#ifdef WITH_ELASTICSEARCH
+
+    struct _Elasticsearch_Output *es = NULL;
+
+#endif
+
+    uint8_t i = 0;
+
     if ( MeerOutput->external_enabled )
         {
 
@@ -173,10 +322,11 @@ void Init_Output( void )
             Meer_Log(NORMAL, "--[ Redis information ]--------------------------------------------");
             Meer_Log(NORMAL, "");
 
-            /* Connect to redis database */
+            /* Connect to redis database.  These connections are the plain
+               "redis" block's,  for fingerprinting and client_stats. */
 
-            Redis_Init();			/* Init memory, etc */
-            Redis_Connect();
+            Redis_Connect( REDIS_READER );
+            Redis_Connect( REDIS_WRITER );
 
             strlcpy(redis_command, "PING", sizeof(redis_command));
 
@@ -188,42 +338,58 @@ void Init_Output( void )
                 }
 
             Meer_Log(NORMAL, "");
-            Meer_Log(NORMAL, "Write 'alert'        : %s", MeerOutput->redis_alert ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'stats'        : %s", MeerOutput->redis_stats ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'email'        : %s", MeerOutput->redis_email ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'dns'          : %s", MeerOutput->redis_dns ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'flow'         : %s", MeerOutput->redis_flow ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'http'         : %s", MeerOutput->redis_http ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'tls'          : %s", MeerOutput->redis_tls ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'ssh'          : %s", MeerOutput->redis_ssh ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'smtp'         : %s", MeerOutput->redis_smtp ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'files'        : %s", MeerOutput->redis_files ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'fileinfo'     : %s", MeerOutput->redis_fileinfo ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'dhcp'         : %s", MeerOutput->redis_dhcp ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'rdp'          : %s", MeerOutput->redis_rdp ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'sip'          : %s", MeerOutput->redis_sip ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'ftp'          : %s", MeerOutput->redis_ftp ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'ikev2'        : %s", MeerOutput->redis_ikev2 ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'nfs'          : %s", MeerOutput->redis_nfs ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'tftp'         : %s", MeerOutput->redis_tftp ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'smb'          : %s", MeerOutput->redis_smb ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'dcerpc'       : %s", MeerOutput->redis_dcerpc ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'mqtt'         : %s", MeerOutput->redis_mqtt ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'netflow'      : %s", MeerOutput->redis_netflow ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'metadata'     : %s", MeerOutput->redis_metadata ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'dnp3'         : %s", MeerOutput->redis_dnp3 ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'anomaly'      : %s", MeerOutput->redis_anomaly ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'fingerprint'  : %s", MeerOutput->redis_fingerprint ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'client_stats' : %s", MeerOutput->redis_client_stats ? "enabled" : "disabled" );
+
+        }
+
+    for ( i = 0; i < MeerOutput->redis_count; i++ )
+        {
+
+            redis = MeerOutput->redis[i];
+
+            Meer_Log(NORMAL, "--[ Redis output information: '%s' ]-------------------------------", redis->name);
+            Meer_Log(NORMAL, "");
+            Meer_Log(NORMAL, "Batch size           : %d", redis->batch);
+            Meer_Log(NORMAL, "Mode                 : %s", redis->stream ? "stream" : redis->command);
             Meer_Log(NORMAL, "");
 
+            Meer_Log(NORMAL, "Write 'alert'        : %s", redis->alert ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'stats'        : %s", redis->stats ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'email'        : %s", redis->email ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'dns'          : %s", redis->dns ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'flow'         : %s", redis->flow ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'http'         : %s", redis->http ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'tls'          : %s", redis->tls ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'ssh'          : %s", redis->ssh ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'smtp'         : %s", redis->smtp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'files'        : %s", redis->files ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'fileinfo'     : %s", redis->fileinfo ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'dhcp'         : %s", redis->dhcp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'rdp'          : %s", redis->rdp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'sip'          : %s", redis->sip ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'ftp'          : %s", redis->ftp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'ikev2'        : %s", redis->ikev2 ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'nfs'          : %s", redis->nfs ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'tftp'         : %s", redis->tftp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'smb'          : %s", redis->smb ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'dcerpc'       : %s", redis->dcerpc ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'mqtt'         : %s", redis->mqtt ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'netflow'      : %s", redis->netflow ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'metadata'     : %s", redis->metadata ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'dnp3'         : %s", redis->dnp3 ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'anomaly'      : %s", redis->anomaly ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'fingerprint'  : %s", redis->fingerprint ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'client_stats' : %s", redis->client_stats ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "");
+
+            Redis_Init( redis );		/* Init memory, shards, etc */
+
         }
 
 #endif
 
 #ifdef WITH_SYSLOG
 
-    if ( MeerOutput->file_enabled )
+    if ( MeerOutput->syslog_enabled )
         {
 
             Meer_Log(NORMAL, "--[ Syslog information ]------------------------------------------");
@@ -261,104 +427,108 @@ void Init_Output( void )
 
 #endif
 
-    if ( MeerOutput->file_enabled )
+    for ( i = 0; i < MeerOutput->file_count; i++ )
         {
 
-            Meer_Log(NORMAL, "--[ File information ]--------------------------------------------");
+            file = MeerOutput->file[i];
+
+            Meer_Log(NORMAL, "--[ File output information: '%s' ]--------------------------------", file->name);
             Meer_Log(NORMAL, "");
-            Meer_Log(NORMAL, "File Location: %s", MeerOutput->file_location);
+            Meer_Log(NORMAL, "File Location: %s", file->location);
             Meer_Log(NORMAL, "");
-            Meer_Log(NORMAL, "Write 'alert'      : %s", MeerOutput->file_alert ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'stats'      : %s", MeerOutput->file_stats ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'email'      : %s", MeerOutput->file_email ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'dns'        : %s", MeerOutput->file_dns ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'flow'       : %s", MeerOutput->file_flow ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'http'       : %s", MeerOutput->file_http ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'tls'        : %s", MeerOutput->file_tls ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'ssh'        : %s", MeerOutput->file_ssh ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'smtp'       : %s", MeerOutput->file_smtp ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'files'      : %s", MeerOutput->file_files ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'fileinfo'   : %s", MeerOutput->file_fileinfo ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'dhcp'       : %s", MeerOutput->file_dhcp ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'rdp'        : %s", MeerOutput->file_rdp ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'sip'        : %s", MeerOutput->file_sip ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'ftp'        : %s", MeerOutput->file_ftp ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'ikev2'      : %s", MeerOutput->file_ikev2 ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'nfs'        : %s", MeerOutput->file_nfs ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'tftp'       : %s", MeerOutput->file_tftp ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'smb'        : %s", MeerOutput->file_smb ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'dcerpc'     : %s", MeerOutput->file_dcerpc ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'mqtt'       : %s", MeerOutput->file_mqtt ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'netflow'    : %s", MeerOutput->file_netflow ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'metadata'   : %s", MeerOutput->file_metadata ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'dnp3'       : %s", MeerOutput->file_dnp3 ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'anomaly'    : %s", MeerOutput->file_anomaly ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'fingerprint': %s", MeerOutput->file_fingerprint ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'alert'      : %s", file->alert ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'stats'      : %s", file->stats ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'email'      : %s", file->email ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'dns'        : %s", file->dns ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'flow'       : %s", file->flow ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'http'       : %s", file->http ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'tls'        : %s", file->tls ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'ssh'        : %s", file->ssh ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'smtp'       : %s", file->smtp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'files'      : %s", file->files ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'fileinfo'   : %s", file->fileinfo ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'dhcp'       : %s", file->dhcp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'rdp'        : %s", file->rdp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'sip'        : %s", file->sip ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'ftp'        : %s", file->ftp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'ikev2'      : %s", file->ikev2 ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'nfs'        : %s", file->nfs ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'tftp'       : %s", file->tftp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'smb'        : %s", file->smb ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'dcerpc'     : %s", file->dcerpc ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'mqtt'       : %s", file->mqtt ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'netflow'    : %s", file->netflow ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'metadata'   : %s", file->metadata ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'dnp3'       : %s", file->dnp3 ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'anomaly'    : %s", file->anomaly ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'fingerprint': %s", file->fingerprint ? "enabled" : "disabled" );
 
             Meer_Log(NORMAL, "");
 
             /* Open the new spool file for output */
 
-            if (( MeerOutput->file_fd = fopen(MeerOutput->file_location, "a" )) == NULL )
+            if (( file->fd = fopen(file->location, "a" )) == NULL )
                 {
-                    Meer_Log(ERROR, "[%s, line %d] Cannot open '%s' for append. %s", __FILE__,  __LINE__, MeerOutput->file_location, strerror(errno) );
+                    Meer_Log(ERROR, "[%s, line %d] Cannot open '%s' for append. %s", __FILE__,  __LINE__, file->location, strerror(errno) );
                 }
 
         }
 
-    if ( MeerOutput->pipe_enabled )
+    for ( i = 0; i < MeerOutput->pipe_count; i++ )
         {
             uint32_t current_pipe_size = 0;
             uint32_t fd_results = 0;
 
-            Meer_Log(NORMAL, "--[ PIPE information ]--------------------------------------------");
+            pipe_out = MeerOutput->pipe[i];
+
+            Meer_Log(NORMAL, "--[ PIPE output information: '%s' ]--------------------------------", pipe_out->name);
             Meer_Log(NORMAL, "");
-            Meer_Log(NORMAL, "Pipe Location: %s", MeerOutput->pipe_location);
-            Meer_Log(NORMAL, "Pipe Size: %d bytes", MeerOutput->pipe_size);
+            Meer_Log(NORMAL, "Pipe Location: %s", pipe_out->location);
+            Meer_Log(NORMAL, "Pipe Size: %d bytes", pipe_out->size);
             Meer_Log(NORMAL, "");
 
-            Meer_Log(NORMAL, "Write 'alert'      : %s", MeerOutput->pipe_alert ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'stats'      : %s", MeerOutput->pipe_stats ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'email'      : %s", MeerOutput->pipe_email ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'dns'        : %s", MeerOutput->pipe_dns ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'flow'       : %s", MeerOutput->pipe_flow ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'http'       : %s", MeerOutput->pipe_http ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'tls'        : %s", MeerOutput->pipe_tls ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'ssh'        : %s", MeerOutput->pipe_ssh ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'smtp'       : %s", MeerOutput->pipe_smtp ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'files'      : %s", MeerOutput->pipe_files ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'fileinfo'   : %s", MeerOutput->pipe_fileinfo ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'dhcp'       : %s", MeerOutput->pipe_dhcp ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'rdp'        : %s", MeerOutput->pipe_rdp ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'sip'        : %s", MeerOutput->pipe_sip ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'ftp'        : %s", MeerOutput->pipe_ftp ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'ikev2'      : %s", MeerOutput->pipe_ikev2 ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'nfs'        : %s", MeerOutput->pipe_nfs ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'tftp'       : %s", MeerOutput->pipe_tftp ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'smb'        : %s", MeerOutput->pipe_smb ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'dcerpc'     : %s", MeerOutput->pipe_dcerpc ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'mqtt'       : %s", MeerOutput->pipe_mqtt ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'netflow'    : %s", MeerOutput->pipe_netflow ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'metadata'   : %s", MeerOutput->pipe_metadata ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'dnp3'       : %s", MeerOutput->pipe_dnp3 ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'anomaly'    : %s", MeerOutput->pipe_anomaly ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Write 'fingerprint': %s", MeerOutput->pipe_fingerprint ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'alert'      : %s", pipe_out->alert ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'stats'      : %s", pipe_out->stats ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'email'      : %s", pipe_out->email ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'dns'        : %s", pipe_out->dns ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'flow'       : %s", pipe_out->flow ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'http'       : %s", pipe_out->http ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'tls'        : %s", pipe_out->tls ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'ssh'        : %s", pipe_out->ssh ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'smtp'       : %s", pipe_out->smtp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'files'      : %s", pipe_out->files ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'fileinfo'   : %s", pipe_out->fileinfo ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'dhcp'       : %s", pipe_out->dhcp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'rdp'        : %s", pipe_out->rdp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'sip'        : %s", pipe_out->sip ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'ftp'        : %s", pipe_out->ftp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'ikev2'      : %s", pipe_out->ikev2 ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'nfs'        : %s", pipe_out->nfs ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'tftp'       : %s", pipe_out->tftp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'smb'        : %s", pipe_out->smb ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'dcerpc'     : %s", pipe_out->dcerpc ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'mqtt'       : %s", pipe_out->mqtt ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'netflow'    : %s", pipe_out->netflow ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'metadata'   : %s", pipe_out->metadata ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'dnp3'       : %s", pipe_out->dnp3 ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'anomaly'    : %s", pipe_out->anomaly ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Write 'fingerprint': %s", pipe_out->fingerprint ? "enabled" : "disabled" );
 
 
             Meer_Log(NORMAL, "");
 
-            MeerOutput->pipe_fd = open(MeerOutput->pipe_location, O_RDWR);
+            pipe_out->fd = open(pipe_out->location, O_RDWR);
 
-            if ( MeerOutput->pipe_fd < 0 )
+            if ( pipe_out->fd < 0 )
                 {
-                    Meer_Log(ERROR, "[%s, line %d] Cannot open %s. %s.", __FILE__, __LINE__, MeerOutput->pipe_location, strerror(errno) );
+                    Meer_Log(ERROR, "[%s, line %d] Cannot open %s. %s.", __FILE__, __LINE__, pipe_out->location, strerror(errno) );
                 }
 
-            current_pipe_size = fcntl(MeerOutput->pipe_fd, F_GETPIPE_SZ);
-            fd_results = fcntl(MeerOutput->pipe_fd, F_SETPIPE_SZ, MeerOutput->pipe_size);
-            fcntl(MeerOutput->pipe_fd, F_SETFL, O_NONBLOCK);
+            current_pipe_size = fcntl(pipe_out->fd, F_GETPIPE_SZ);
+            fd_results = fcntl(pipe_out->fd, F_SETPIPE_SZ, pipe_out->size);
+            fcntl(pipe_out->fd, F_SETFL, O_NONBLOCK);
 
-            Meer_Log(NORMAL, "The %s pipe (FIFO) was %d bytes. It is now set to %d bytes.", MeerOutput->pipe_location, current_pipe_size, fd_results);
+            Meer_Log(NORMAL, "The %s pipe (FIFO) was %d bytes. It is now set to %d bytes.", pipe_out->location, current_pipe_size, fd_results);
 
             Meer_Log(NORMAL, "");
 
@@ -369,10 +539,22 @@ void Init_Output( void )
     if ( MeerConfig->geoip == true )
         {
 
+            uint8_t i = 0;
+
             Meer_Log(NORMAL, "--[ GeoIP information ]---------------------------------");
             Meer_Log(NORMAL, "");
             Meer_Log(NORMAL, "GeoIP           : %s", MeerConfig->geoip ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "GeoIP database  : %s", MeerConfig->geoip_database );
+            for ( i = 0; i < MeerConfig->geoip_database_count; i++ )
+                {
+                    Meer_Log(NORMAL, "GeoIP database  : %s", MeerConfig->geoip_database[i] );
+                }
+
+            for ( i = 0; i < MeerConfig->geoip_field_count; i++ )
+                {
+                    Meer_Log(NORMAL, "GeoIP field     : %s -> %s", MeerConfig->geoip_field_path[i], MeerConfig->geoip_field_name[i] );
+                }
+
+            Meer_Log(NORMAL, "GeoIP cache     : %" PRIu32 " entries", MeerConfig->geoip_cache );
             Meer_Log(NORMAL, "");
         }
 
@@ -407,17 +589,46 @@ void Init_Output( void )
 
 #ifdef WITH_ELASTICSEARCH
 
-    if ( MeerOutput->elasticsearch_enabled == true )
+    for ( i = 0; i < MeerOutput->elasticsearch_count; i++ )
         {
 
-            Meer_Log(NORMAL, "--[ Elasticsearch output information ]---------------------------");
+            es = MeerOutput->elasticsearch[i];
+
+            Meer_Log(NORMAL, "--[ Elasticsearch output information: '%s' ]---------------------------", es->name);
             Meer_Log(NORMAL, "");
-            Meer_Log(NORMAL, "URL to connect to       : \"%s\"", MeerOutput->elasticsearch_url);
-            Meer_Log(NORMAL, "Index template          : \"%s\"", MeerOutput->elasticsearch_index);
-            Meer_Log(NORMAL, "Batch size per/POST     : %d", MeerOutput->elasticsearch_batch);
-            Meer_Log(NORMAL, "Threads                 : %d", MeerOutput->elasticsearch_threads);
+            Meer_Log(NORMAL, "URL to connect to       : \"%s\"", es->url);
+            Meer_Log(NORMAL, "Index template          : \"%s\"", es->index);
+            Meer_Log(NORMAL, "Batch size per/POST     : %d", es->batch);
+
+            if ( es->multi == true )
+                {
+                    Meer_Log(NORMAL, "Engine                  : multi (%d concurrent requests)", es->concurrency);
+                }
+            else
+                {
+                    Meer_Log(NORMAL, "Threads                 : %d", es->threads);
+                }
 
-            if ( MeerOutput->elasticsearch_username[0] != '\0' || MeerOutput->elasticsearch_password[0] != '\0' )
+            Meer_Log(NORMAL, "Queued batches          : %d", es->queue);
+            Meer_Log(NORMAL, "Max bytes per/POST      : %" PRIu64 "", es->max_body);
+
+            if ( es->gzip == true )
+                {
+                    Meer_Log(NORMAL, "Compression             : gzip (level %d)", es->gzip_level);
+                }
+            else
+                {
+                    Meer_Log(NORMAL, "Compression             : none");
+                }
+
+            Meer_Log(NORMAL, "Retries                 : %d", es->retries);
+
+            if ( es->dead_letter[0] != '\0' )
+                {
+                    Meer_Log(NORMAL, "Dead letter file        : %s", es->dead_letter);
+                }
+
+            if ( es->username[0] != '\0' || es->password[0] != '\0' )
                 {
                     Meer_Log(NORMAL, "Authentication          : enabled");
                 }
@@ -427,33 +638,39 @@ void Init_Output( void )
                 }
 
             Meer_Log(NORMAL, "");
-            Meer_Log(NORMAL, "Record 'alert'       : %s", MeerOutput->elasticsearch_alert ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'files'       : %s", MeerOutput->elasticsearch_files ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'flow'        : %s", MeerOutput->elasticsearch_flow ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'dns'         : %s", MeerOutput->elasticsearch_dns ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'http'        : %s", MeerOutput->elasticsearch_http ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'tls'         : %s", MeerOutput->elasticsearch_tls ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'ssh'         : %s", MeerOutput->elasticsearch_ssh ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'smtp'        : %s", MeerOutput->elasticsearch_smtp ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'email'       : %s", MeerOutput->elasticsearch_email ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'fileinfo'    : %s", MeerOutput->elasticsearch_fileinfo ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'dhcp'        : %s", MeerOutput->elasticsearch_dhcp ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'stats'       : %s", MeerOutput->elasticsearch_stats ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'rdp'         : %s", MeerOutput->elasticsearch_rdp ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'sip'         : %s", MeerOutput->elasticsearch_sip ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'ftp'         : %s", MeerOutput->elasticsearch_ftp ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'nfs'         : %s", MeerOutput->elasticsearch_nfs ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'tftp'        : %s", MeerOutput->elasticsearch_tftp ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'smb'         : %s", MeerOutput->elasticsearch_smb ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'mqtt'        : %s", MeerOutput->elasticsearch_mqtt ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'dcerpc'      : %s", MeerOutput->elasticsearch_dcerpc ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'netflow'     : %s", MeerOutput->elasticsearch_netflow ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'metadata'    : %s", MeerOutput->elasticsearch_metadata ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'dnp3'        : %s", MeerOutput->elasticsearch_dnp3 ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'anomaly'     : %s", MeerOutput->elasticsearch_anomaly ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'fingerprint' : %s", MeerOutput->elasticsearch_fingerprint ? "enabled" : "disabled" );
-            Meer_Log(NORMAL, "Record 'ndp'         : %s", MeerOutput->elasticsearch_ndp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'alert'       : %s", es->alert ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'files'       : %s", es->files ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'flow'        : %s", es->flow ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'dns'         : %s", es->dns ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'http'        : %s", es->http ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'tls'         : %s", es->tls ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'ssh'         : %s", es->ssh ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'smtp'        : %s", es->smtp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'email'       : %s", es->email ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'fileinfo'    : %s", es->fileinfo ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'dhcp'        : %s", es->dhcp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'stats'       : %s", es->stats ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'rdp'         : %s", es->rdp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'sip'         : %s", es->sip ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'ftp'         : %s", es->ftp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'nfs'         : %s", es->nfs ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'tftp'        : %s", es->tftp ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'smb'         : %s", es->smb ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'mqtt'        : %s", es->mqtt ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'dcerpc'      : %s", es->dcerpc ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'netflow'     : %s", es->netflow ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'metadata'    : %s", es->metadata ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'dnp3'        : %s", es->dnp3 ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'anomaly'     : %s", es->anomaly ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'fingerprint' : %s", es->fingerprint ? "enabled" : "disabled" );
+            Meer_Log(NORMAL, "Record 'ndp'         : %s", es->ndp ? "enabled" : "disabled" );
 
+            Meer_Log(NORMAL, "");
+
+        }
+
+    if ( MeerOutput->elasticsearch_enabled == true )
+        {
 
             Elasticsearch_Init();
 
@@ -495,167 +712,232 @@ void Init_Output( void )
 
     Meer_Log(NORMAL, "");
 
+    /* Every output gets its own queue and worker */
+
+    for ( i = 0; i < MeerOutput->pipe_count; i++ )
+        {
+            pipe_out = MeerOutput->pipe[i];
+            Output_Queue_Register( pipe_out->name, &Output_Pipe_Ops, pipe_out, &pipe_out->worker );
+        }
+
+    if ( MeerOutput->external_enabled == true )
+        {
+            Output_Queue_Register( "external", &Output_External_Ops, NULL, &MeerOutput->external_worker );
+        }
+
+    for ( i = 0; i < MeerOutput->file_count; i++ )
+        {
+            file = MeerOutput->file[i];
+            Output_Queue_Register( file->name, &Output_File_Ops, file, &file->worker );
+        }
+
+#ifdef HAVE_LIBHIREDIS
+
+    for ( i = 0; i < MeerOutput->redis_count; i++ )
+        {
+            redis = MeerOutput->redis[i];
+            redis->output_queue = Output_Queue_Register( redis->name, &Output_Redis_Ops, redis, &redis->worker );
+        }
+
+#endif
+
+#ifdef WITH_SYSLOG
+
+    if ( MeerOutput->syslog_enabled == true )
+        {
+            Output_Queue_Register( "syslog", &Output_Syslog_Ops, NULL, &MeerOutput->syslog_worker );
+        }
+
+#endif
+
+#ifdef WITH_BLUEDOT
+
+    if ( MeerOutput->bluedot_flag == true )
+        {
+            Output_Queue_Register( "bluedot", &Output_Bluedot_Ops, NULL, &MeerOutput->bluedot_worker );
+        }
+
+#endif
+
+#ifdef WITH_ELASTICSEARCH
+
+    for ( i = 0; i < MeerOutput->elasticsearch_count; i++ )
+        {
+            es = MeerOutput->elasticsearch[i];
+            es->output_queue = Output_Queue_Register( es->name, &Output_Elasticsearch_Ops, es, &es->worker );
+
+            if ( es->document_id == true )
+                {
+                    Output_Queue_Keep_Raw();
+                }
+
+        }
+
+#endif
+
+    Meer_Log(NORMAL, "");
+
 }
 
 /****************************************************************************
  * Output_Pipe - Determines what data/JSON should be sent to the named pipe
  ****************************************************************************/
 
-bool Output_Pipe ( const char *json_string, const char *event_type )
+bool Output_Pipe ( struct _Pipe_Output *pipe_out, const char *json_string, const char *event_type )
 {
 
-    if ( !strcmp(event_type, "alert" ) && MeerOutput->pipe_alert == true )
+    if ( !strcmp(event_type, "alert" ) && pipe_out->alert == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "files" ) && MeerOutput->pipe_files == true )
+    else if ( !strcmp(event_type, "files" ) && pipe_out->files == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "flow" ) && MeerOutput->pipe_flow == true )
+    else if ( !strcmp(event_type, "flow" ) && pipe_out->flow == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "dns" ) && MeerOutput->pipe_dns == true )
+    else if ( !strcmp(event_type, "dns" ) && pipe_out->dns == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "http" ) && MeerOutput->pipe_http == true )
+    else if ( !strcmp(event_type, "http" ) && pipe_out->http == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "ssh" ) && MeerOutput->pipe_ssh == true )
+    else if ( !strcmp(event_type, "ssh" ) && pipe_out->ssh == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "smtp" ) && MeerOutput->pipe_smtp == true )
+    else if ( !strcmp(event_type, "smtp" ) && pipe_out->smtp == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "email" ) && MeerOutput->pipe_email == true )
+    else if ( !strcmp(event_type, "email" ) && pipe_out->email == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "fileinfo" ) && MeerOutput->pipe_fileinfo == true )
+    else if ( !strcmp(event_type, "fileinfo" ) && pipe_out->fileinfo == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "dhcp" ) && MeerOutput->pipe_dhcp == true )
+    else if ( !strcmp(event_type, "dhcp" ) && pipe_out->dhcp == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "stats" ) && MeerOutput->pipe_stats == true )
+    else if ( !strcmp(event_type, "stats" ) && pipe_out->stats == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "rdp" ) && MeerOutput->pipe_rdp == true )
+    else if ( !strcmp(event_type, "rdp" ) && pipe_out->rdp == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "sip" ) && MeerOutput->pipe_sip == true )
+    else if ( !strcmp(event_type, "sip" ) && pipe_out->sip == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( ( !strcmp(event_type, "ftp" ) || !strcmp(event_type, "ftp_data" ) ) && MeerOutput->pipe_ftp == true )
+    else if ( ( !strcmp(event_type, "ftp" ) || !strcmp(event_type, "ftp_data" ) ) && pipe_out->ftp == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "ikev2" ) && MeerOutput->pipe_ikev2 == true )
+    else if ( !strcmp(event_type, "ikev2" ) && pipe_out->ikev2 == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "nfs" ) && MeerOutput->pipe_nfs == true )
+    else if ( !strcmp(event_type, "nfs" ) && pipe_out->nfs == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "tftp" ) && MeerOutput->pipe_tftp == true )
+    else if ( !strcmp(event_type, "tftp" ) && pipe_out->tftp == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "smb" ) && MeerOutput->pipe_smb == true )
+    else if ( !strcmp(event_type, "smb" ) && pipe_out->smb == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "dcerpc" ) && MeerOutput->pipe_dcerpc == true )
+    else if ( !strcmp(event_type, "dcerpc" ) && pipe_out->dcerpc == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "mqtt" ) && MeerOutput->pipe_mqtt == true )
+    else if ( !strcmp(event_type, "mqtt" ) && pipe_out->mqtt == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "netflow" ) && MeerOutput->pipe_netflow == true )
+    else if ( !strcmp(event_type, "netflow" ) && pipe_out->netflow == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "metadata" ) && MeerOutput->pipe_metadata == true )
+    else if ( !strcmp(event_type, "metadata" ) && pipe_out->metadata == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "dnp3" ) && MeerOutput->pipe_dnp3 == true )
+    else if ( !strcmp(event_type, "dnp3" ) && pipe_out->dnp3 == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "anomaly" ) && MeerOutput->pipe_anomaly == true )
+    else if ( !strcmp(event_type, "anomaly" ) && pipe_out->anomaly == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "fingerprint" ) && MeerOutput->pipe_fingerprint == true )
+    else if ( !strcmp(event_type, "fingerprint" ) && pipe_out->fingerprint == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( pipe_out, json_string );
             return(true);
         }
 
 
-    MeerCounters->JSONPipeMisses++;
+    __atomic_add_fetch(&MeerCounters->JSONPipeMisses, 1, __ATOMIC_SEQ_CST);
     return(false);
 
 }
@@ -1019,169 +1301,198 @@ void Output_Bluedot ( struct json_object *json_obj )
 
 #ifdef WITH_ELASTICSEARCH
 
+/****************************************************************************
+ * Output_Elasticsearch - Queue an event that didn't come through
+ * Decode_JSON() (the NDP collector) for every "elasticsearch" output.
+ ****************************************************************************/
+
 bool Output_Elasticsearch ( const char *json_string, const char *event_type, const char *id )
 {
 
-    if ( !strcmp(event_type, "alert" ) && MeerOutput->elasticsearch_alert == true )
+    struct _Output_Event *event = NULL;
+    uint8_t i = 0;
+
+    event = Output_Event_New( json_string, event_type, NULL, id, NULL );
+
+    for ( i = 0; i < MeerOutput->elasticsearch_count; i++ )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Queue_Push( MeerOutput->elasticsearch[i]->output_queue, event );
+        }
+
+    Output_Event_Release( event );
+
+    return(true);
+
+}
+
+/****************************************************************************
+ * Output_Elasticsearch_Route - Determines what data/JSON one "elasticsearch"
+ * output records.  Called from that output's worker.
+ ****************************************************************************/
+
+bool Output_Elasticsearch_Route ( struct _Elasticsearch_Output *es, const char *json_string, const char *event_type, const char *id, const char *raw )
+{
+
+    if ( !strcmp(event_type, "alert" ) && es->alert == true )
+        {
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "files" ) && MeerOutput->elasticsearch_files == true )
+    else if ( !strcmp(event_type, "files" ) && es->files == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "flow" ) && MeerOutput->elasticsearch_flow == true )
+    else if ( !strcmp(event_type, "flow" ) && es->flow == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "dns" ) && MeerOutput->elasticsearch_dns == true )
+    else if ( !strcmp(event_type, "dns" ) && es->dns == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "http" ) && MeerOutput->elasticsearch_http == true )
+    else if ( !strcmp(event_type, "http" ) && es->http == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "tls" ) && MeerOutput->elasticsearch_tls == true )
+    else if ( !strcmp(event_type, "tls" ) && es->tls == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "ssh" ) && MeerOutput->elasticsearch_ssh == true )
+    else if ( !strcmp(event_type, "ssh" ) && es->ssh == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "smtp" ) && MeerOutput->elasticsearch_smtp == true )
+    else if ( !strcmp(event_type, "smtp" ) && es->smtp == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "email" ) && MeerOutput->elasticsearch_email == true )
+    else if ( !strcmp(event_type, "email" ) && es->email == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "fileinfo" ) && MeerOutput->elasticsearch_fileinfo == true )
+    else if ( !strcmp(event_type, "fileinfo" ) && es->fileinfo == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "dhcp" ) && MeerOutput->elasticsearch_dhcp == true )
+    else if ( !strcmp(event_type, "dhcp" ) && es->dhcp == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "stats" ) && MeerOutput->elasticsearch_stats == true )
+    else if ( !strcmp(event_type, "stats" ) && es->stats == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "rdp" ) && MeerOutput->elasticsearch_rdp == true )
+    else if ( !strcmp(event_type, "rdp" ) && es->rdp == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "sip" ) && MeerOutput->elasticsearch_sip == true )
+    else if ( !strcmp(event_type, "sip" ) && es->sip == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( ( !strcmp(event_type, "ftp" ) || !strcmp(event_type, "ftp_data" ) ) && MeerOutput->elasticsearch_ftp == true )
+    else if ( ( !strcmp(event_type, "ftp" ) || !strcmp(event_type, "ftp_data" ) ) && es->ftp == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "ikev2" ) && MeerOutput->elasticsearch_ikev2 == true )
+    else if ( !strcmp(event_type, "ikev2" ) && es->ikev2 == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "nfs" ) && MeerOutput->elasticsearch_nfs == true )
+    else if ( !strcmp(event_type, "nfs" ) && es->nfs == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "tftp" ) && MeerOutput->elasticsearch_tftp == true )
+    else if ( !strcmp(event_type, "tftp" ) && es->tftp == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "smb" ) && MeerOutput->elasticsearch_smb == true )
+    else if ( !strcmp(event_type, "smb" ) && es->smb == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "mqtt" ) && MeerOutput->elasticsearch_mqtt == true )
+    else if ( !strcmp(event_type, "mqtt" ) && es->mqtt == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "dcerpc" ) && MeerOutput->elasticsearch_dcerpc == true )
+    else if ( !strcmp(event_type, "dcerpc" ) && es->dcerpc == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "netflow" ) && MeerOutput->elasticsearch_netflow == true )
+    else if ( !strcmp(event_type, "netflow" ) && es->netflow == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "metadata" ) && MeerOutput->elasticsearch_metadata == true )
+    else if ( !strcmp(event_type, "metadata" ) && es->metadata == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "dnp3" ) && MeerOutput->elasticsearch_dnp3 == true )
+    else if ( !strcmp(event_type, "dnp3" ) && es->dnp3 == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
 
-    else if ( !strcmp(event_type, "anomaly" ) && MeerOutput->elasticsearch_anomaly == true )
+    else if ( !strcmp(event_type, "anomaly" ) && es->anomaly == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "fingerprint" ) && MeerOutput->elasticsearch_fingerprint == true )
+    else if ( !strcmp(event_type, "fingerprint" ) && es->fingerprint == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, NULL );
+            Output_Do_Elasticsearch( es, json_string, event_type, NULL, raw );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "ndp" ) && MeerOutput->elasticsearch_ndp == true )
+    else if ( !strcmp(event_type, "ndp" ) && es->ndp == true )
         {
-            Output_Do_Elasticsearch( json_string, event_type, id );
+            Output_Do_Elasticsearch( es, json_string, event_type, id, raw );
             return(true);
         }
 
@@ -1190,68 +1501,44 @@ bool Output_Elasticsearch ( const char *json_string, const char *event_type, con
 }
 
 
-bool Output_Do_Elasticsearch ( const char *json_string, const char *event_type, const char *id )
+bool Output_Do_Elasticsearch ( struct _Elasticsearch_Output *es, const char *json_string, const char *event_type, const char *id, const char *raw )
 {
 
-    char *tmp = malloc(MeerConfig->payload_buffer_size);
+    char hash[HASH128_SIZE] = { 0 };
 
-    if ( tmp == NULL )
-        {
-            fprintf(stderr, "[%s, line %d] Fatal Error: Can't allocate memory! Abort!\n", __FILE__, __LINE__);
-            exit(-1);
-        }
-
-    memset(tmp, 0, MeerConfig->payload_buffer_size);
-
-    char index_name[512] = { 0 };
+    /* The same event hashes to the same _id,  so a replayed or retried
+       event overwrites its earlier copy rather than duplicating it.  The
+       line as read is hashed since enrichment (DNS,  GeoIP,  ...) can
+       differ between two reads of it.  "raw" is NULL when nothing was
+       added. */
 
-    Elasticsearch_Get_Index(index_name, sizeof(index_name), event_type);
-
-    if ( id == NULL )
-        {
-            snprintf(tmp, MeerConfig->payload_buffer_size, "{\"index\":{\"_index\":\"%s\"}}\n%s\n", index_name, json_string);
-        }
-    else
-        {
-            snprintf(tmp, MeerConfig->payload_buffer_size, "{\"index\":{\"_index\":\"%s\",\"_id\":\"%s\"}}\n%s\n", index_name, id, json_string);
-        }
-
-    tmp[ MeerConfig->payload_buffer_size - 1 ] = '\0';
-
-    strlcat(big_batch, tmp, MeerConfig->payload_buffer_size); //  * MeerOutput->elasticsearch_batch ) );
-    elasticsearch_batch_count++;
-
-    /* Once we hit the batch size,  submit it. */
-
-    if ( elasticsearch_batch_count == MeerOutput->elasticsearch_batch )
+    if ( id == NULL && es->document_id == true )
         {
 
-            while ( elastic_proc_running >= MeerOutput->elasticsearch_threads )
+            if ( raw == NULL )
                 {
-                    Meer_Log(WARN, "Waiting on a free thread! Consider increasing threads?");
-                    sleep(5);
+                    raw = json_string;
                 }
 
-            /* Submit the batch ! */
-
-            pthread_mutex_lock(&MeerElasticMutex);
-
-            strlcpy( big_batch_THREAD, big_batch, ( MeerConfig->payload_buffer_size * MeerOutput->elasticsearch_batch ) );
-            elastic_proc_msgslot++;
-
-            __atomic_add_fetch(&elastic_proc_running, 1, __ATOMIC_SEQ_CST);
+            Hash128( (const uint8_t *)raw, strlen(raw), hash, sizeof(hash) );
+            id = hash;
+        }
 
-            pthread_cond_signal(&MeerElasticWork);
-            pthread_mutex_unlock(&MeerElasticMutex);
+    /* While the cluster is down and the retries have filled the queue,
+       tell the output's worker the write failed instead of waiting.  Its
+       breaker then opens and the spill holds the events until Elasticsearch
+       is back.  Without a breaker,  waiting is all there is. */
 
-            /* Clear old batch */
+    if ( es->worker.breaker_failures != 0 && Elasticsearch_Backed_Up( es ) == true )
+        {
+            Output_Queue_Failed();
+            return(false);
+        }
 
-            elasticsearch_batch_count = 0;
-            big_batch[0] = '\0';
+    /* Submitted to the workers once the batch is full */
 
-        }
+    Elasticsearch_Batch_Add( es, Elasticsearch_Index_Lookup( es, event_type, json_string ), id, json_string );
 
-    free(tmp);
     return(true);
 }
 
@@ -1262,157 +1549,157 @@ bool Output_Do_Elasticsearch ( const char *json_string, const char *event_type,
 bool Output_Syslog ( const char *json_string, const char *event_type )
 {
 
-    if ( !strcmp(event_type, "alert" ) && MeerOutput->file_alert == true )
+    if ( !strcmp(event_type, "alert" ) && MeerOutput->syslog_alert == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "files" ) && MeerOutput->file_files == true )
+    else if ( !strcmp(event_type, "files" ) && MeerOutput->syslog_files == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "flow" ) && MeerOutput->file_flow == true )
+    else if ( !strcmp(event_type, "flow" ) && MeerOutput->syslog_flow == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "dns" ) && MeerOutput->file_dns == true )
+    else if ( !strcmp(event_type, "dns" ) && MeerOutput->syslog_dns == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "http" ) && MeerOutput->file_http == true )
+    else if ( !strcmp(event_type, "http" ) && MeerOutput->syslog_http == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "tls" ) && MeerOutput->file_tls == true )
+    else if ( !strcmp(event_type, "tls" ) && MeerOutput->syslog_tls == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "ssh" ) && MeerOutput->file_ssh == true )
+    else if ( !strcmp(event_type, "ssh" ) && MeerOutput->syslog_ssh == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "smtp" ) && MeerOutput->file_smtp == true )
+    else if ( !strcmp(event_type, "smtp" ) && MeerOutput->syslog_smtp == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "email" ) && MeerOutput->file_email == true )
+    else if ( !strcmp(event_type, "email" ) && MeerOutput->syslog_email == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "fileinfo" ) && MeerOutput->file_fileinfo == true )
+    else if ( !strcmp(event_type, "fileinfo" ) && MeerOutput->syslog_fileinfo == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "dhcp" ) && MeerOutput->file_dhcp == true )
+    else if ( !strcmp(event_type, "dhcp" ) && MeerOutput->syslog_dhcp == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "stats" ) && MeerOutput->file_stats == true )
+    else if ( !strcmp(event_type, "stats" ) && MeerOutput->syslog_stats == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "rdp" ) && MeerOutput->file_rdp == true )
+    else if ( !strcmp(event_type, "rdp" ) && MeerOutput->syslog_rdp == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "sip" ) && MeerOutput->file_sip == true )
+    else if ( !strcmp(event_type, "sip" ) && MeerOutput->syslog_sip == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( ( !strcmp(event_type, "ftp" ) || !strcmp(event_type, "ftp_data" ) ) && MeerOutput->file_ftp == true )
+    else if ( ( !strcmp(event_type, "ftp" ) || !strcmp(event_type, "ftp_data" ) ) && MeerOutput->syslog_ftp == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "ikev2" ) && MeerOutput->file_ikev2 == true )
+    else if ( !strcmp(event_type, "ikev2" ) && MeerOutput->syslog_ikev2 == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "nfs" ) && MeerOutput->file_nfs == true )
+    else if ( !strcmp(event_type, "nfs" ) && MeerOutput->syslog_nfs == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "tftp" ) && MeerOutput->file_tftp == true )
+    else if ( !strcmp(event_type, "tftp" ) && MeerOutput->syslog_tftp == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "smb" ) && MeerOutput->file_smb == true )
+    else if ( !strcmp(event_type, "smb" ) && MeerOutput->syslog_smb == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "dcerpc" ) && MeerOutput->file_dcerpc == true )
+    else if ( !strcmp(event_type, "dcerpc" ) && MeerOutput->syslog_dcerpc == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "mqtt" ) && MeerOutput->file_mqtt == true )
+    else if ( !strcmp(event_type, "mqtt" ) && MeerOutput->syslog_mqtt == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "netflow" ) && MeerOutput->file_netflow == true )
+    else if ( !strcmp(event_type, "netflow" ) && MeerOutput->syslog_netflow == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "metadata" ) && MeerOutput->file_metadata == true )
+    else if ( !strcmp(event_type, "metadata" ) && MeerOutput->syslog_metadata == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "dnp3" ) && MeerOutput->file_dnp3 == true )
+    else if ( !strcmp(event_type, "dnp3" ) && MeerOutput->syslog_dnp3 == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "anomaly" ) && MeerOutput->file_anomaly == true )
+    else if ( !strcmp(event_type, "anomaly" ) && MeerOutput->syslog_anomaly == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "fingerprint" ) && MeerOutput->file_fingerprint == true )
+    else if ( !strcmp(event_type, "fingerprint" ) && MeerOutput->syslog_fingerprint == true )
         {
             Output_Do_Syslog( json_string, event_type );
             return(true);
@@ -1425,162 +1712,162 @@ bool Output_Syslog ( const char *json_string, const char *event_type )
 #endif
 
 
-bool Output_File ( const char *json_string, const char *event_type )
+bool Output_File ( struct _File_Output *file, const char *json_string, const char *event_type )
 {
 
-    if ( !strcmp(event_type, "alert" ) && MeerOutput->file_alert == true )
+    if ( !strcmp(event_type, "alert" ) && file->alert == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "files" ) && MeerOutput->file_files == true )
+    else if ( !strcmp(event_type, "files" ) && file->files == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "flow" ) && MeerOutput->file_flow == true )
+    else if ( !strcmp(event_type, "flow" ) && file->flow == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "dns" ) && MeerOutput->file_dns == true )
+    else if ( !strcmp(event_type, "dns" ) && file->dns == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "http" ) && MeerOutput->file_http == true )
+    else if ( !strcmp(event_type, "http" ) && file->http == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "tls" ) && MeerOutput->file_tls == true )
+    else if ( !strcmp(event_type, "tls" ) && file->tls == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "ssh" ) && MeerOutput->file_ssh == true )
+    else if ( !strcmp(event_type, "ssh" ) && file->ssh == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "smtp" ) && MeerOutput->file_smtp == true )
+    else if ( !strcmp(event_type, "smtp" ) && file->smtp == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "email" ) && MeerOutput->file_email == true )
+    else if ( !strcmp(event_type, "email" ) && file->email == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "fileinfo" ) && MeerOutput->file_fileinfo == true )
+    else if ( !strcmp(event_type, "fileinfo" ) && file->fileinfo == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "dhcp" ) && MeerOutput->file_dhcp == true )
+    else if ( !strcmp(event_type, "dhcp" ) && file->dhcp == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "stats" ) && MeerOutput->file_stats == true )
+    else if ( !strcmp(event_type, "stats" ) && file->stats == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "rdp" ) && MeerOutput->file_rdp == true )
+    else if ( !strcmp(event_type, "rdp" ) && file->rdp == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "sip" ) && MeerOutput->file_sip == true )
+    else if ( !strcmp(event_type, "sip" ) && file->sip == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( ( !strcmp(event_type, "ftp" ) || !strcmp(event_type, "ftp_data" ) ) && MeerOutput->file_ftp == true )
+    else if ( ( !strcmp(event_type, "ftp" ) || !strcmp(event_type, "ftp_data" ) ) && file->ftp == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "ikev2" ) && MeerOutput->file_ikev2 == true )
+    else if ( !strcmp(event_type, "ikev2" ) && file->ikev2 == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "nfs" ) && MeerOutput->file_nfs == true )
+    else if ( !strcmp(event_type, "nfs" ) && file->nfs == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "tftp" ) && MeerOutput->file_tftp == true )
+    else if ( !strcmp(event_type, "tftp" ) && file->tftp == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "smb" ) && MeerOutput->file_smb == true )
+    else if ( !strcmp(event_type, "smb" ) && file->smb == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "dcerpc" ) && MeerOutput->file_dcerpc == true )
+    else if ( !strcmp(event_type, "dcerpc" ) && file->dcerpc == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "mqtt" ) && MeerOutput->file_mqtt == true )
+    else if ( !strcmp(event_type, "mqtt" ) && file->mqtt == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "netflow" ) && MeerOutput->file_netflow == true )
+    else if ( !strcmp(event_type, "netflow" ) && file->netflow == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "metadata" ) && MeerOutput->file_metadata == true )
+    else if ( !strcmp(event_type, "metadata" ) && file->metadata == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "dnp3" ) && MeerOutput->file_dnp3 == true )
+    else if ( !strcmp(event_type, "dnp3" ) && file->dnp3 == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "anomaly" ) && MeerOutput->file_anomaly == true )
+    else if ( !strcmp(event_type, "anomaly" ) && file->anomaly == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
-    else if ( !strcmp(event_type, "fingerprint" ) && MeerOutput->file_fingerprint == true )
+    else if ( !strcmp(event_type, "fingerprint" ) && file->fingerprint == true )
         {
-            Output_Do_File( json_string );
+            Output_Do_File( file, json_string );
             return(true);
         }
 
@@ -1590,162 +1877,162 @@ bool Output_File ( const char *json_string, const char *event_type )
 
 #ifdef HAVE_LIBHIREDIS
 
-bool Output_Redis( const char *json_string, const char *event_type )
+bool Output_Redis( struct _Redis_Output *redis, const char *json_string, const char *event_type, const char *flow_id, uint64_t position )
 {
 
-    if ( !strcmp( event_type, "alert") && MeerOutput->redis_alert == true )
+    if ( !strcmp( event_type, "alert") && redis->alert == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "files") && MeerOutput->redis_files == true )
+    else if ( !strcmp( event_type, "files") && redis->files == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "flow") && MeerOutput->redis_flow == true )
+    else if ( !strcmp( event_type, "flow") && redis->flow == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "dns") && MeerOutput->redis_dns == true )
+    else if ( !strcmp( event_type, "dns") && redis->dns == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "http") && MeerOutput->redis_http == true )
+    else if ( !strcmp( event_type, "http") && redis->http == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "tls") && MeerOutput->redis_tls == true )
+    else if ( !strcmp( event_type, "tls") && redis->tls == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "ssh") && MeerOutput->redis_ssh == true )
+    else if ( !strcmp( event_type, "ssh") && redis->ssh == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "smtp") && MeerOutput->redis_smtp == true )
+    else if ( !strcmp( event_type, "smtp") && redis->smtp == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "fileinfo") && MeerOutput->redis_fileinfo == true )
+    else if ( !strcmp( event_type, "fileinfo") && redis->fileinfo == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "dhcp") && MeerOutput->redis_dhcp == true )
+    else if ( !strcmp( event_type, "dhcp") && redis->dhcp == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "stats") && MeerOutput->redis_stats == true )
+    else if ( !strcmp( event_type, "stats") && redis->stats == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "rdp") && MeerOutput->redis_rdp == true )
+    else if ( !strcmp( event_type, "rdp") && redis->rdp == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "sip") && MeerOutput->redis_sip == true )
+    else if ( !strcmp( event_type, "sip") && redis->sip == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( ( !strcmp( event_type, "ftp") || !strcmp(event_type, "ftp_data" ) ) && MeerOutput->redis_ftp == true )
+    else if ( ( !strcmp( event_type, "ftp") || !strcmp(event_type, "ftp_data" ) ) && redis->ftp == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "ikev2") && MeerOutput->redis_ikev2 == true )
+    else if ( !strcmp( event_type, "ikev2") && redis->ikev2 == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "nfs") && MeerOutput->redis_nfs == true )
+    else if ( !strcmp( event_type, "nfs") && redis->nfs == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "tftp") && MeerOutput->redis_tftp == true )
+    else if ( !strcmp( event_type, "tftp") && redis->tftp == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "smb") && MeerOutput->redis_smb == true )
+    else if ( !strcmp( event_type, "smb") && redis->smb == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "mqtt") && MeerOutput->redis_mqtt == true )
+    else if ( !strcmp( event_type, "mqtt") && redis->mqtt == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "dcerpc") && MeerOutput->redis_dcerpc == true )
+    else if ( !strcmp( event_type, "dcerpc") && redis->dcerpc == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "netflow") && MeerOutput->redis_netflow == true )
+    else if ( !strcmp( event_type, "netflow") && redis->netflow == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "metadata") && MeerOutput->redis_metadata == true )
+    else if ( !strcmp( event_type, "metadata") && redis->metadata == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "dnp3") && MeerOutput->redis_dnp3 == true )
+    else if ( !strcmp( event_type, "dnp3") && redis->dnp3 == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "anomaly") && MeerOutput->redis_anomaly == true )
+    else if ( !strcmp( event_type, "anomaly") && redis->anomaly == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "fingerprint") && MeerOutput->redis_fingerprint == true )
+    else if ( !strcmp( event_type, "fingerprint") && redis->fingerprint == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
-    else if ( !strcmp( event_type, "client_stats") && MeerOutput->redis_client_stats == true )
+    else if ( !strcmp( event_type, "client_stats") && redis->client_stats == true )
         {
-            JSON_To_Redis( json_string, event_type );
+            JSON_To_Redis( redis, json_string, event_type, flow_id, position );
             return(true);
         }
 
@@ -21,12 +21,17 @@
 #include <json-c/json.h>
 
 void Init_Output( void );
-bool Output_Pipe ( const char *json_string, const char *event_type );
+struct _Pipe_Output;
+bool Output_Pipe ( struct _Pipe_Output *pipe_out, const char *json_string, const char *event_type );
 bool Output_External ( const char *json_string, struct json_object *json_obj, const char *event_type );
 void Output_Bluedot ( struct json_object *json_obj );
 bool Output_Elasticsearch ( const char *json_string, const char *event_type, const char *id );
-bool Output_Do_Elasticsearch ( const char *json_string, const char *event_type, const char *id );
-bool Output_File ( const char *json_string, const char *event_type );
-bool Output_Redis( const char *json_string, const char *event_type );
+struct _Elasticsearch_Output;
+bool Output_Elasticsearch_Route ( struct _Elasticsearch_Output *es, const char *json_string, const char *event_type, const char *id, const char *raw );
+bool Output_Do_Elasticsearch ( struct _Elasticsearch_Output *es, const char *json_string, const char *event_type, const char *id, const char *raw );
+struct _File_Output;
+bool Output_File ( struct _File_Output *file, const char *json_string, const char *event_type );
+struct _Redis_Output;
+bool Output_Redis( struct _Redis_Output *redis, const char *json_string, const char *event_type, const char *flow_id, uint64_t position );
 bool Output_Syslog ( const char *json_string, const char *event_type );
 
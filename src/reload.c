@@ -0,0 +1,181 @@
+/*
+** Copyright (C) 2018-2022 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2022 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+
+/* Hot reload of enrichment data (SIGHUP).
+ *
+ * The signal handler only sets Reload_Requested.  The decoding thread
+ * notices it between events (Reload_Check()) and starts a background
+ * thread that loads new copies of the GeoIP databases and OUI table.
+ * Events keep flowing against the old copies while that happens.  Once
+ * the new copies are ready,  the decoding thread swaps them in before the
+ * next event.  Since the decoding thread is the only reader and it swaps
+ * between events,  the old copies can be released right away.  If
+ * anything fails to load,  the old copy stays in service.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "meer.h"
+#include "meer-def.h"
+#include "reload.h"
+#include "oui.h"
+
+#ifdef HAVE_LIBMAXMINDDB
+#include "geoip.h"
+#endif
+
+extern struct _MeerConfig *MeerConfig;
+
+volatile sig_atomic_t Reload_Requested = 0;
+
+struct _Reload
+{
+
+    struct _OUI_Table *OUI;
+
+#ifdef HAVE_LIBMAXMINDDB
+    struct _GeoIP_Databases *GeoIP;
+#endif
+
+};
+
+static struct _Reload *Reload_Ready = NULL;	/* Set by the reload thread */
+static bool Reload_Running = false;		/* Only touched by the decoding thread */
+
+/****************************************************************************
+ * Reload_Thread - Build new copies of everything that can be reloaded.
+ ****************************************************************************/
+
+static void *Reload_Thread( void *arg )
+{
+
+    struct _Reload *Reload = NULL;
+
+    Reload = calloc( 1, sizeof(struct _Reload) );
+
+    if ( Reload == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Reload. Abort!", __FILE__, __LINE__);
+        }
+
+    if ( MeerConfig->oui == true )
+        {
+
+            Reload->OUI = OUI_Load_Table();
+
+            if ( Reload->OUI == NULL )
+                {
+                    Meer_Log(WARN, "Reload of the OUI database failed.  Keeping the current data.");
+                }
+        }
+
+#ifdef HAVE_LIBMAXMINDDB
+
+    if ( MeerConfig->geoip == true )
+        {
+
+            Reload->GeoIP = GeoIP_Load_Databases();
+
+            if ( Reload->GeoIP == NULL )
+                {
+                    Meer_Log(WARN, "Reload of the GeoIP database(s) failed.  Keeping the current data.");
+                }
+        }
+
+#endif
+
+    /* Hand it over to the decoding thread */
+
+    __atomic_store_n(&Reload_Ready, Reload, __ATOMIC_RELEASE);
+
+    pthread_exit(NULL);
+
+}
+
+/****************************************************************************
+ * Reload_Check - Called by the decoding thread before each event.  Starts a
+ * reload if one was requested and swaps in the results when it finishes.
+ ****************************************************************************/
+
+void Reload_Check( void )
+{
+
+    struct _Reload *Reload = NULL;
+
+    pthread_t reload_thread;
+    pthread_attr_t thread_attr;
+
+    if ( __atomic_load_n(&Reload_Ready, __ATOMIC_RELAXED) != NULL )
+        {
+
+            Reload = __atomic_exchange_n(&Reload_Ready, NULL, __ATOMIC_ACQUIRE);
+
+            if ( Reload->OUI != NULL )
+                {
+                    OUI_Swap_Table( Reload->OUI );
+                }
+
+#ifdef HAVE_LIBMAXMINDDB
+
+            if ( Reload->GeoIP != NULL )
+                {
+                    GeoIP_Swap_Databases( Reload->GeoIP );
+                    Meer_Log(NORMAL, "GeoIP database(s) reloaded.");
+                }
+
+#endif
+
+            free(Reload);
+            Reload_Running = false;
+
+            Meer_Log(NORMAL, "Reload complete.");
+
+        }
+
+    if ( Reload_Requested == 0 || Reload_Running == true )
+        {
+            return;
+        }
+
+    Reload_Requested = 0;
+    Reload_Running = true;
+
+    Meer_Log(NORMAL, "Reloading enrichment data.");
+
+    pthread_attr_init(&thread_attr);
+    pthread_attr_setdetachstate(&thread_attr,  PTHREAD_CREATE_DETACHED);
+
+    if ( pthread_create ( &reload_thread, &thread_attr, Reload_Thread, NULL ) )
+        {
+            Meer_Log(WARN, "Unable to create the reload thread.  Reload skipped.");
+            Reload_Running = false;
+        }
+
+    pthread_attr_destroy(&thread_attr);
+
+}
@@ -31,6 +31,7 @@
 #include "stats.h"
 #include "util.h"
 #include "config-yaml.h"
+#include "output-queue.h"
 
 
 extern struct _MeerCounters *MeerCounters;
@@ -111,6 +112,55 @@ void Statistics( void )
 
         }
 
+#ifdef HAVE_LIBHIREDIS
+
+    if ( MeerConfig->fingerprint == true && MeerConfig->fingerprint_reader == true && MeerConfig->fingerprint_cache != 0 )
+        {
+
+            Meer_Log(NORMAL, " - Fingerprint Cache Statistics:");
+            Meer_Log(NORMAL, "");
+            Meer_Log(NORMAL, " Fingerprint Cache Misses: %"PRIu64 "", MeerCounters->FingerprintCacheMissCount);
+            Meer_Log(NORMAL, " Fingerprint Cache Hits  : %"PRIu64 " (%.3f%%)", MeerCounters->FingerprintCacheHitCount, CalcPct(MeerCounters->FingerprintCacheHitCount, MeerCounters->FingerprintCacheHitCount + MeerCounters->FingerprintCacheMissCount));
+            Meer_Log(NORMAL, "");
+
+        }
+
+#endif
+
+#ifdef WITH_ELASTICSEARCH
+
+    if ( MeerOutput->elasticsearch_enabled == true )
+        {
+
+            Meer_Log(NORMAL, " - Elasticsearch Statistics:");
+            Meer_Log(NORMAL, "");
+            Meer_Log(NORMAL, " Bulk bytes (raw) : %"PRIu64 "", MeerCounters->ElasticsearchRawBytes);
+            Meer_Log(NORMAL, " Bulk bytes (wire): %"PRIu64 " (%.3f%%)", MeerCounters->ElasticsearchWireBytes, CalcPct(MeerCounters->ElasticsearchWireBytes, MeerCounters->ElasticsearchRawBytes));
+            Meer_Log(NORMAL, " Indexed          : %"PRIu64 "", MeerCounters->ElasticsearchIndexedCount);
+            Meer_Log(NORMAL, " Retried          : %"PRIu64 "", MeerCounters->ElasticsearchRetryCount);
+            Meer_Log(NORMAL, " Dead lettered    : %"PRIu64 "", MeerCounters->ElasticsearchDeadLetterCount);
+            Meer_Log(NORMAL, " Dropped          : %"PRIu64 "", MeerCounters->ElasticsearchDropCount);
+            Meer_Log(NORMAL, "");
+
+        }
+
+#endif
+
+#ifdef HAVE_LIBMAXMINDDB
+
+    if ( MeerConfig->geoip == true )
+        {
+
+            Meer_Log(NORMAL, " - GeoIP Statistics:");
+            Meer_Log(NORMAL, "");
+            Meer_Log(NORMAL, " GeoIP Lookups   : %"PRIu64 "", MeerCounters->GeoIPLookupCount);
+            Meer_Log(NORMAL, " GeoIP Cache Hits: %"PRIu64 " (%.3f%%)", MeerCounters->GeoIPCacheHitCount, CalcPct(MeerCounters->GeoIPCacheHitCount, MeerCounters->GeoIPCacheHitCount + MeerCounters->GeoIPLookupCount));
+            Meer_Log(NORMAL, "");
+
+        }
+
+#endif
+
     if ( MeerOutput->pipe_enabled == true )
         {
 
@@ -131,6 +181,7 @@ void Statistics( void )
 
         }
 
+    Output_Queue_Statistics();
 
     Meer_Log(NORMAL, "");
 
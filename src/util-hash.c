@@ -0,0 +1,172 @@
+/*
+** Copyright (C) 2018-2023 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2023 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* MurmurHash3_x64_128 by Austin Appleby,  placed in the public domain.  A
+   fast,  non-cryptographic 128 bit hash used for stable document IDs. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "util-hash.h"
+
+#define ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static inline uint64_t Hash_Fmix64( uint64_t k )
+{
+
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+
+    return(k);
+
+}
+
+/****************************************************************************
+ * Hash128 - MurmurHash3_x64_128 of "data",  written to "str" as 32 hex
+ * characters.  "str" should be at least HASH128_SIZE bytes.
+ ****************************************************************************/
+
+void Hash128( const uint8_t *data, size_t len, char *str, size_t size )
+{
+
+    const size_t nblocks = len / 16;
+    const uint8_t *tail = data + nblocks * 16;
+
+    const uint64_t c1 = 0x87c37b91114253d5ULL;
+    const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+    uint64_t h1 = 0;
+    uint64_t h2 = 0;
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+
+    size_t i = 0;
+
+    for ( i = 0; i < nblocks; i++ )
+        {
+
+            /* memcpy() for unaligned reads,  the compiler turns it into a
+               plain load */
+
+            memcpy(&k1, data + i * 16, 8);
+            memcpy(&k2, data + i * 16 + 8, 8);
+
+            k1 *= c1;
+            k1 = ROTL64(k1, 31);
+            k1 *= c2;
+            h1 ^= k1;
+
+            h1 = ROTL64(h1, 27);
+            h1 += h2;
+            h1 = h1 * 5 + 0x52dce729;
+
+            k2 *= c2;
+            k2 = ROTL64(k2, 33);
+            k2 *= c1;
+            h2 ^= k2;
+
+            h2 = ROTL64(h2, 31);
+            h2 += h1;
+            h2 = h2 * 5 + 0x38495ab5;
+
+        }
+
+    k1 = 0;
+    k2 = 0;
+
+    switch ( len & 15 )
+        {
+        case 15:
+            k2 ^= ((uint64_t)tail[14]) << 48;
+        /* fall through */
+        case 14:
+            k2 ^= ((uint64_t)tail[13]) << 40;
+        /* fall through */
+        case 13:
+            k2 ^= ((uint64_t)tail[12]) << 32;
+        /* fall through */
+        case 12:
+            k2 ^= ((uint64_t)tail[11]) << 24;
+        /* fall through */
+        case 11:
+            k2 ^= ((uint64_t)tail[10]) << 16;
+        /* fall through */
+        case 10:
+            k2 ^= ((uint64_t)tail[9]) << 8;
+        /* fall through */
+        case 9:
+            k2 ^= ((uint64_t)tail[8]);
+            k2 *= c2;
+            k2 = ROTL64(k2, 33);
+            k2 *= c1;
+            h2 ^= k2;
+        /* fall through */
+        case 8:
+            k1 ^= ((uint64_t)tail[7]) << 56;
+        /* fall through */
+        case 7:
+            k1 ^= ((uint64_t)tail[6]) << 48;
+        /* fall through */
+        case 6:
+            k1 ^= ((uint64_t)tail[5]) << 40;
+        /* fall through */
+        case 5:
+            k1 ^= ((uint64_t)tail[4]) << 32;
+        /* fall through */
+        case 4:
+            k1 ^= ((uint64_t)tail[3]) << 24;
+        /* fall through */
+        case 3:
+            k1 ^= ((uint64_t)tail[2]) << 16;
+        /* fall through */
+        case 2:
+            k1 ^= ((uint64_t)tail[1]) << 8;
+        /* fall through */
+        case 1:
+            k1 ^= ((uint64_t)tail[0]);
+            k1 *= c1;
+            k1 = ROTL64(k1, 31);
+            k1 *= c2;
+            h1 ^= k1;
+        }
+
+    h1 ^= len;
+    h2 ^= len;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = Hash_Fmix64(h1);
+    h2 = Hash_Fmix64(h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    snprintf(str, size, "%016llx%016llx", (unsigned long long)h1, (unsigned long long)h2);
+
+}
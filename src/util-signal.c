@@ -37,6 +37,8 @@
 #include "stats.h"
 #include "waldo.h"
 #include "config-yaml.h"
+#include "reload.h"
+#include "output-queue.h"
 
 #if defined(WITH_BLUEDOT) || defined(WITH_ELASTICSEARCH)
 #include <curl/curl.h>
@@ -47,12 +49,6 @@
 bool elasticsearch_death = false;
 uint8_t elasticsearch_death_count = 0;
 extern uint_fast16_t elastic_proc_running;
-extern char *big_batch;
-extern char *big_batch_THREAD;
-#endif
-
-#ifdef HAVE_LIBHIREDIS
-#include <output-plugins/redis.h>
 #endif
 
 #ifdef WITH_BLUEDOT
@@ -81,19 +77,10 @@ void Signal_Handler(int sig_num)
 //        case SIGSEGV:
 //        case SIGABRT:
 
-            if ( MeerOutput->pipe_enabled == true )
-                {
-                    close(MeerOutput->pipe_fd);
-                }
+            /* Let the output workers write what is queued.  This also
+               closes the pipe,  file and Redis outputs. */
 
-#ifdef HAVE_LIBHIREDIS
-
-            if ( MeerOutput->redis_enabled == true )
-                {
-                    Redis_Close();
-                }
-
-#endif
+            Output_Queue_Shutdown();
 
 
 #ifdef WITH_ELASTICSEARCH
@@ -106,7 +93,7 @@ void Signal_Handler(int sig_num)
 
                     while ( elastic_proc_running != 0 )
                         {
-                            Meer_Log(NORMAL, "Waiting on %d Elasticseach thread to shutdown.", elastic_proc_running);
+                            Meer_Log(NORMAL, "Waiting on %d Elasticseach batches to be sent.", elastic_proc_running);
                             sleep(1);
 
                             if ( elasticsearch_death_count == 15 )
@@ -119,12 +106,6 @@ void Signal_Handler(int sig_num)
 
                         }
 
-                    if ( elastic_proc_running == 0 )
-                        {
-                            free( big_batch );
-                            free( big_batch_THREAD);
-                        }
-
                 }
 
 #endif
@@ -155,14 +136,6 @@ void Signal_Handler(int sig_num)
 
 #endif
 
-            if ( MeerOutput->file_enabled == true )
-                {
-                    fflush(MeerOutput->file_fd);
-                    fclose(MeerOutput->file_fd);
-                }
-
-
-
             Remove_Lock_File();
 
             Statistics();
@@ -189,6 +162,14 @@ void Signal_Handler(int sig_num)
 
             break;
 
+        /* Reload GeoIP / OUI data.  The work is done by the decoding
+           thread (see reload.c) */
+
+        case SIGHUP:
+
+            Reload_Requested = 1;
+            break;
+
         case SIGUSR1:
 
             Statistics();
@@ -262,6 +262,22 @@ char *Hexify(char *xdata, int length)
     return(retbuf);
 }
 
+/****************************************************************************
+ * Current_Epoch_Ms - Wall clock in milliseconds.  It is on the same clock
+ * as pthread_cond_timedwait(),  so it can be used for wait deadlines.
+ ****************************************************************************/
+
+uint64_t Current_Epoch_Ms( void )
+{
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return( (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000 );
+
+}
+
 uint64_t Current_Epoch( void )
 {
 
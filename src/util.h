@@ -54,6 +54,7 @@ bool Mask2Bit(int mask, unsigned char *out);
 void Remove_Spaces(char *s);
 void Remove_Return(char *s);
 uint64_t Current_Epoch( void );
+uint64_t Current_Epoch_Ms( void );
 bool Is_IPv6 (char *ipaddr);
 double CalcPct(uint64_t cnt, uint64_t total);
 